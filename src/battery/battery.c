@@ -31,6 +31,8 @@
 #include "battery.h"
 #include "timer.h"
 #include "common.h"
+#include "test.h"
+#include "uevent.h"
 
 gboolean bat1_has_font;
 PangoFontDescription *bat1_font_desc;
@@ -46,6 +48,11 @@ static Timer battery_timer;
 static Timer battery_blink_timer;
 
 #define BATTERY_BUF_SIZE 256
+
+// Polling bounds, in seconds. Between polls, state changes are picked up from kernel uevents if available.
+#define BATTERY_MIN_POLL_INTERVAL 5
+#define BATTERY_MAX_POLL_INTERVAL 300
+#define BATTERY_POLL_INTERVAL_NO_EVENTS 30
 static char buf_bat_line1[BATTERY_BUF_SIZE];
 static char buf_bat_line2[BATTERY_BUF_SIZE];
 
@@ -232,9 +239,6 @@ void init_battery()
 
     battery_found = battery_os_init();
 
-    if (!battery_timer.enabled_)
-        change_timer(&battery_timer, true, 30000, 30000, update_battery_tick, 0);
-
     update_battery();
 }
 
@@ -267,7 +271,7 @@ void init_battery_panel(void *p)
     battery->area._get_desired_size = battery_get_desired_size;
     battery->area._is_under_mouse = full_width_area_is_under_mouse;
     battery->area.on_screen = TRUE;
-    battery->area.resize_needed = TRUE;
+    schedule_resize(&battery->area);
     battery->area.has_mouse_over_effect =
         panel_config.mouse_effects && (battery_lclick_command || battery_mclick_command || battery_rclick_command ||
                                        battery_uwheel_command || battery_dwheel_command);
@@ -311,8 +315,8 @@ void battery_default_font_changed()
     }
     battery_init_fonts();
     for (int i = 0; i < num_panels; i++) {
-        panels[i].battery.area.resize_needed = TRUE;
-        schedule_redraw(&panels[i].battery.area);
+        schedule_resize(&panels[i]->battery.area);
+        schedule_redraw(&panels[i]->battery.area);
     }
     schedule_panel_redraw();
 }
@@ -323,13 +327,50 @@ void blink_battery(void *arg)
         return;
     battery_warn_red = battery_warn ? !battery_warn_red : FALSE;
     for (int i = 0; i < num_panels; i++) {
-        if (panels[i].battery.area.on_screen) {
-            schedule_redraw(&panels[i].battery.area);
+        if (panels[i]->battery.area.on_screen) {
+            schedule_redraw(&panels[i]->battery.area);
         }
     }
 }
 
+static gboolean format_has_specifier(const char *format, const char *specifiers)
+{
+    for (const char *c = format ? strchr(format, '%') : NULL; c && c[1]; c = strchr(c + 2, '%'))
+        if (strchr(specifiers, c[1]))
+            return TRUE;
+    return FALSE;
+}
+
+static int battery_poll_interval(const BatteryState *state, gboolean shows_minutes, int max_interval)
+// Returns the number of seconds until the percentage or the displayed time left can change.
+// The rate of change is derived from the time left estimated by the OS backend.
+{
+    if (state->state != BATTERY_CHARGING && state->state != BATTERY_DISCHARGING)
+        return max_interval;
+    int interval = max_interval;
+    int seconds_left = state->time.hours * 3600 + state->time.minutes * 60 + state->time.seconds;
+    int percent_left = state->state == BATTERY_DISCHARGING ? state->percentage : 100 - state->percentage;
+    if (seconds_left > 0 && percent_left > 0)
+        interval = MIN(interval, seconds_left / percent_left);
+    else
+        interval = MIN(interval, BATTERY_POLL_INTERVAL_NO_EVENTS);
+    if (shows_minutes)
+        interval = MIN(interval, 60);
+    return MAX(interval, BATTERY_MIN_POLL_INTERVAL);
+}
+
+static void schedule_battery_poll()
+{
+    int max_interval = uevent_fd >= 0 ? BATTERY_MAX_POLL_INTERVAL : BATTERY_POLL_INTERVAL_NO_EVENTS;
+    gboolean shows_minutes = format_has_specifier(bat1_format, "mt") || format_has_specifier(bat2_format, "mt");
+    int interval = battery_poll_interval(&battery_state, shows_minutes, max_interval);
+    if (debug_timers)
+        fprintf(stderr, "tint2: battery: next poll in %d s\n", interval);
+    change_timer(&battery_timer, true, interval * 1000, 0, update_battery_tick, 0);
+}
+
 void update_battery_tick(void *arg)
+// Called by the poll timer and on power_supply uevents; reschedules the poll either way.
 {
     if (!battery_enabled)
         return;
@@ -394,26 +435,28 @@ void update_battery_tick(void *arg)
     for (int i = 0; i < num_panels; i++) {
         // Show/hide if needed
         if (!battery_found) {
-            hide(&panels[i].battery.area);
+            hide(&panels[i]->battery.area);
         } else {
             if (battery_state.percentage >= percentage_hide)
-                hide(&panels[i].battery.area);
+                hide(&panels[i]->battery.area);
             else
-                show(&panels[i].battery.area);
+                show(&panels[i]->battery.area);
         }
         // Redraw if needed
-        if (panels[i].battery.area.on_screen) {
+        if (panels[i]->battery.area.on_screen) {
             if (old_found != battery_found || old_percentage != battery_state.percentage ||
                 old_hours != battery_state.time.hours || old_minutes != battery_state.time.minutes ||
                 old_warn != battery_warn) {
-                panels[i].battery.area.resize_needed = TRUE;
+                schedule_resize(&panels[i]->battery.area);
                 if (!battery_warn)
-                    panels[i].battery.area.bg = panel_config.battery.area.bg;
+                    panels[i]->battery.area.bg = panel_config.battery.area.bg;
                 schedule_panel_redraw();
             }
-            tooltip_update_for_area (&panels[i].battery.area);
+            tooltip_update_for_area (&panels[i]->battery.area);
         }
     }
+
+    schedule_battery_poll();
 }
 
 int update_battery()
@@ -504,3 +547,39 @@ void battery_action(void *obj, int button, int x, int y, Time time)
     }
     tint_exec(command, NULL, NULL, time, obj, x, y, FALSE, TRUE);
 }
+
+TEST(battery_poll_interval)
+{
+    BatteryState state = {0};
+    state.state = BATTERY_FULL;
+    ASSERT_EQUAL(battery_poll_interval(&state, TRUE, 300), 300);
+
+    // 3 hours for 60 %: one percent every 3 minutes
+    state.state = BATTERY_DISCHARGING;
+    state.percentage = 60;
+    battery_state_set_time(&state, 3 * 3600);
+    ASSERT_EQUAL(battery_poll_interval(&state, FALSE, 300), 180);
+    ASSERT_EQUAL(battery_poll_interval(&state, TRUE, 300), 60);
+    ASSERT_EQUAL(battery_poll_interval(&state, FALSE, 30), 30);
+
+    // 10 minutes to charge the last 40 %
+    state.state = BATTERY_CHARGING;
+    battery_state_set_time(&state, 600);
+    ASSERT_EQUAL(battery_poll_interval(&state, FALSE, 300), 15);
+    battery_state_set_time(&state, 20);
+    ASSERT_EQUAL(battery_poll_interval(&state, FALSE, 300), BATTERY_MIN_POLL_INTERVAL);
+
+    // No estimate yet
+    battery_state_set_time(&state, 0);
+    ASSERT_EQUAL(battery_poll_interval(&state, FALSE, 300), BATTERY_POLL_INTERVAL_NO_EVENTS);
+}
+
+TEST(battery_format_has_specifier)
+{
+    ASSERT_TRUE(format_has_specifier("%p %t", "mt"));
+    ASSERT_TRUE(format_has_specifier("%h:%m", "mt"));
+    ASSERT(!format_has_specifier("%p", "mt"));
+    ASSERT(!format_has_specifier("100%%m", "mt"));
+    ASSERT(!format_has_specifier("%", "mt"));
+    ASSERT(!format_has_specifier(NULL, "mt"));
+}
@@ -21,9 +21,12 @@
 
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 #include "common.h"
 #include "battery.h"
+#include "test.h"
 #include "uevent.h"
 
 enum psy_type {
@@ -32,17 +35,23 @@ enum psy_type {
     PSY_MAINS,
 };
 
+/* sysfs attribute, kept open and re-read from offset 0 */
+struct psy_attr {
+    gchar *path;
+    int fd;
+};
+
 struct psy_battery {
     /* generic properties */
     gchar *name;
     /* monotonic time, in microseconds */
     gint64 timestamp;
     /* sysfs files */
-    gchar *path_present;
-    gchar *path_level_now;
-    gchar *path_level_full;
-    gchar *path_rate_now;
-    gchar *path_status;
+    struct psy_attr sysfs_present;
+    struct psy_attr sysfs_level_now;
+    struct psy_attr sysfs_level_full;
+    struct psy_attr sysfs_rate_now;
+    struct psy_attr sysfs_status;
     /* values */
     gboolean present;
     gint level_now;
@@ -53,11 +62,14 @@ struct psy_battery {
 };
 
 struct psy_mains {
-    gchar *name;        /* generic properties */
-    gchar *path_online; /* sysfs files */
-    gboolean online;    /* values */
+    gchar *name;                 /* generic properties */
+    struct psy_attr sysfs_online; /* sysfs files */
+    gboolean online;             /* values */
 };
 
+/* number of system calls made to read sysfs, for bench_battery */
+static unsigned long psy_syscalls;
+
 static int file_get_contents( char *pathname, char **content)
 // Returns number of loaded characters or -1 if error occured
 // Actual error code is written to errno
@@ -68,14 +80,17 @@ static int file_get_contents( char *pathname, char **content)
 
     int result = -1;
     int fd = open( pathname, O_RDONLY);
+    psy_syscalls++;
     if (fd == -1)
         return result;
 
     int len = lseek( fd, 0, SEEK_END);
+    psy_syscalls++;
     if (len == -1)
         goto end;
 
     lseek( fd, 0, SEEK_SET);
+    psy_syscalls++;
     char *data = malloc( len + 1);
     if (! data)
         goto end;
@@ -85,6 +100,7 @@ static int file_get_contents( char *pathname, char **content)
     while (len)
     {
         int ret = read( fd, data, len);
+        psy_syscalls++;
         if (ret == 0)
             break;
         if (ret == -1)
@@ -105,9 +121,81 @@ static int file_get_contents( char *pathname, char **content)
 
 end:
     close( fd);
+    psy_syscalls++;
     return result;
 }
 
+static void psy_attr_set_path(struct psy_attr *attr, gchar *path)
+{
+    free( attr->path);
+    attr->path = path;
+    attr->fd = -1;
+}
+
+static void psy_attr_free(struct psy_attr *attr)
+{
+    if (attr->path && attr->fd >= 0)
+        close( attr->fd);
+    free( attr->path);
+    attr->path = NULL;
+    attr->fd = -1;
+}
+
+static int psy_attr_read(struct psy_attr *attr, char *buf, size_t size)
+// Reads the attribute into buf, NUL-terminated, without allocating.
+// The file stays open: sysfs regenerates the value on each read at offset 0.
+// Returns number of loaded characters or -1 if error occured, with errno set
+{
+    if (attr->fd < 0) {
+        attr->fd = open( attr->path, O_RDONLY | O_CLOEXEC);
+        psy_syscalls++;
+        if (attr->fd < 0)
+            return -1;
+    }
+    ssize_t count;
+    do {
+        count = pread( attr->fd, buf, size - 1, 0);
+        psy_syscalls++;
+    } while (count < 0 && errno == EINTR);
+    if (count < 0)
+        return -1;
+    buf[count] = '\0';
+    return count;
+}
+
+static gint parse_sysfs_int(const char *s)
+// Like atoi, sysfs values are decimal integers followed by a newline
+{
+    while (*s == ' ')
+        s++;
+    gboolean negative = *s == '-';
+    if (*s == '-' || *s == '+')
+        s++;
+    gint64 value = 0;
+    for (; *s >= '0' && *s <= '9' && value <= G_MAXINT; s++)
+        value = value * 10 + (*s - '0');
+    value = MIN(value, G_MAXINT);
+    return negative ? -value : value;
+}
+
+TEST(parse_sysfs_int)
+{
+    ASSERT_EQUAL(parse_sysfs_int("42\n"), 42);
+    ASSERT_EQUAL(parse_sysfs_int("-1500000\n"), -1500000);
+    ASSERT_EQUAL(parse_sysfs_int("0"), 0);
+    ASSERT_EQUAL(parse_sysfs_int("\n"), 0);
+    ASSERT_EQUAL(parse_sysfs_int("99999999999\n"), G_MAXINT);
+}
+
+static gboolean psy_attr_read_int(struct psy_attr *attr, gint *value)
+{
+    char buf[32];
+    if (psy_attr_read(attr, buf, sizeof(buf)) < 0)
+        return FALSE;
+    *value = parse_sysfs_int(buf);
+    return TRUE;
+}
+
 static gboolean is_file_non_empty(const char *path)
 {
     FILE *f = fopen(path, "r");
@@ -177,42 +265,38 @@ static gboolean init_linux_battery(struct psy_battery *bat)
 {
     const gchar *entryname = bat->name;
 
-    bat->path_present = strdup_printf( NULL, "%s/sys/class/power_supply/%s/present", battery_sys_prefix, entryname);
-    if (!is_file_non_empty(bat->path_present)) {
-        fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->path_present);
+    psy_attr_set_path(&bat->sysfs_present, strdup_printf( NULL, "%s/sys/class/power_supply/%s/present", battery_sys_prefix, entryname));
+    if (!is_file_non_empty(bat->sysfs_present.path)) {
+        fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->sysfs_present.path);
         return FALSE;
     }
 
-    bat->path_level_now = strdup_printf( NULL, "%s/sys/class/power_supply/%s/energy_now", battery_sys_prefix, entryname);
-    bat->path_level_full = strdup_printf( NULL, "%s/sys/class/power_supply/%s/energy_full", battery_sys_prefix, entryname);
-    bat->path_rate_now = strdup_printf( NULL, "%s/sys/class/power_supply/%s/power_now", battery_sys_prefix, entryname);
+    psy_attr_set_path(&bat->sysfs_level_now, strdup_printf( NULL, "%s/sys/class/power_supply/%s/energy_now", battery_sys_prefix, entryname));
+    psy_attr_set_path(&bat->sysfs_level_full, strdup_printf( NULL, "%s/sys/class/power_supply/%s/energy_full", battery_sys_prefix, entryname));
+    psy_attr_set_path(&bat->sysfs_rate_now, strdup_printf( NULL, "%s/sys/class/power_supply/%s/power_now", battery_sys_prefix, entryname));
     bat->unit = 'W';
 
-    if (!is_file_non_empty(bat->path_level_now) ||
-        !is_file_non_empty(bat->path_level_full))
+    if (!is_file_non_empty(bat->sysfs_level_now.path) ||
+        !is_file_non_empty(bat->sysfs_level_full.path))
     {
-        free( bat->path_level_now);
-        free( bat->path_level_full);
-        free( bat->path_rate_now);
-
-        bat->path_level_now = strdup_printf( NULL, "%s/sys/class/power_supply/%s/charge_now", battery_sys_prefix, entryname);
-        bat->path_level_full = strdup_printf( NULL, "%s/sys/class/power_supply/%s/charge_full", battery_sys_prefix, entryname);
-        bat->path_rate_now = strdup_printf( NULL, "%s/sys/class/power_supply/%s/current_now", battery_sys_prefix, entryname);
+        psy_attr_set_path(&bat->sysfs_level_now, strdup_printf( NULL, "%s/sys/class/power_supply/%s/charge_now", battery_sys_prefix, entryname));
+        psy_attr_set_path(&bat->sysfs_level_full, strdup_printf( NULL, "%s/sys/class/power_supply/%s/charge_full", battery_sys_prefix, entryname));
+        psy_attr_set_path(&bat->sysfs_rate_now, strdup_printf( NULL, "%s/sys/class/power_supply/%s/current_now", battery_sys_prefix, entryname));
         bat->unit = 'A';
 
-        if (!is_file_non_empty(bat->path_level_now)) {
-            fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->path_level_now);
+        if (!is_file_non_empty(bat->sysfs_level_now.path)) {
+            fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->sysfs_level_now.path);
             return FALSE;
         }
-        if (!is_file_non_empty(bat->path_level_full)) {
-            fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->path_level_full);
+        if (!is_file_non_empty(bat->sysfs_level_full.path)) {
+            fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->sysfs_level_full.path);
             return FALSE;
         }
     }
 
-    bat->path_status = strdup_printf( NULL, "%s/sys/class/power_supply/%s/status", battery_sys_prefix, entryname);
-    if (!is_file_non_empty(bat->path_status)) {
-        fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->path_status);
+    psy_attr_set_path(&bat->sysfs_status, strdup_printf( NULL, "%s/sys/class/power_supply/%s/status", battery_sys_prefix, entryname));
+    if (!is_file_non_empty(bat->sysfs_status.path)) {
+        fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, bat->sysfs_status.path);
         return FALSE;
     }
 
@@ -222,9 +306,9 @@ static gboolean init_linux_battery(struct psy_battery *bat)
 static gboolean init_linux_mains(struct psy_mains *ac)
 {
     const gchar *entryname = ac->name;
-    ac->path_online = strdup_printf( NULL, "%s/sys/class/power_supply/%s/online", battery_sys_prefix, entryname);
-    if (!is_file_non_empty(ac->path_online)) {
-        fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, ac->path_online);
+    psy_attr_set_path(&ac->sysfs_online, strdup_printf( NULL, "%s/sys/class/power_supply/%s/online", battery_sys_prefix, entryname));
+    if (!is_file_non_empty(ac->sysfs_online.path)) {
+        fprintf(stderr, RED "tint2: %s:%d: read failed for %s" RESET "\n", __FILE__, __LINE__, ac->sysfs_online.path);
         return FALSE;
     }
 
@@ -235,11 +319,11 @@ static void psy_battery_free(gpointer data)
 {
     struct psy_battery *bat = data;
     free( bat->name);
-    free( bat->path_status);
-    free( bat->path_rate_now);
-    free( bat->path_level_full);
-    free( bat->path_level_now);
-    free( bat->path_present);
+    psy_attr_free( &bat->sysfs_status);
+    psy_attr_free( &bat->sysfs_rate_now);
+    psy_attr_free( &bat->sysfs_level_full);
+    psy_attr_free( &bat->sysfs_level_now);
+    psy_attr_free( &bat->sysfs_present);
     free( bat);
 }
 
@@ -247,7 +331,7 @@ static void psy_mains_free(gpointer data)
 {
     struct psy_mains *ac = data;
     free( ac->name);
-    free( ac->path_online);
+    psy_attr_free( &ac->sysfs_online);
     free( ac);
 }
 
@@ -342,7 +426,8 @@ static gint estimate_rate_usage(struct psy_battery *bat, gint old_level_now, gin
 
 static gboolean update_linux_battery(struct psy_battery *bat)
 {
-    gchar *data;
+    char data[32];
+    gint value;
 
     gint64 old_timestamp = bat->timestamp;
     int old_level_now = bat->level_now;
@@ -357,9 +442,8 @@ static gboolean update_linux_battery(struct psy_battery *bat)
     bat->timestamp = g_get_monotonic_time();
 
     /* present */
-    RETURN_ON_ERROR( file_get_contents( bat->path_present, &data) == -1);
-    bat->present = (atoi(data) == 1);
-    free( data);
+    RETURN_ON_ERROR( !psy_attr_read_int( &bat->sysfs_present, &value));
+    bat->present = (value == 1);
 
     /* we are done, if battery is not present */
     if (!bat->present)
@@ -367,7 +451,7 @@ static gboolean update_linux_battery(struct psy_battery *bat)
 
     /* status */
     bat->status = BATTERY_UNKNOWN;
-    RETURN_ON_ERROR( file_get_contents( bat->path_status, &data) == -1);
+    RETURN_ON_ERROR( psy_attr_read( &bat->sysfs_status, data, sizeof(data)) == -1);
 
     if (!g_strcmp0(data, "Charging\n")) {
         bat->status = BATTERY_CHARGING;
@@ -376,20 +460,15 @@ static gboolean update_linux_battery(struct psy_battery *bat)
     } else if (!g_strcmp0(data, "Full\n")) {
         bat->status = BATTERY_FULL;
     }
-    free( data);
 
     /* level now */
-    RETURN_ON_ERROR( file_get_contents( bat->path_level_now, &data) == -1);
-    bat->level_now = atoi(data);
-    free( data);
+    RETURN_ON_ERROR( !psy_attr_read_int( &bat->sysfs_level_now, &bat->level_now));
 
     /* level full */
-    RETURN_ON_ERROR( file_get_contents( bat->path_level_full, &data) == -1);
-    bat->level_full = atoi(data);
-    free( data);
+    RETURN_ON_ERROR( !psy_attr_read_int( &bat->sysfs_level_full, &bat->level_full));
 
     /* rate now */
-    if (file_get_contents( bat->path_rate_now, &data) == -1)
+    if (!psy_attr_read_int( &bat->sysfs_rate_now, &value))
     {
         if (errno != ENODEV)
             return FALSE;
@@ -403,8 +482,7 @@ static gboolean update_linux_battery(struct psy_battery *bat)
             bat->timestamp = old_timestamp;
         }
     } else {
-        bat->rate_now = atoi(data);
-        free( data);
+        bat->rate_now = value;
     }
 
     return TRUE;
@@ -412,13 +490,12 @@ static gboolean update_linux_battery(struct psy_battery *bat)
 
 static gboolean update_linux_mains(struct psy_mains *ac)
 {
-    gchar *data;
+    gint value;
     ac->online = FALSE;
 
     /* online */
-    RETURN_ON_ERROR( file_get_contents( ac->path_online, &data) == -1);
-    ac->online = (atoi(data) == 1);
-    free( data);
+    RETURN_ON_ERROR( !psy_attr_read_int( &ac->sysfs_online, &value));
+    ac->online = (value == 1);
 
     return TRUE;
 }
@@ -572,4 +649,56 @@ char *battery_os_tooltip()
     return result;
 }
 
+static void bench_battery_read_all_files()
+// The reads of an update before the attributes were kept open
+{
+    for (GList *l = batteries; l != NULL; l = l->next) {
+        struct psy_battery *bat = l->data;
+        struct psy_attr *attrs[] = {&bat->sysfs_present, &bat->sysfs_status, &bat->sysfs_level_now,
+                                    &bat->sysfs_level_full, &bat->sysfs_rate_now};
+        for (size_t i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+            gchar *data;
+            if (file_get_contents( attrs[i]->path, &data) != -1)
+                free( data);
+        }
+    }
+    for (GList *l = mains; l != NULL; l = l->next) {
+        struct psy_mains *ac = l->data;
+        gchar *data;
+        if (file_get_contents( ac->sysfs_online.path, &data) != -1)
+            free( data);
+    }
+}
+
+void bench_battery()
+{
+    if (!battery_os_init() || !batteries) {
+        fprintf(stderr, "tint2: no battery found in %s/sys/class/power_supply\n", battery_sys_prefix);
+        return;
+    }
+    const int iterations = 10000;
+    BatteryState state;
+    // The first update opens the files
+    battery_os_update(&state);
+
+    psy_syscalls = 0;
+    double start = get_time();
+    for (int i = 0; i < iterations; i++)
+        bench_battery_read_all_files();
+    double t_reopen = (get_time() - start) / iterations;
+    double syscalls_reopen = psy_syscalls / (double)iterations;
+
+    psy_syscalls = 0;
+    start = get_time();
+    for (int i = 0; i < iterations; i++)
+        battery_os_update(&state);
+    double t_pread = (get_time() - start) / iterations;
+    double syscalls_pread = psy_syscalls / (double)iterations;
+
+    fprintf(stdout, "%10s %14s %14s\n", "", "syscalls", "time (us)");
+    fprintf(stdout, "%10s %14.1f %14.2f\n", "reopen", syscalls_reopen, t_reopen * 1e6);
+    fprintf(stdout, "%10s %14.1f %14.2f\n", "pread", syscalls_pread, t_pread * 1e6);
+    battery_os_free();
+}
+
 #endif
@@ -166,7 +166,7 @@ void init_button_panel(void *p)
                                            backend->rclick_command || backend->uwheel_command ||
                                            backend->dwheel_command);
 
-        area->resize_needed = TRUE;
+        schedule_resize(area);
         area->on_screen = TRUE;
         area_gradients_create(area);
 
@@ -200,13 +200,13 @@ void button_default_font_changed()
 
     button_init_fonts();
     for (int i = 0; i < num_panels; i++) {
-        for (GList *l = panels[i].button_list; l; l = l->next)
+        for (GList *l = panels[i]->button_list; l; l = l->next)
         {
             Button *button = l->data;
             Area *area = &button->area;
 
             if (!button->backend->has_font) {
-                area->resize_needed = TRUE;
+                schedule_resize(area);
                 schedule_redraw(area);
             }
         }
@@ -264,18 +264,23 @@ void button_reload_icon(Button *button)
 void button_default_icon_theme_changed()
 {
     for (int i = 0; i < num_panels; i++)
-        for (GList *l = panels[i].button_list; l; l = l->next)
+        for (GList *l = panels[i]->button_list; l; l = l->next)
             button_reload_icon(l->data);
     schedule_panel_redraw();
 }
 
+void cleanup_button_panel(void *p)
+{
+    Panel *panel = p;
+    g_list_free_full(panel->button_list, destroy_button);
+    panel->button_list = NULL;
+}
+
 void cleanup_button()
 {
     // Cleanup frontends
-    for (int i = 0; i < num_panels; i++) {
-        g_list_free_full(panels[i].button_list, destroy_button);
-        panels[i].button_list = NULL;
-    }
+    for (int i = 0; i < num_panels; i++)
+        cleanup_button_panel(panels[i]);
 
     // Cleanup backends
     g_list_free_full(panel_config.button_list, destroy_button);
@@ -97,6 +97,10 @@ void init_button_panel(void *panel);
 // Initializes the state of the frontend items. Also adds a pointer to it in backend->instances.
 // At this point the Area has not been added yet to the GUI tree, but it will be added right away.
 
+void cleanup_button_panel(void *panel);
+// Called before a panel is destroyed while tint2 keeps running, e.g. when a monitor is unplugged.
+// Releases the frontend items of the panel and removes them from backend->instances.
+
 void cleanup_button();
 // Called just before the panels are destroyed. Afterwards, tint2 exits or restarts and reads the config again.
 // Releases all frontends and then all the backends.
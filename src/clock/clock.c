@@ -31,6 +31,7 @@
 #include "clock.h"
 #include "timer.h"
 #include "common.h"
+#include "test.h"
 
 char *time1_format;
 char *time1_timezone;
@@ -59,6 +60,35 @@ static char buf_tooltip[512];
 gboolean clock_enabled;
 static Timer clock_timer;
 
+// Period in seconds of the finest field shown by a strftime format
+typedef enum ClockResolution {
+    CLOCK_SECOND = 1,
+    CLOCK_MINUTE = 60,
+    CLOCK_HOUR = 3600,
+    CLOCK_DAY = 86400,
+} ClockResolution;
+
+// Upper limit for the time between updates, so that changes of the system time are noticed
+#define MAX_CLOCK_SLEEP_S 3600
+
+// UTC offset of a timezone over a time interval in which it does not change
+typedef struct TimezoneCache {
+    char *timezone; // NULL for the local time
+    time_t valid_from, valid_until;
+    long gmtoff;
+    int isdst;
+    char zone[16];
+} TimezoneCache;
+
+static GList *timezone_cache;
+
+static void free_timezone_cache(void *data)
+{
+    TimezoneCache *tz = data;
+    free(tz->timezone);
+    free(tz);
+}
+
 void clock_init_fonts();
 char *clock_get_tooltip(void *obj);
 int clock_get_desired_size(void *obj);
@@ -106,21 +136,158 @@ void cleanup_clock()
     free_and_null( clock_uwheel_command);
     free_and_null( clock_dwheel_command);
     destroy_timer(&clock_timer);
+    g_list_free_full(timezone_cache, free_timezone_cache);
+    timezone_cache = NULL;
 }
 
-struct tm *clock_gettime_for_tz(const char *timezone)
+static void localtime_for_tz(const char *timezone, time_t t, struct tm *result)
+// Slow: switching TZ makes the C library read the zone file again
 {
-    if (timezone) {
-        const char *old_tz = getenv("TZ");
-        setenv("TZ", timezone, 1);
-        struct tm *result = localtime(&time_clock.tv_sec);
-        if (old_tz)
-            setenv("TZ", old_tz, 1);
+    if (!timezone) {
+        // localtime_r does not check whether TZ or /etc/localtime changed, tzset does
+        tzset();
+        localtime_r(&t, result);
+        return;
+    }
+    char *old_tz = getenv("TZ") ? strdup(getenv("TZ")) : NULL;
+    setenv("TZ", timezone, 1);
+    tzset();
+    localtime_r(&t, result);
+    if (old_tz) {
+        setenv("TZ", old_tz, 1);
+        free(old_tz);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+}
+
+static gboolean timezone_cache_matches(TimezoneCache *tz, struct tm *tm)
+{
+    return tm->tm_gmtoff == tz->gmtoff && tm->tm_isdst == tz->isdst && strncmp(tm->tm_zone, tz->zone, sizeof(tz->zone) - 1) == 0;
+}
+
+static void refresh_timezone_cache(TimezoneCache *tz, time_t t)
+// Looks for the next change of the offset within a day, and bisects to the exact transition time.
+// Offsets change a few times a year at most, so this runs about once per day.
+{
+    struct tm tm;
+    localtime_for_tz(tz->timezone, t, &tm);
+    tz->gmtoff = tm.tm_gmtoff;
+    tz->isdst = tm.tm_isdst;
+    snprintf(tz->zone, sizeof(tz->zone), "%s", tm.tm_zone ? tm.tm_zone : "");
+    tz->valid_from = t;
+
+    time_t same = t, changed = t + CLOCK_DAY;
+    localtime_for_tz(tz->timezone, changed, &tm);
+    if (timezone_cache_matches(tz, &tm)) {
+        tz->valid_until = changed;
+        return;
+    }
+    while (changed - same > 1) {
+        time_t middle = same + (changed - same) / 2;
+        localtime_for_tz(tz->timezone, middle, &tm);
+        if (timezone_cache_matches(tz, &tm))
+            same = middle;
         else
-            unsetenv("TZ");
-        return result;
-    } else
-        return localtime(&time_clock.tv_sec);
+            changed = middle;
+    }
+    tz->valid_until = changed;
+}
+
+static TimezoneCache *get_timezone_cache(const char *timezone, time_t t)
+{
+    TimezoneCache *tz = NULL;
+    for (GList *l = timezone_cache; l; l = l->next) {
+        if (g_strcmp0(((TimezoneCache *)l->data)->timezone, timezone) == 0) {
+            tz = l->data;
+            break;
+        }
+    }
+    if (!tz) {
+        tz = calloc(1, sizeof(TimezoneCache));
+        tz->timezone = timezone ? strdup(timezone) : NULL;
+        timezone_cache = g_list_prepend(timezone_cache, tz);
+        refresh_timezone_cache(tz, t);
+    } else if (t < tz->valid_from || t >= tz->valid_until) {
+        refresh_timezone_cache(tz, t);
+    }
+    return tz;
+}
+
+static void revalidate_local_timezone(time_t t)
+// The local zone can change at any time (e.g. timedatectl set-timezone), not only at the cached transitions
+{
+    for (GList *l = timezone_cache; l; l = l->next) {
+        TimezoneCache *tz = l->data;
+        if (tz->timezone)
+            continue;
+        struct tm tm;
+        localtime_for_tz(NULL, t, &tm);
+        if (!timezone_cache_matches(tz, &tm))
+            refresh_timezone_cache(tz, t);
+        return;
+    }
+}
+
+struct tm *clock_gettime_for_tz(const char *timezone)
+{
+    static struct tm result;
+    TimezoneCache *tz = get_timezone_cache(timezone, time_clock.tv_sec);
+    time_t local = time_clock.tv_sec + tz->gmtoff;
+    gmtime_r(&local, &result);
+    result.tm_isdst = tz->isdst;
+    result.tm_gmtoff = tz->gmtoff;
+    result.tm_zone = tz->zone;
+    return &result;
+}
+
+static ClockResolution clock_format_resolution(const char *format)
+{
+    ClockResolution resolution = CLOCK_DAY;
+    for (const char *p = format; p && *p; p++) {
+        if (*p != '%')
+            continue;
+        p++;
+        // Flags, field width and modifiers
+        while (*p && strchr("_-0^#", *p))
+            p++;
+        while (*p >= '0' && *p <= '9')
+            p++;
+        while (*p == 'E' || *p == 'O')
+            p++;
+        switch (*p) {
+        case '\0':
+            return resolution;
+        case '%': case 'n': case 't':
+        case 'a': case 'A': case 'b': case 'B': case 'h': case 'C': case 'd': case 'D': case 'e': case 'F':
+        case 'g': case 'G': case 'j': case 'm': case 'u': case 'U': case 'V': case 'w': case 'W': case 'x':
+        case 'y': case 'Y': case 'z': case 'Z':
+            // Changes of the timezone offset are handled separately
+            break;
+        case 'H': case 'I': case 'k': case 'l': case 'p': case 'P':
+            resolution = MIN(resolution, CLOCK_HOUR);
+            break;
+        case 'M': case 'R':
+            resolution = MIN(resolution, CLOCK_MINUTE);
+            break;
+        default:
+            // Seconds (%S, %s, %T, %r, %X, %c...) and unknown conversions
+            resolution = CLOCK_SECOND;
+            break;
+        }
+    }
+    return resolution;
+}
+
+static time_t next_clock_update(const char *format, const char *timezone, time_t now)
+// Returns the time at which the text of the format changes next
+{
+    ClockResolution resolution = clock_format_resolution(format);
+    TimezoneCache *tz = get_timezone_cache(timezone, now);
+    time_t local = now + tz->gmtoff;
+    time_t next = now + resolution - ((local % resolution) + resolution) % resolution;
+    return MIN(next, tz->valid_until);
 }
 
 void update_clock_text(char *dst, size_t size, const char *format,
@@ -129,7 +296,7 @@ void update_clock_text(char *dst, size_t size, const char *format,
     if (!dst || !format)
         return;
 
-    char tmp[256] = "";
+    char tmp[512] = "";
     strncpy(tmp, dst, strlen_const(tmp));
     strftime(dst, size, format, clock_gettime_for_tz(timezone));
     *changed = *changed || strcmp(dst, tmp) != 0;
@@ -138,31 +305,45 @@ void update_clock_text(char *dst, size_t size, const char *format,
 void update_clocks()
 {
     bool changed = false;
+    bool tooltip_changed = false;
     update_clock_text(buf_time, sizeof(buf_time), time1_format, time1_timezone, &changed);
     update_clock_text(buf_date, sizeof(buf_date), time2_format, time2_timezone, &changed);
-    if (changed) {
+    update_clock_text(buf_tooltip, sizeof(buf_tooltip), time_tooltip_format, time_tooltip_timezone, &tooltip_changed);
+    if (changed || tooltip_changed) {
         for (int i = 0; i < num_panels; i++)
         {
-            panels[i].clock.area.resize_needed = TRUE;
-            tooltip_update_for_area (&panels[i].clock.area);
+            if (changed)
+                schedule_resize(&panels[i]->clock.area);
+            tooltip_update_for_area (&panels[i]->clock.area);
         }
-        schedule_panel_redraw();
+        if (changed)
+            schedule_panel_redraw();
     }
 }
 
-int ms_until_second_change(struct timeval* tm)
+int ms_until_clock_change(struct timeval *tm)
 {
-    long us_until_change = 1000000 - tm->tv_usec;
+    time_t next = tm->tv_sec + MAX_CLOCK_SLEEP_S;
+    if (time1_format)
+        next = MIN(next, next_clock_update(time1_format, time1_timezone, tm->tv_sec));
+    if (time2_format)
+        next = MIN(next, next_clock_update(time2_format, time2_timezone, tm->tv_sec));
+    if (time_tooltip_format)
+        next = MIN(next, next_clock_update(time_tooltip_format, time_tooltip_timezone, tm->tv_sec));
+    long long us_until_change = (next - tm->tv_sec) * 1000000LL - tm->tv_usec;
     // compute ms, rounding up so we don't ask to wait too short
-    int ms = (us_until_change+999)/1000;
-    return ms;
+    return (us_until_change + 999) / 1000;
 }
 
-void update_clocks_sec(void *arg)
+void update_clocks_on_timer(void *arg)
 {
     gettimeofday(&time_clock, 0);
+    revalidate_local_timezone(time_clock.tv_sec);
     update_clocks();
-    change_timer(&clock_timer, true, ms_until_second_change(&time_clock), 0, update_clocks_sec, 0);
+    int ms = ms_until_clock_change(&time_clock);
+    if (debug_timers)
+        fprintf(stderr, "tint2: clock: next update in %d ms\n", ms);
+    change_timer(&clock_timer, true, ms, 0, update_clocks_on_timer, 0);
 }
 
 void init_clock()
@@ -193,7 +374,7 @@ void init_clock_panel(void *p)
     if (!time1_format)
         return;
 
-    clock->area.resize_needed = TRUE;
+    schedule_resize(&clock->area);
     clock->area.on_screen = TRUE;
     area_gradients_create(&clock->area);
 
@@ -203,7 +384,7 @@ void init_clock_panel(void *p)
     }
 
     if (!clock_timer.enabled_)
-        update_clocks_sec(NULL);
+        update_clocks_on_timer(NULL);
 }
 
 void clock_init_fonts()
@@ -239,8 +420,8 @@ void clock_default_font_changed()
     }
     clock_init_fonts();
     for (int i = 0; i < num_panels; i++) {
-        panels[i].clock.area.resize_needed = TRUE;
-        schedule_redraw(&panels[i].clock.area);
+        schedule_resize(&panels[i]->clock.area);
+        schedule_redraw(&panels[i]->clock.area);
     }
     schedule_panel_redraw();
 }
@@ -327,3 +508,57 @@ void clock_action(void *obj, int button, int x, int y, Time time)
     }
     tint_exec(command, NULL, NULL, time, obj, x, y, FALSE, TRUE);
 }
+
+TEST(clock_format_resolution)
+{
+    ASSERT_EQUAL(clock_format_resolution("%H:%M:%S"), CLOCK_SECOND);
+    ASSERT_EQUAL(clock_format_resolution("%T"), CLOCK_SECOND);
+    ASSERT_EQUAL(clock_format_resolution("%H:%M"), CLOCK_MINUTE);
+    ASSERT_EQUAL(clock_format_resolution("%-I:%02M %p"), CLOCK_MINUTE);
+    ASSERT_EQUAL(clock_format_resolution("%a %d %b, %Hh"), CLOCK_HOUR);
+    ASSERT_EQUAL(clock_format_resolution("%A %x"), CLOCK_DAY);
+    ASSERT_EQUAL(clock_format_resolution("100%% %Y"), CLOCK_DAY);
+    ASSERT_EQUAL(clock_format_resolution("%"), CLOCK_DAY);
+}
+
+TEST(clock_next_update)
+{
+    // 2022-03-27 00:59:40 UTC, 20 seconds before the switch to summer time in central Europe
+    const time_t now = 1648342780;
+    const char *cet = "CET-1CEST,M3.5.0,M10.5.0/3";
+    ASSERT_EQUAL(next_clock_update("%H:%M:%S", "UTC0", now), now + 1);
+    ASSERT_EQUAL(next_clock_update("%H:%M", "UTC0", now), now + 20);
+    ASSERT_EQUAL(next_clock_update("%d", "UTC0", now), now + 23 * 3600 + 20);
+    // The offset changes before the next day starts
+    ASSERT_EQUAL(next_clock_update("%d", cet, now), now + 20);
+
+    TimezoneCache *tz = get_timezone_cache(cet, now);
+    ASSERT_EQUAL(tz->gmtoff, 3600);
+    ASSERT_EQUAL(tz->valid_until, now + 20);
+    tz = get_timezone_cache(cet, now + 20);
+    ASSERT_EQUAL(tz->gmtoff, 7200);
+    ASSERT_STR_EQUAL(tz->zone, "CEST");
+
+    g_list_free_full(timezone_cache, free_timezone_cache);
+    timezone_cache = NULL;
+}
+
+TEST(clock_local_timezone_change)
+{
+    const time_t now = 1648342780;
+    setenv("TZ", "UTC0", 1);
+    TimezoneCache *tz = get_timezone_cache(NULL, now);
+    ASSERT_EQUAL(tz->gmtoff, 0);
+
+    // Picked up on the next timer, not at the end of the cached interval
+    setenv("TZ", "JST-9", 1);
+    revalidate_local_timezone(now + 60);
+    ASSERT_EQUAL(tz->gmtoff, 9 * 3600);
+    ASSERT_STR_EQUAL(tz->zone, "JST");
+    ASSERT_EQUAL(get_timezone_cache(NULL, now + 60), tz);
+
+    unsetenv("TZ");
+    tzset();
+    g_list_free_full(timezone_cache, free_timezone_cache);
+    timezone_cache = NULL;
+}
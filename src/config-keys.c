@@ -96,6 +96,7 @@ char *cfg_keys[] = {
     [key_execp_tooltip                          ]="execp_tooltip",
     [key_execp_uwheel_command                   ]="execp_uwheel_command",
     [key_execp_uwheel_command_sink              ]="execp_uwheel_command_sink",
+    [key_execp_worker                           ]="execp_worker",
     [key_font_shadow                            ]="font_shadow",
     [key_gradient                               ]="gradient",
     [key_gradient_id                            ]="gradient_id",
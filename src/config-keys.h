@@ -95,6 +95,7 @@ typedef enum {
     key_execp_tooltip,
     key_execp_uwheel_command,
     key_execp_uwheel_command_sink,
+    key_execp_worker,
     key_font_shadow,
     key_gradient,
     key_gradient_id,
@@ -35,6 +35,7 @@
 #include <pango/pango-font.h>
 #include <Imlib2.h>
 
+#include "arena.h"
 #include "config.h"
 #include "config-keys.h"
 
@@ -55,6 +56,7 @@
 #include "timer.h"
 #include "separator.h"
 #include "execplugin.h"
+#include "test.h"
 
 #ifdef ENABLE_BATTERY
 #include "battery.h"
@@ -120,6 +122,7 @@ void cleanup_config()
 {
     free_and_null(config_path);
     free_and_null(snapshot_path);
+    arena_free(&config_arena);
 }
 
 void get_action(char *event, MouseAction *action)
@@ -201,30 +204,17 @@ void load_launcher_app_dir(const char *path)
 
     GDir *d = g_dir_open(path, 0, NULL);
     if (d) {
-        size_t  path_len = strlen (path),
-                buf_len = 0;
         const gchar *name;
-        gchar *file = NULL;
         while ((name = g_dir_read_name(d)))
         {
-            size_t _buf_len = path_len + 1 + strlen (name) + 1;
-            if (! file || _buf_len > buf_len) {
-                file = realloc( file, (buf_len = _buf_len));
-                file [buf_len-1] = '\0';
-            }
+            // Only the paths of the desktop files are kept, the rest lives until the config is read
             int tmpval;
-            snprintf (file, buf_len - 1, "%s/%s", path, name);
-            if (!g_file_test(file, G_FILE_TEST_IS_DIR) && str_has_const_suffix( file, ".desktop", tmpval)) {
-                files = g_list_prepend(files, file);
-                file = NULL;
-            } else if (g_file_test(file, G_FILE_TEST_IS_DIR)) {
+            gchar *file = arena_printf(&config_arena, "%s/%s", path, name);
+            if (g_file_test(file, G_FILE_TEST_IS_DIR))
                 subdirs = g_list_prepend(subdirs, file);
-                file = NULL;
-            } else
-                free( file);
+            else if (str_has_const_suffix( file, ".desktop", tmpval))
+                files = g_list_prepend(files, strdup(file));
         }
-        if (file)
-            free( file);
         g_dir_close(d);
     }
 
@@ -233,9 +223,7 @@ void load_launcher_app_dir(const char *path)
          l;
          l = (p = l)->next, g_list_free_1( p))
     {
-        gchar *dir = l->data;
-        load_launcher_app_dir(dir);
-        free( dir);
+        load_launcher_app_dir(l->data);
     }
 
     files = g_list_sort(files, compare_strings);
@@ -745,6 +733,13 @@ void add_entry(char *key, char *value)
         }
         break;
     }
+    case key_execp_worker: {
+        Execp *execp = get_or_create_last_execp();
+        free_and_null(execp->backend->worker_name);
+        if (value && *value)
+            execp->backend->worker_name = strdup(value);
+        break;
+    }
     case key_execp_monitor:
         get_or_create_last_execp()->backend->monitor = config_get_monitor(value);
         break;
@@ -1345,6 +1340,7 @@ gboolean config_read_file(const char *path)
     }
     free(line);
     fclose(fp);
+    arena_reset(&config_arena);
 
     if (!read_panel_position) {
         panel_horizontal = TRUE;
@@ -1441,4 +1437,27 @@ gboolean config_read()
                         : config_read_default_path ();
 }
 
+BENCH(config_read_file)
+{
+    // Parses the default config. The benchmark runs in its own process, so the previous values are not freed.
+    gchar *path = NULL;
+    int fd = g_file_open_tmp("tint2rc-bench-XXXXXX", &path, NULL);
+    if (fd < 0)
+        BENCH_SKIP("could not create a temporary file");
+    if (write(fd, themes_tint2rc, themes_tint2rc_len) != (ssize_t)themes_tint2rc_len) {
+        close(fd);
+        unlink(path);
+        g_free(path);
+        BENCH_SKIP("could not write the temporary file");
+    }
+    close(fd);
+    BENCH_LOOP {
+        default_config();
+        default_panel();
+        config_read_file(path);
+    }
+    unlink(path);
+    g_free(path);
+}
+
 #endif
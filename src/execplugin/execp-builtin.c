@@ -0,0 +1,450 @@
+/**************************************************************************
+*
+* Tint2 : built-in metric sources for executors
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "execp-builtin.h"
+#include "common.h"
+#include "test.h"
+#include "timer.h"
+
+typedef enum ExecpBuiltinSource {
+    BUILTIN_CPU = 0,
+    BUILTIN_MEM,
+    BUILTIN_NET,
+    BUILTIN_DISK,
+    BUILTIN_THERMAL,
+    BUILTIN_SOURCES
+} ExecpBuiltinSource;
+
+static const char *builtin_names[BUILTIN_SOURCES] = {"cpu", "mem", "net", "disk", "thermal"};
+static const char *builtin_files[BUILTIN_SOURCES] = {"/proc/stat", "/proc/meminfo", "/proc/net/dev", "/proc/diskstats", NULL};
+static const char *builtin_formats[BUILTIN_SOURCES] = {"CPU %u%%", "MEM %u%%", "%d↓ %u↑", "R %r W %w", "%t°C"};
+
+// Size of the first read buffer, and the size at which it stops growing
+#define BUILTIN_READ_SIZE (32 * 1024)
+#define BUILTIN_READ_MAX (4 * 1024 * 1024)
+
+struct ExecpBuiltin {
+    ExecpBuiltinSource source;
+    char *param;
+    char *format;
+    char *path;
+    int fd;
+    char *buf;                  // Contents of the file, kept between samples
+    size_t buf_size;
+    gboolean truncated;         // The file did not fit in BUILTIN_READ_MAX bytes, logged once
+    char **disks;               // Whole disks summed by the disk source when no device is given
+    double prev_time;           // Time of the previous sample, 0 if none
+    unsigned long long prev[2]; // cpu: busy, total jiffies; net: rx, tx bytes; disk: read, written bytes
+};
+
+typedef struct BuiltinField {
+    char key;
+    char value[32];
+} BuiltinField;
+
+static char **builtin_list_disks()
+{
+    GPtrArray *disks = g_ptr_array_new();
+    GDir *dir = g_dir_open("/sys/block", 0, NULL);
+    if (dir) {
+        const gchar *name;
+        // Skip virtual devices and devices stacked on top of other disks
+        const char *skip[] = {"loop", "ram", "zram", "dm-", "md", "sr", "fd", NULL};
+        while ((name = g_dir_read_name(dir))) {
+            gboolean skipped = FALSE;
+            for (int i = 0; skip[i] && !skipped; i++)
+                skipped = g_str_has_prefix(name, skip[i]);
+            if (!skipped)
+                g_ptr_array_add(disks, g_strdup(name));
+        }
+        g_dir_close(dir);
+    }
+    g_ptr_array_add(disks, NULL);
+    return (char **)g_ptr_array_free(disks, FALSE);
+}
+
+ExecpBuiltin *execp_builtin_new(const char *command)
+{
+    if (!command || !g_str_has_prefix(command, "builtin:"))
+        return NULL;
+    const char *spec = command + strlen_const("builtin:");
+
+    size_t spec_len = strcspn(spec, " \t");
+    size_t name_len = strcspn(spec, ": \t");
+    int source;
+    for (source = 0; source < BUILTIN_SOURCES; source++)
+        if (strlen(builtin_names[source]) == name_len && strncmp(spec, builtin_names[source], name_len) == 0)
+            break;
+    if (source == BUILTIN_SOURCES) {
+        fprintf(stderr, "tint2: unknown built-in executor source: %s\n", command);
+        return NULL;
+    }
+
+    ExecpBuiltin *builtin = calloc(1, sizeof(ExecpBuiltin));
+    builtin->source = source;
+    builtin->fd = -1;
+    if (name_len < spec_len)
+        builtin->param = g_strndup(spec + name_len + 1, spec_len - name_len - 1);
+
+    const char *format = spec + spec_len;
+    while (*format == ' ' || *format == '\t')
+        format++;
+    builtin->format = strdup(*format ? format : builtin_formats[source]);
+
+    if (source == BUILTIN_CPU) {
+        // "builtin:cpu:3" means the line cpu3
+        char *line = strdup_printf(NULL, "cpu%s", builtin->param ? builtin->param : "");
+        free(builtin->param);
+        builtin->param = line;
+    }
+    if (source == BUILTIN_DISK && !builtin->param)
+        builtin->disks = builtin_list_disks();
+    if (source == BUILTIN_THERMAL) {
+        const char *zone = builtin->param ? builtin->param : "thermal_zone0";
+        builtin->path = zone[0] == '/' ? strdup(zone) : strdup_printf(NULL, "/sys/class/thermal/%s/temp", zone);
+    } else
+        builtin->path = strdup(builtin_files[source]);
+    return builtin;
+}
+
+void execp_builtin_free(ExecpBuiltin *builtin)
+{
+    if (!builtin)
+        return;
+    if (builtin->fd >= 0)
+        close(builtin->fd);
+    g_strfreev(builtin->disks);
+    free(builtin->buf);
+    free(builtin->param);
+    free(builtin->format);
+    free(builtin->path);
+    free(builtin);
+}
+
+static const char *builtin_read(ExecpBuiltin *builtin)
+// Reads the whole file into the buffer of the builtin, which grows as needed.
+// procfs files may return less than asked for in a single read (e.g. /proc/net/dev with many interfaces).
+// Returns NULL on error.
+{
+    if (builtin->fd < 0)
+        builtin->fd = open(builtin->path, O_RDONLY | O_CLOEXEC);
+    if (builtin->fd < 0)
+        return NULL;
+    if (!builtin->buf) {
+        builtin->buf_size = BUILTIN_READ_SIZE;
+        builtin->buf = malloc(builtin->buf_size);
+    }
+    size_t len = 0;
+    while (TRUE) {
+        if (len + 1 == builtin->buf_size) {
+            if (builtin->buf_size >= BUILTIN_READ_MAX) {
+                if (!builtin->truncated)
+                    fprintf(stderr, "tint2: %s is larger than %d bytes, the rest is ignored\n",
+                            builtin->path, BUILTIN_READ_MAX);
+                builtin->truncated = TRUE;
+                break;
+            }
+            builtin->buf_size *= 2;
+            builtin->buf = realloc(builtin->buf, builtin->buf_size);
+        }
+        ssize_t count = pread(builtin->fd, builtin->buf + len, builtin->buf_size - 1 - len, len);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0) {
+            // Reopen on the next sample, in case the file went away
+            close(builtin->fd);
+            builtin->fd = -1;
+            return NULL;
+        }
+        if (count == 0)
+            break;
+        len += count;
+    }
+    builtin->buf[len] = '\0';
+    return builtin->buf;
+}
+
+static void builtin_format_bytes(double bytes, char *buf, size_t size)
+{
+    const char *units = "BKMGTP";
+    int u = 0;
+    while (bytes >= 1024 && units[u + 1])
+        bytes /= 1024, u++;
+    snprintf(buf, size, u && bytes < 10 ? "%.1f%c" : "%.0f%c", bytes, units[u]);
+}
+
+static void builtin_expand(const char *format, const BuiltinField *fields, int num_fields, char *text, size_t size)
+{
+    size_t len = 0;
+    for (const char *p = format; *p && len + 1 < size; p++) {
+        const char *value = NULL;
+        if (*p == '%' && p[1]) {
+            p++;
+            if (*p == '%')
+                value = "%";
+            for (int i = 0; i < num_fields && !value; i++)
+                if (fields[i].key == *p)
+                    value = fields[i].value;
+            if (!value)
+                value = "?";
+        }
+        if (value) {
+            size_t n = MIN(strlen(value), size - 1 - len);
+            memcpy(text + len, value, n);
+            len += n;
+        } else
+            text[len++] = *p;
+    }
+    text[len] = '\0';
+}
+
+static const char *builtin_find_line(const char *buf, const char *name)
+// Returns the rest of the line starting with the word name, or NULL.
+{
+    size_t name_len = strlen(name);
+    for (const char *line = buf; line && *line; line = strchr(line, '\n'), line = line ? line + 1 : NULL) {
+        while (*line == ' ')
+            line++;
+        if (strncmp(line, name, name_len) == 0 && (line[name_len] == ' ' || line[name_len] == ':'))
+            return line + name_len + 1;
+    }
+    return NULL;
+}
+
+static gboolean builtin_parse_cpu(const char *stat, const char *name, unsigned long long *busy, unsigned long long *total)
+{
+    const char *line = builtin_find_line(stat, name);
+    if (!line)
+        return FALSE;
+    // user nice system idle iowait irq softirq steal; guest time is already included in user
+    unsigned long long v[8] = {0};
+    char *end;
+    for (int i = 0; i < 8; i++, line = end)
+        v[i] = strtoull(line, &end, 10);
+    *total = 0;
+    for (int i = 0; i < 8; i++)
+        *total += v[i];
+    *busy = *total - v[3] - v[4];
+    return TRUE;
+}
+
+static unsigned long long builtin_parse_meminfo(const char *meminfo, const char *key)
+{
+    const char *line = builtin_find_line(meminfo, key);
+    return line ? strtoull(line, NULL, 10) * 1024 : 0;
+}
+
+static gboolean builtin_parse_net(const char *dev, const char *iface, unsigned long long *rx, unsigned long long *tx)
+{
+    *rx = *tx = 0;
+    gboolean found = FALSE;
+    // Skip the two header lines
+    const char *line = strchr(dev, '\n');
+    line = line ? strchr(line + 1, '\n') : NULL;
+    for (; line && *++line; line = strchr(line, '\n')) {
+        while (*line == ' ')
+            line++;
+        const char *colon = strchr(line, ':');
+        if (!colon)
+            break;
+        size_t len = colon - line;
+        gboolean match = iface ? strlen(iface) == len && strncmp(line, iface, len) == 0
+                               : !(len == 2 && strncmp(line, "lo", 2) == 0);
+        if (!match)
+            continue;
+        // rx: bytes packets errs drop fifo frame compressed multicast, then tx: bytes ...
+        unsigned long long v[9];
+        char *end;
+        const char *p = colon + 1;
+        for (int i = 0; i < 9; i++, p = end)
+            v[i] = strtoull(p, &end, 10);
+        *rx += v[0];
+        *tx += v[8];
+        found = TRUE;
+    }
+    return found;
+}
+
+static gboolean builtin_parse_disk(const char *diskstats, const char *device, char **disks,
+                                   unsigned long long *read, unsigned long long *written)
+{
+    *read = *written = 0;
+    gboolean found = FALSE;
+    for (const char *line = diskstats; line && *line; line = strchr(line, '\n'), line = line ? line + 1 : NULL) {
+        char name[64];
+        unsigned long long sectors_read, sectors_written;
+        if (sscanf(line, "%*u %*u %63s %*u %*u %llu %*u %*u %*u %llu", name, &sectors_read, &sectors_written) != 3)
+            continue;
+        if (device ? strcmp(name, device) != 0 : !disks || !g_strv_contains((const gchar *const *)disks, name))
+            continue;
+        // Sectors are always 512 bytes here, regardless of the device
+        *read += sectors_read * 512;
+        *written += sectors_written * 512;
+        found = TRUE;
+    }
+    return found;
+}
+
+static int builtin_sample_fields(ExecpBuiltin *builtin, BuiltinField *fields)
+{
+    const char *buf = builtin_read(builtin);
+    if (!buf)
+        return 0;
+
+    double now = get_time();
+    double elapsed = builtin->prev_time > 0 ? now - builtin->prev_time : 0;
+    unsigned long long cur[2];
+    int n = 0;
+
+    switch (builtin->source) {
+    case BUILTIN_CPU: {
+        if (!builtin_parse_cpu(buf, builtin->param, &cur[0], &cur[1]))
+            return 0;
+        // The first sample shows the average since boot
+        unsigned long long busy = cur[0] - builtin->prev[0];
+        unsigned long long total = cur[1] - builtin->prev[1];
+        fields[n].key = 'u';
+        snprintf(fields[n++].value, sizeof(fields[0].value), "%d", total ? (int)(100 * busy / total) : 0);
+        break;
+    }
+    case BUILTIN_MEM: {
+        unsigned long long total = builtin_parse_meminfo(buf, "MemTotal");
+        unsigned long long available = builtin_parse_meminfo(buf, "MemAvailable");
+        unsigned long long swap_total = builtin_parse_meminfo(buf, "SwapTotal");
+        unsigned long long swap_free = builtin_parse_meminfo(buf, "SwapFree");
+        if (!total)
+            return 0;
+        fields[n].key = 'u';
+        snprintf(fields[n++].value, sizeof(fields[0].value), "%d", (int)(100 * (total - available) / total));
+        fields[n].key = 'U';
+        builtin_format_bytes(total - available, fields[n++].value, sizeof(fields[0].value));
+        fields[n].key = 'a';
+        builtin_format_bytes(available, fields[n++].value, sizeof(fields[0].value));
+        fields[n].key = 't';
+        builtin_format_bytes(total, fields[n++].value, sizeof(fields[0].value));
+        fields[n].key = 's';
+        snprintf(fields[n++].value, sizeof(fields[0].value), "%d",
+                 swap_total ? (int)(100 * (swap_total - swap_free) / swap_total) : 0);
+        break;
+    }
+    case BUILTIN_NET:
+    case BUILTIN_DISK: {
+        gboolean ok = builtin->source == BUILTIN_NET
+                      ? builtin_parse_net(buf, builtin->param, &cur[0], &cur[1])
+                      : builtin_parse_disk(buf, builtin->param, builtin->disks, &cur[0], &cur[1]);
+        if (!ok)
+            return 0;
+        const char *keys = builtin->source == BUILTIN_NET ? "duDU" : "rwRW";
+        for (int i = 0; i < 2; i++) {
+            // Counters may wrap or reset when the device is re-added
+            double rate = elapsed > 0 && cur[i] >= builtin->prev[i] ? (cur[i] - builtin->prev[i]) / elapsed : 0;
+            fields[n].key = keys[i];
+            builtin_format_bytes(rate, fields[n++].value, sizeof(fields[0].value));
+            fields[n].key = keys[i + 2];
+            builtin_format_bytes(cur[i], fields[n++].value, sizeof(fields[0].value));
+        }
+        break;
+    }
+    case BUILTIN_THERMAL:
+        fields[n].key = 't';
+        snprintf(fields[n++].value, sizeof(fields[0].value), "%d", (int)(atol(buf) / 1000));
+        break;
+    default:
+        return 0;
+    }
+
+    builtin->prev[0] = cur[0];
+    builtin->prev[1] = cur[1];
+    builtin->prev_time = now;
+    return n;
+}
+
+void execp_builtin_sample(ExecpBuiltin *builtin, char *text, size_t size)
+{
+    BuiltinField fields[8];
+    int n = builtin_sample_fields(builtin, fields);
+    builtin_expand(builtin->format, fields, n, text, size);
+}
+
+TEST(execp_builtin_expand) {
+    BuiltinField fields[] = {{'u', "42"}, {'d', "1.5K"}};
+    char text[64];
+    builtin_expand("CPU %u%% %d %x", fields, 2, text, sizeof(text));
+    ASSERT_STR_EQUAL(text, "CPU 42% 1.5K ?");
+    builtin_expand("%u%u%u", fields, 2, text, 5);
+    ASSERT_STR_EQUAL(text, "4242");
+}
+
+TEST(execp_builtin_parse) {
+    const char *stat = "cpu  100 0 100 700 100 0 0 0 0 0\n"
+                       "cpu0 50 0 50 350 50 0 0 0 0 0\n";
+    unsigned long long busy, total;
+    ASSERT_TRUE(builtin_parse_cpu(stat, "cpu0", &busy, &total));
+    ASSERT_EQUAL(busy, 100ULL);
+    ASSERT_EQUAL(total, 500ULL);
+    ASSERT_FALSE(builtin_parse_cpu(stat, "cpu1", &busy, &total));
+
+    const char *dev = "Inter-|   Receive                            |  Transmit\n"
+                      " face |bytes    packets errs drop fifo frame compressed multicast|bytes ...\n"
+                      "    lo: 1000 10 0 0 0 0 0 0 1000 10 0 0 0 0 0 0\n"
+                      "  eth0: 2000 20 0 0 0 0 0 0 3000 30 0 0 0 0 0 0\n"
+                      " wlan0: 4000 40 0 0 0 0 0 0 5000 50 0 0 0 0 0 0\n";
+    unsigned long long rx, tx;
+    ASSERT_TRUE(builtin_parse_net(dev, "eth0", &rx, &tx));
+    ASSERT_EQUAL(rx, 2000ULL);
+    ASSERT_EQUAL(tx, 3000ULL);
+    ASSERT_TRUE(builtin_parse_net(dev, NULL, &rx, &tx));
+    ASSERT_EQUAL(rx, 6000ULL);
+    ASSERT_EQUAL(tx, 8000ULL);
+}
+
+TEST(execp_builtin_read_large_file) {
+    // Larger than the first buffer, like /proc/net/dev with many interfaces
+    char path[] = "/tmp/tint2-test-builtin-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    const size_t size = 3 * BUILTIN_READ_SIZE + 100;
+    char *data = malloc(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+    ASSERT_EQUAL(write(fd, data, size), (ssize_t)size);
+    close(fd);
+
+    char *command = strdup_printf(NULL, "builtin:thermal:%s", path);
+    ExecpBuiltin *builtin = execp_builtin_new(command);
+    for (int sample = 0; sample < 2; sample++) {
+        const char *buf = builtin_read(builtin);
+        ASSERT_NON_NULL(buf);
+        ASSERT_EQUAL(strlen(buf), size);
+        ASSERT(memcmp(buf, data, size) == 0);
+    }
+    ASSERT_FALSE(builtin->truncated);
+
+    execp_builtin_free(builtin);
+    free(command);
+    free(data);
+    unlink(path);
+}
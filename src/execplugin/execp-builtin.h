@@ -0,0 +1,35 @@
+#ifndef EXECP_BUILTIN_H
+#define EXECP_BUILTIN_H
+
+#include <stddef.h>
+
+// Built-in metric sources for executors, used instead of running a command when
+// execp_command starts with "builtin:". The syntax is
+//
+//     builtin:<source>[:<parameter>] [template]
+//
+// Sources (parameter, template fields):
+//   cpu      core number, default all cores                %u usage percent
+//   mem      -                                             %u used percent, %U used, %a available, %t total,
+//                                                          %s swap used percent
+//   net      interface, default all except lo              %d download rate, %u upload rate,
+//                                                          %D downloaded, %U uploaded
+//   disk     device, default all disks                     %r read rate, %w write rate,
+//                                                          %R read, %W written
+//   thermal  zone in /sys/class/thermal or absolute path   %t temperature in degrees Celsius
+//            to a temperature file, default thermal_zone0
+// %% is a literal percent sign.
+//
+// The files are kept open and re-read with pread; rates and usage are computed between samples.
+
+typedef struct ExecpBuiltin ExecpBuiltin;
+
+ExecpBuiltin *execp_builtin_new(const char *command);
+// Returns NULL if command does not start with "builtin:" or names an unknown source.
+
+void execp_builtin_free(ExecpBuiltin *builtin);
+
+void execp_builtin_sample(ExecpBuiltin *builtin, char *text, size_t size);
+// Reads the source and writes the formatted text.
+
+#endif
@@ -11,6 +11,8 @@
 #include <errno.h>
 #include <time.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
 
 #include "window.h"
 #include "tooltip.h"
@@ -18,15 +20,56 @@
 #include "panel.h"
 #include "timer.h"
 #include "common.h"
+#include "launch.h"
+#include "execp-builtin.h"
+#include "test.h"
 
 bool debug_executors = false;
 
+// Worker shells (execp_worker).
+// A worker is a /bin/sh reading commands from its stdin. Each command is wrapped so that the shell prints
+// a start marker and an end marker on stdout and stderr around it. While a command runs, the worker pipes are used
+// as the pipes of the executor, and read_execp() reads them as usual until both end markers have arrived.
+// The markers carry the number of the run: output written outside of them, e.g. by a background job of an earlier
+// command, is discarded.
+// Executors sharing a worker are run one after another. A command that misses its deadline is killed with the
+// worker, and the executor runs in its own shell from then on.
+
+#define EXECP_WORKER_START_MARK "\036tint2-execp-start-%u\036\n"
+#define EXECP_WORKER_END_MARK "\036tint2-execp-done-%u\036\n"
+#define EXECP_WORKER_START_MARK_FORMAT "\\036tint2-execp-start-%u\\036\\n"
+#define EXECP_WORKER_END_MARK_FORMAT "\\036tint2-execp-done-%u\\036\\n"
+// Seconds a command may run in a worker, at least, or its interval if longer
+#define EXECP_WORKER_MIN_DEADLINE 10
+
+typedef struct ExecpWorker {
+    char *name;
+    pid_t pid;
+    int sock_stdin;         // A socket, so that a shell that exited causes EPIPE instead of SIGPIPE
+    int pipe_stdout;
+    int pipe_stderr;
+    ExecpBackend *current;  // Executor whose command is running
+    GQueue queue;           // Executors waiting for their turn
+    unsigned run;           // Number of the current command, written in its markers
+    gboolean started_stdout, started_stderr;    // Whether the start markers of the current command were received
+    Timer deadline_timer;
+} ExecpWorker;
+
+static GList *execp_workers = NULL;
+
 void execp_timer_callback(void *arg);
 char *execp_get_tooltip(void *obj);
 void execp_init_fonts();
 int execp_get_desired_size(void *obj);
 void execp_dump_geometry(void *obj, int indent);
 
+static gboolean execp_has_stdin(ExecpBackend *backend);
+static ExecpWorker *execp_worker_get(const char *name);
+static void execp_worker_stop(ExecpWorker *worker);
+static void execp_worker_free(void *data);
+static gboolean execp_worker_output_complete(ExecpWorker *worker, ExecpBackend *backend);
+static void execp_worker_command_finished(ExecpWorker *worker, gboolean worker_exited);
+
 void default_execp()
 {
 }
@@ -119,15 +162,28 @@ void destroy_execp(void *obj)
     if (backend->child_pipe_stdin >= 0)
         close(backend->child_pipe_stdin);
 
-    if (backend->child_pipe_stdout >= 0)
+    // The pipes of a worker shell are owned by the worker
+    gboolean worker_pipes = backend->worker && backend->worker->current == backend;
+    if (backend->worker) {
+        g_queue_remove(&backend->worker->queue, backend);
+        if (worker_pipes) {
+            // The shell is busy with our command
+            backend->worker->current = NULL;
+            execp_worker_stop(backend->worker);
+        }
+    }
+
+    if (backend->child_pipe_stdout >= 0 && !worker_pipes)
         close(backend->child_pipe_stdout);
 
-    if (backend->child_pipe_stderr >= 0)
+    if (backend->child_pipe_stderr >= 0 && !worker_pipes)
         close(backend->child_pipe_stderr);
 
     if (backend->cmd_pids)
         g_tree_destroy(backend->cmd_pids);
 
+    execp_builtin_free(backend->builtin);
+
     if (backend->icon) {
         imlib_context_set_image( backend->icon);
         imlib_free_image();
@@ -140,6 +196,7 @@ void destroy_execp(void *obj)
     free(backend->text);
     free(backend->icon_path);
     free(backend->command);
+    free(backend->worker_name);
     if (backend->tooltip < backend->buf_stderr ||
         backend->tooltip - backend->buf_stderr >= backend->buf_stdout_capacity)
     {
@@ -189,6 +246,18 @@ void init_execp()
         // Set missing config options
         if (!execp->backend->bg)
             execp->backend->bg = &g_array_index(backgrounds, Background, 0);
+
+        execp->backend->builtin = execp_builtin_new(execp->backend->command);
+        if (execp->backend->worker_name && !execp->backend->builtin) {
+            if (execp->backend->continuous)
+                fprintf(stderr, "tint2: execp_worker is ignored for continuous executors: %s\n",
+                        execp->backend->command);
+            else if (execp_has_stdin(execp->backend))
+                fprintf(stderr, "tint2: execp_worker is ignored for executors with a click command sink: %s\n",
+                        execp->backend->command);
+            else
+                execp->backend->worker = execp_worker_get(execp->backend->worker_name);
+        }
     }
 }
 
@@ -231,7 +300,7 @@ void init_execp_panel(void *p)
                                                  backend->rclick_command || backend->uwheel_command ||
                                                  backend->dwheel_command);
 
-        execp->area.resize_needed = TRUE;
+        schedule_resize(&execp->area);
         execp->area.on_screen = TRUE;
         area_gradients_create(&execp->area);
 
@@ -269,11 +338,11 @@ void execp_default_font_changed()
     execp_init_fonts();
     for (int i = 0; i < num_panels; i++)
     {
-        for (GList *l = panels[i].execp_list; l; l = l->next) {
+        for (GList *l = panels[i]->execp_list; l; l = l->next) {
             Execp *execp = l->data;
 
             if (!execp->backend->has_font) {
-                execp->area.resize_needed = TRUE;
+                schedule_resize(&execp->area);
                 schedule_redraw(&execp->area);
             }
         }
@@ -281,21 +350,25 @@ void execp_default_font_changed()
     schedule_panel_redraw();
 }
 
-void cleanup_execp()
+void cleanup_execp_panel(void *p)
 {
-    #define CLEANUP_PANEL_EXECP(p) do { \
-        g_list_free_full((p).execp_list, destroy_execp); \
-        (p).execp_list = NULL;                           \
-    } while(0)
+    Panel *panel = p;
+    g_list_free_full(panel->execp_list, destroy_execp);
+    panel->execp_list = NULL;
+}
 
+void cleanup_execp()
+{
     // Cleanup frontends
     for (int i = 0; i < num_panels; i++)
-        CLEANUP_PANEL_EXECP (panels[i]);
+        cleanup_execp_panel(panels[i]);
 
     // Cleanup backends
-    CLEANUP_PANEL_EXECP (panel_config);
+    cleanup_execp_panel(&panel_config);
 
-    #undef CLEANUP_PANEL_EXECP
+    // Stop the worker shells
+    g_list_free_full(execp_workers, execp_worker_free);
+    execp_workers = NULL;
 }
 
 // Called from backend functions.
@@ -722,6 +795,311 @@ void execp_cmd_completed(Execp *execp, pid_t pid)
     execp_force_update(execp);
 }
 
+static gboolean execp_has_stdin(ExecpBackend *backend)
+// Whether click commands are written to the input of the command, which workers cannot provide
+{
+    return  (backend->lclick_command_sink == 0) ||
+            (backend->mclick_command_sink == 0) ||
+            (backend->rclick_command_sink == 0) ||
+            (backend->uwheel_command_sink == 0) ||
+            (backend->dwheel_command_sink == 0);
+}
+
+static ExecpWorker *execp_worker_get(const char *name)
+{
+    for (GList *l = execp_workers; l; l = l->next) {
+        ExecpWorker *worker = l->data;
+        if (strcmp(worker->name, name) == 0)
+            return worker;
+    }
+    ExecpWorker *worker = calloc(1, sizeof(ExecpWorker));
+    worker->name = strdup(name);
+    worker->sock_stdin = worker->pipe_stdout = worker->pipe_stderr = -1;
+    g_queue_init(&worker->queue);
+    INIT_TIMER(worker->deadline_timer);
+    execp_workers = g_list_append(execp_workers, worker);
+    return worker;
+}
+
+static void execp_worker_stop(ExecpWorker *worker)
+{
+    stop_timer(&worker->deadline_timer);
+    if (worker->pid > 0) {
+        kill(-worker->pid, SIGTERM);
+        if (debug_executors)
+            fprintf(stderr, "tint2: Execp: stopped worker shell '%s', pid %d\n", worker->name, worker->pid);
+    }
+    worker->pid = 0;
+    if (worker->sock_stdin >= 0)
+        close(worker->sock_stdin);
+    if (worker->pipe_stdout >= 0)
+        close(worker->pipe_stdout);
+    if (worker->pipe_stderr >= 0)
+        close(worker->pipe_stderr);
+    worker->sock_stdin = worker->pipe_stdout = worker->pipe_stderr = -1;
+}
+
+static void execp_worker_free(void *data)
+{
+    ExecpWorker *worker = data;
+    execp_worker_stop(worker);
+    destroy_timer(&worker->deadline_timer);
+    g_queue_clear(&worker->queue);
+    free(worker->name);
+    free(worker);
+}
+
+static gboolean execp_worker_start(ExecpWorker *worker)
+{
+    int sock_stdin[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sock_stdin)) {
+        fprintf(stderr, "tint2: Execp: Creating worker input socket failed!\n");
+        return FALSE;
+    }
+
+    int pipe_fd_stdout[2];
+    if (pipe_cloexec(pipe_fd_stdout)) {
+        fprintf(stderr, "tint2: Execp: Creating output pipe failed!\n");
+        goto e0;
+    }
+    fcntl(pipe_fd_stdout[0], F_SETFL, O_NONBLOCK | fcntl(pipe_fd_stdout[0], F_GETFL));
+
+    int pipe_fd_stderr[2];
+    if (pipe_cloexec(pipe_fd_stderr)) {
+        fprintf(stderr, "tint2: Execp: Creating error pipe failed!\n");
+        goto e1;
+    }
+    fcntl(pipe_fd_stderr[0], F_SETFL, O_NONBLOCK | fcntl(pipe_fd_stderr[0], F_GETFL));
+
+    int child_fds[3] = { sock_stdin[1], pipe_fd_stdout[1], pipe_fd_stderr[1] };
+    char *argv[] = { "/bin/sh", NULL };
+    pid_t pid = spawn_process("/bin/sh", argv, NULL, child_fds, FALSE);
+    if (pid < 0) {
+        fprintf(stderr, "tint2: Execp: Spawning worker shell failed: %s\n", strerror(errno));
+        goto e2;
+    }
+    close(sock_stdin[1]);
+    close(pipe_fd_stdout[1]);
+    close(pipe_fd_stderr[1]);
+    worker->pid = pid;
+    worker->sock_stdin = sock_stdin[0];
+    worker->pipe_stdout = pipe_fd_stdout[0];
+    worker->pipe_stderr = pipe_fd_stderr[0];
+    if (debug_executors)
+        fprintf(stderr, "tint2: Execp: started worker shell '%s', pid %d\n", worker->name, pid);
+    return TRUE;
+
+e2: close( pipe_fd_stderr[1]);
+    close( pipe_fd_stderr[0]);
+e1: close( pipe_fd_stdout[1]);
+    close( pipe_fd_stdout[0]);
+e0: close( sock_stdin[1]);
+    close( sock_stdin[0]);
+    return FALSE;
+}
+
+static gboolean execp_worker_send(ExecpWorker *worker, const char *command)
+{
+    // The command is quoted for eval, so that it cannot swallow the end markers;
+    // 'command' keeps a syntax error from terminating the shell
+    GString *script = g_string_new(NULL);
+    g_string_append_printf(script,
+                           "printf '" EXECP_WORKER_START_MARK_FORMAT "'\n"
+                           "printf '" EXECP_WORKER_START_MARK_FORMAT "' >&2\n"
+                           "command eval '",
+                           worker->run,
+                           worker->run);
+    for (const char *c = command; *c; c++) {
+        if (*c == '\'')
+            g_string_append(script, "'\\''");
+        else
+            g_string_append_c(script, *c);
+    }
+    g_string_append_printf(script,
+                           "' </dev/null\n"
+                           "printf '\\n" EXECP_WORKER_END_MARK_FORMAT "'\n"
+                           "printf '" EXECP_WORKER_END_MARK_FORMAT "' >&2\n",
+                           worker->run,
+                           worker->run);
+
+    gboolean result = TRUE;
+    for (gsize sent = 0; sent < script->len; ) {
+        ssize_t count = send(worker->sock_stdin, script->str + sent, script->len - sent, MSG_NOSIGNAL);
+        if (count > 0)
+            sent += count;
+        else if (count < 0 && errno == EINTR)
+            continue;
+        else {
+            result = FALSE;
+            break;
+        }
+    }
+    g_string_free(script, TRUE);
+    return result;
+}
+
+static void execp_spawn_command(ExecpBackend *backend);
+static void execp_output_completed(ExecpBackend *backend);
+static void execp_worker_timeout(void *arg);
+
+static void execp_worker_dispatch(ExecpWorker *worker)
+{
+    while (!worker->current && !g_queue_is_empty(&worker->queue)) {
+        ExecpBackend *backend = g_queue_pop_head(&worker->queue);
+
+        if (worker->pid <= 0)
+            execp_worker_start(worker);
+        worker->run++;
+        if (worker->pid <= 0 || !execp_worker_send(worker, backend->command)) {
+            // Fall back to a new shell for this run, try again with the next command
+            execp_worker_stop(worker);
+            execp_spawn_command(backend);
+            continue;
+        }
+        if (debug_executors)
+            fprintf(stderr, "tint2: Executing in worker shell '%s': %s\n", worker->name, backend->command);
+
+        worker->current = backend;
+        worker->started_stdout = worker->started_stderr = FALSE;
+        backend->child_pipe_stdout = worker->pipe_stdout;
+        backend->child_pipe_stderr = worker->pipe_stderr;
+        backend->buf_stdout[backend->buf_stdout_length = 0] = '\0';
+        backend->buf_stderr[backend->buf_stderr_length = 0] = '\0';
+        backend->last_update_start_time = time(NULL);
+        change_timer(&worker->deadline_timer,
+                     true,
+                     MAX(backend->interval, EXECP_WORKER_MIN_DEADLINE) * 1000,
+                     0,
+                     execp_worker_timeout,
+                     worker);
+    }
+}
+
+static void execp_worker_timeout(void *arg)
+// The current command is still running after its deadline. It may block the worker forever,
+// e.g. waiting for input or because a background job keeps the output pipes open.
+{
+    ExecpWorker *worker = arg;
+    ExecpBackend *backend = worker->current;
+    if (!backend)
+        return;
+    fprintf(stderr,
+            "tint2: Execp: command still running after %d s in worker shell '%s', "
+            "restarting the worker and running the command in its own shell from now on: %s\n",
+            MAX(backend->interval, EXECP_WORKER_MIN_DEADLINE),
+            worker->name,
+            backend->command);
+    worker->current = NULL;
+    execp_worker_stop(worker);
+    backend->worker = NULL;
+    backend->child_pipe_stdout = -1;
+    backend->child_pipe_stderr = -1;
+    execp_spawn_command(backend);
+    execp_worker_dispatch(worker);
+}
+
+static char *execp_worker_find_mark(char *buffer, ssize_t length, const char *mark, ssize_t mark_length)
+{
+    for (char *p = buffer; (p = memchr(p, mark[0], buffer + length - p)); p++) {
+        if (buffer + length - p < mark_length)
+            break;
+        if (memcmp(p, mark, mark_length) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+static char *execp_worker_output_end(char *buffer,
+                                     ssize_t *length,
+                                     gboolean *started,
+                                     const char *start_mark,
+                                     const char *end_mark)
+// Drops the output preceding the start marker, and returns the position of the end marker if it has arrived.
+{
+    if (!*started) {
+        char *start = execp_worker_find_mark(buffer, *length, start_mark, strlen(start_mark));
+        if (!start)
+            return NULL;
+        start += strlen(start_mark);
+        *length -= start - buffer;
+        memmove(buffer, start, *length + 1);
+        *started = TRUE;
+    }
+    return execp_worker_find_mark(buffer, *length, end_mark, strlen(end_mark));
+}
+
+static gboolean execp_worker_output_complete(ExecpWorker *worker, ExecpBackend *backend)
+// Checks whether both end markers of the current run have been received, and strips the markers from the output.
+{
+    char start_mark[64], end_mark_stdout[64], end_mark_stderr[64];
+    snprintf(start_mark, sizeof(start_mark), EXECP_WORKER_START_MARK, worker->run);
+    snprintf(end_mark_stdout, sizeof(end_mark_stdout), "\n" EXECP_WORKER_END_MARK, worker->run);
+    snprintf(end_mark_stderr, sizeof(end_mark_stderr), EXECP_WORKER_END_MARK, worker->run);
+
+    char *end_stdout = execp_worker_output_end(backend->buf_stdout,
+                                               &backend->buf_stdout_length,
+                                               &worker->started_stdout,
+                                               start_mark,
+                                               end_mark_stdout);
+    char *end_stderr = execp_worker_output_end(backend->buf_stderr,
+                                               &backend->buf_stderr_length,
+                                               &worker->started_stderr,
+                                               start_mark,
+                                               end_mark_stderr);
+    if (!end_stdout || !end_stderr)
+        return FALSE;
+    // Anything after the markers was written by a background job, which is not waited for
+    *end_stdout = '\0';
+    backend->buf_stdout_length = end_stdout - backend->buf_stdout;
+    *end_stderr = '\0';
+    backend->buf_stderr_length = end_stderr - backend->buf_stderr;
+    return TRUE;
+}
+
+static void execp_worker_command_finished(ExecpWorker *worker, gboolean worker_exited)
+// Called after the output of the current command has been read completely.
+{
+    stop_timer(&worker->deadline_timer);
+    worker->current = NULL;
+    if (worker_exited) {
+        // The command probably called exit; a new shell is started on the next run
+        fprintf(stderr, "tint2: Execp: worker shell '%s' exited unexpectedly\n", worker->name);
+        execp_worker_stop(worker);
+    }
+    execp_worker_dispatch(worker);
+}
+
+static void execp_builtin_run(Execp *execp)
+// Samples a built-in source, which takes microseconds, so it is done synchronously.
+{
+    ExecpBackend *backend = execp->backend;
+    char text[512];
+
+    backend->last_update_start_time = time(NULL);
+    execp_builtin_sample(backend->builtin, text, sizeof(text));
+
+    if (strcmp(text, backend->text) != 0) {
+        ssize_t len = strlen(text);
+        if (backend->buf_stdout_capacity < len + 1) {
+            backend->buf_stdout_capacity = len + 1;
+            backend->buf_stdout = realloc(backend->buf_stdout, backend->buf_stdout_capacity);
+        }
+        memcpy(backend->buf_stdout, text, len + 1);
+        backend->buf_stdout_length = len;
+        backend->buf_stderr[backend->buf_stderr_length = 0] = '\0';
+        execp_output_completed(backend);
+
+        for (GList *l = backend->instances; l; l = l->next)
+            execp_update_post_read(l->data);
+    } else {
+        backend->last_update_finish_time = time(NULL);
+        backend->last_update_duration = 0;
+    }
+
+    if (backend->interval)
+        change_timer(&backend->timer, true, backend->interval * 1000, 0, execp_timer_callback, execp);
+}
+
 void execp_timer_callback(void *arg)
 {
     Execp *execp = arg;
@@ -734,15 +1112,27 @@ void execp_timer_callback(void *arg)
     if (backend->child_pipe_stdout > 0)
         return;
 
-    int have_stdin =    (backend->lclick_command_sink == 0) ||
-                        (backend->mclick_command_sink == 0) ||
-                        (backend->rclick_command_sink == 0) ||
-                        (backend->uwheel_command_sink == 0) ||
-                        (backend->dwheel_command_sink == 0);
+    if (backend->builtin) {
+        execp_builtin_run(execp);
+        return;
+    }
+
+    if (backend->worker) {
+        if (!g_queue_find(&backend->worker->queue, backend))
+            g_queue_push_tail(&backend->worker->queue, backend);
+        execp_worker_dispatch(backend->worker);
+        return;
+    }
+    execp_spawn_command(backend);
+}
+
+static void execp_spawn_command(ExecpBackend *backend)
+{
+    int have_stdin = execp_has_stdin(backend);
 
     int pipe_fd_stdin[2];
     if (have_stdin) {
-        if (pipe(pipe_fd_stdin)) {
+        if (pipe_cloexec(pipe_fd_stdin)) {
             // TODO maybe write this in tooltip, but if this happens we're screwed anyways
             fprintf(stderr, "tint2: Execp: Creating input pipe failed!\n");
             return;
@@ -751,7 +1141,7 @@ void execp_timer_callback(void *arg)
     }
 
     int pipe_fd_stdout[2];
-    if (pipe(pipe_fd_stdout)) {
+    if (pipe_cloexec(pipe_fd_stdout)) {
         // TODO maybe write this in tooltip, but if this happens we're screwed anyways
         fprintf(stderr, "tint2: Execp: Creating output pipe failed!\n");
         goto e0;
@@ -759,46 +1149,24 @@ void execp_timer_callback(void *arg)
     fcntl(pipe_fd_stdout[0], F_SETFL, O_NONBLOCK | fcntl(pipe_fd_stdout[0], F_GETFL));
 
     int pipe_fd_stderr[2];
-    if (pipe(pipe_fd_stderr)) {
+    if (pipe_cloexec(pipe_fd_stderr)) {
         // TODO maybe write this in tooltip, but if this happens we're screwed anyways
         fprintf(stderr, "tint2: Execp: Creating error pipe failed!\n");
         goto e1;
     }
     fcntl(pipe_fd_stderr[0], F_SETFL, O_NONBLOCK | fcntl(pipe_fd_stderr[0], F_GETFL));
 
-    // Fork and run command, capturing stdout in pipe
-
-    pid_t child = fork();
-    switch (child) {
-        case -1:// TODO maybe write this in tooltip, but if this happens we're screwed anyways
-                fprintf (stderr, "tint2: Fork failed.\n");
-                goto e2;
-        case  0:// We are in the child
-                if (debug_executors)
-                    fprintf(stderr, "tint2: Executing: %s\n", backend->command);
-
-                if (have_stdin) {
-                    close (pipe_fd_stdin[1]);
-                    dup2  (pipe_fd_stdin[0], 0); // 0 is stdin
-                    close (pipe_fd_stdin[0]);
-                }
-
-                close (pipe_fd_stdout[0]);
-                dup2  (pipe_fd_stdout[1], 1); // 1 is stdout
-                close (pipe_fd_stdout[1]);
-
-                close (pipe_fd_stderr[0]);
-                dup2  (pipe_fd_stderr[1], 2); // 2 is stderr
-                close (pipe_fd_stderr[1]);
+    // Run command in its own process group, capturing stdout and stderr in pipes
+    if (debug_executors)
+        fprintf(stderr, "tint2: Executing: %s\n", backend->command);
 
-                close_all_fds ();
-
-                setpgid (0, 0);
-                execl ("/bin/sh", "/bin/sh", "-c", backend->command, NULL);
-                // This should never happen!
-                fprintf (stderr, "execl() failed\nexecl() failed\n");
-                exit (0);
-    };
+    int child_fds[3] = { have_stdin ? pipe_fd_stdin[0] : -1, pipe_fd_stdout[1], pipe_fd_stderr[1] };
+    pid_t child = spawn_shell_command(backend->command, NULL, child_fds, FALSE);
+    if (child < 0) {
+        // TODO maybe write this in tooltip, but if this happens we're screwed anyways
+        fprintf(stderr, "tint2: Execp: Spawning command failed: %s\n", strerror(errno));
+        goto e2;
+    }
     if (have_stdin)
         close(pipe_fd_stdin[0]);
     close(pipe_fd_stdout[1]);
@@ -810,6 +1178,7 @@ void execp_timer_callback(void *arg)
     backend->child_pipe_stderr = pipe_fd_stderr[0];
     backend->buf_stdout[backend->buf_stdout_length = 0] = '\0';
     backend->buf_stderr[backend->buf_stderr_length = 0] = '\0';
+    backend->buf_stdout_scanned = backend->frame_start = backend->frame_lines = 0;
     backend->last_update_start_time = time(NULL);
     return;
 
@@ -936,6 +1305,88 @@ char *strrstr(char *s, char *sub)
 }
 #endif
 
+static void execp_drop_stdout(ExecpBackend *backend, ssize_t count)
+// Removes the first count bytes of the stdout buffer.
+{
+    backend->buf_stdout_length -= count;
+    memmove(backend->buf_stdout, backend->buf_stdout + count, backend->buf_stdout_length + 1);
+    backend->buf_stdout_scanned -= count;
+    backend->frame_start -= count;
+}
+
+static ssize_t read_frames_from_pipe(ExecpBackend *backend, ssize_t *frame_end, gboolean *eof)
+// Reads the available output of a continuous executor, where a frame is `continuous` lines.
+// Each byte is scanned for newlines once, as it arrives. Only the newest complete frame is kept:
+// when the buffer fills up, the frames superseded by it are dropped instead of growing the buffer,
+// so a chatty executor never builds up a backlog.
+// Returns the offset of the newest complete frame and sets frame_end past its last newline,
+// or returns -1 if no frame was completed.
+{
+    ssize_t frame = -1;
+    *eof = FALSE;
+    while (1) {
+        if (backend->buf_stdout_capacity - backend->buf_stdout_length - 1 < 1024) {
+            ssize_t drop = frame >= 0 ? frame : backend->frame_start;
+            if (drop > 0) {
+                execp_drop_stdout(backend, drop);
+                if (frame >= 0) {
+                    frame -= drop;
+                    *frame_end -= drop;
+                }
+            }
+            // Keep at least half of the buffer free, so that the moves above cost O(1) per byte read
+            ssize_t req_cap = 2 * (backend->buf_stdout_length + 1024);
+            if (backend->buf_stdout_capacity < req_cap) {
+                do    backend->buf_stdout_capacity *= 2;
+                while (backend->buf_stdout_capacity < req_cap);
+                backend->buf_stdout = realloc(backend->buf_stdout, backend->buf_stdout_capacity);
+            }
+        }
+        char *buf = backend->buf_stdout;
+        ssize_t count = read(backend->child_pipe_stdout,
+                             buf + backend->buf_stdout_length,
+                             backend->buf_stdout_capacity - backend->buf_stdout_length - 1);
+        if (count > 0) {
+            backend->buf_stdout_length += count;
+            buf[backend->buf_stdout_length] = '\0';
+            char *end = buf + backend->buf_stdout_length;
+            for (char *c = buf + backend->buf_stdout_scanned; (c = memchr(c, '\n', end - c)); ) {
+                c++;
+                if (++backend->frame_lines == backend->continuous) {
+                    frame = backend->frame_start;
+                    *frame_end = backend->frame_start = c - buf;
+                    backend->frame_lines = 0;
+                }
+            }
+            backend->buf_stdout_scanned = backend->buf_stdout_length;
+            continue;
+        }
+        else if (count == 0)
+            *eof = TRUE;            // End of file
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;                  // No more data available at the moment
+        else if (errno == EINTR)
+            continue;               // Harmless interruption by signal
+        else
+            *eof = TRUE;            // Error
+        break;
+    }
+    return frame;
+}
+
+static char *after_last_clear_screen(char *begin, char *end)
+// Returns the position following the last ANSI clear screen sequence in [begin, end), or NULL.
+{
+    static const char ansi_clear_screen[] = "\x1b[2J";
+    char *result = NULL;
+    for (char *p = begin; (p = memchr(p, ansi_clear_screen[0], end - p)); p++) {
+        if (end - p >= (ssize_t)strlen_const(ansi_clear_screen) &&
+            memcmp(p, ansi_clear_screen, strlen_const(ansi_clear_screen)) == 0)
+            result = p + strlen_const(ansi_clear_screen);
+    }
+    return result;
+}
+
 char * printed_end(char *s)
 {
     char *p = strchr(s, '\0') - 1;
@@ -955,11 +1406,16 @@ gboolean read_execp(void *obj)
         return FALSE;
 
     gboolean stdout_eof, stderr_eof;
-    read_from_pipe(backend->child_pipe_stdout,
-                   &backend->buf_stdout,
-                   &backend->buf_stdout_length,
-                   &backend->buf_stdout_capacity,
-                   &stdout_eof);
+    ssize_t frame = -1, frame_end = 0;
+    if (backend->continuous)
+        frame = read_frames_from_pipe(backend, &frame_end, &stdout_eof);
+    else
+        read_from_pipe(backend->child_pipe_stdout,
+                       &backend->buf_stdout,
+                       &backend->buf_stdout_length,
+                       &backend->buf_stdout_capacity,
+                       &stdout_eof);
+    ssize_t stderr_scanned = backend->buf_stderr_length;
     int count =
     read_from_pipe(backend->child_pipe_stderr,
                    &backend->buf_stderr,
@@ -970,30 +1426,43 @@ gboolean read_execp(void *obj)
     gboolean command_finished = stdout_eof && stderr_eof;
     gboolean result = FALSE;
 
+    ExecpWorker *worker = backend->worker && backend->worker->current == backend ? backend->worker : NULL;
+    gboolean worker_exited = FALSE;
+    if (worker) {
+        worker_exited = stdout_eof || stderr_eof;
+        command_finished = execp_worker_output_complete(worker, backend) || worker_exited;
+    }
+
     if (command_finished) {
-        close(backend->child_pipe_stdout);
-        close(backend->child_pipe_stderr);
+        if (!worker) {
+            close(backend->child_pipe_stdout);
+            close(backend->child_pipe_stderr);
+        }
         backend->child = 0;
         backend->child_pipe_stdout = -1;
         backend->child_pipe_stderr = -1;
+        if (worker)
+            execp_worker_command_finished(worker, worker_exited);
         if (backend->interval)
             change_timer(&backend->timer, true, backend->interval * 1000, 0, execp_timer_callback, execp);
     }
 
-    char ansi_clear_screen[] = "\x1b[2J";
     if (backend->continuous)
     {
         // Handle stderr
         if (!backend->has_user_tooltip) {
             if (count > 0)
             {
-                char *start = strrstr( backend->buf_stderr, ansi_clear_screen);
+                // Only the new bytes can contain a clear screen sequence, besides one split across reads
+                char *end = backend->buf_stderr + backend->buf_stderr_length;
+                char *start = after_last_clear_screen(backend->buf_stderr + MAX(0, stderr_scanned - 3), end);
                 if (start) {
-                    start += strlen_const( ansi_clear_screen);
-                    backend->buf_stderr_length -= start - backend->buf_stderr;
+                    backend->buf_stderr_length = end - start;
                     memmove( backend->buf_stderr, start, backend->buf_stderr_length + 1);
                 }
-                int tooltip_len = printed_end( backend->buf_stderr) - backend->buf_stderr;
+                int tooltip_len = backend->buf_stderr_length;
+                while (tooltip_len > 0 && strchr(" \t\n", backend->buf_stderr[tooltip_len - 1]))
+                    tooltip_len--;
                 if (backend->tooltip_len < tooltip_len) {
                     backend->tooltip_len = tooltip_len;
                     free( backend->tooltip);
@@ -1008,50 +1477,25 @@ gboolean read_execp(void *obj)
             backend->buf_stderr[backend->buf_stderr_length] = '\0';
         }
         // Handle stdout
-        // Count lines in buffer
-        int num_lines = 0;
-        char *end = NULL;
-        for (char *c = backend->buf_stdout; (c = strchr(c, '\n')); )
-        {
-            num_lines++;
-            if (num_lines == backend->continuous)
-                end = c;
-            c++;
-        }
-        if (num_lines >= backend->continuous)
+        if (frame >= 0)
         {
-            if (end)
-                *end = '\0';
+            char *start = backend->buf_stdout + frame;
+            backend->buf_stdout[frame_end - 1] = '\0';
             free_and_null(backend->text);
             free_and_null(backend->icon_path);
             if (!backend->has_icon)
-                backend->text = strdup(backend->buf_stdout);
+                backend->text = strdup(start);
             else {
-                char *text = strchr(backend->buf_stdout, '\n');
+                char *text = strchr(start, '\n');
                 if (text) {
                     *text++ = '\0';
                     backend->text = strdup(text);
                 } else
                     strdup_static(backend->text, "");
-                backend->icon_path = expand_tilde(backend->buf_stdout);
-            }
-            size_t len = strlen(backend->text);
-            if (len > 0 && backend->text[len - 1] == '\n')
-                backend->text[len - 1] = '\0';
-
-            if (end) {
-                char *next = end + 1;
-                ssize_t copied = next - backend->buf_stdout;
-                ssize_t remaining = backend->buf_stdout_length - copied;
-                if (remaining > 0) {
-                    memmove(backend->buf_stdout, next, (size_t)remaining);
-                    backend->buf_stdout_length = remaining;
-                    backend->buf_stdout[backend->buf_stdout_length] = '\0';
-                } else {
-                    backend->buf_stdout_length = 0;
-                    backend->buf_stdout[backend->buf_stdout_length] = '\0';
-                }
+                backend->icon_path = expand_tilde(start);
             }
+            // Keep only the partial frame that follows
+            execp_drop_stdout(backend, frame_end);
 
             backend->last_update_finish_time = time(NULL);
             backend->last_update_duration =
@@ -1061,47 +1505,55 @@ gboolean read_execp(void *obj)
     }
     else if (command_finished)
     {
-        // Handle stdout
-        free_and_null(backend->text);
-        free_and_null(backend->icon_path);
-        if (!backend->has_icon)
-            backend->text = strdup(backend->buf_stdout);
-        else {
-            char *text = strchr(backend->buf_stdout, '\n');
-            if (text) {
-                *text++ = '\0';
-                backend->text = strdup(text);
-            } else
-                strdup_static(backend->text, "");
-            backend->icon_path = strdup(backend->buf_stdout);
-        }
-        int len = strlen(backend->text);
-        if (len > 0 && backend->text[len - 1] == '\n')
-            backend->text[len - 1] = '\0';
-        backend->buf_stdout_length = 0;
-        backend->buf_stdout[backend->buf_stdout_length] = '\0';
-        // Handle stderr
-        if (!backend->has_user_tooltip) {
-            char *start = strrstr(backend->buf_stderr, ansi_clear_screen);
-            start = start   ? start + strlen_const( ansi_clear_screen)
-                            : backend->buf_stderr;
-            if (*start) {
-                backend->tooltip = start;
-                printed_end( backend->tooltip )[0] = '\0';
-            } else
-                backend->tooltip = NULL;
-        }
-        backend->buf_stderr_length = 0;
-        backend->buf_stderr[backend->buf_stderr_length] = '\0';
-        //
-        backend->last_update_finish_time = time(NULL);
-        backend->last_update_duration =
-            backend->last_update_finish_time - backend->last_update_start_time;
+        execp_output_completed(backend);
         result = TRUE;
     }
     return result;
 }
 
+static void execp_output_completed(ExecpBackend *backend)
+// Extracts the text, icon and tooltip from the complete output of a command.
+{
+    char ansi_clear_screen[] = "\x1b[2J";
+
+    // Handle stdout
+    free_and_null(backend->text);
+    free_and_null(backend->icon_path);
+    if (!backend->has_icon)
+        backend->text = strdup(backend->buf_stdout);
+    else {
+        char *text = strchr(backend->buf_stdout, '\n');
+        if (text) {
+            *text++ = '\0';
+            backend->text = strdup(text);
+        } else
+            strdup_static(backend->text, "");
+        backend->icon_path = strdup(backend->buf_stdout);
+    }
+    int len = strlen(backend->text);
+    if (len > 0 && backend->text[len - 1] == '\n')
+        backend->text[len - 1] = '\0';
+    backend->buf_stdout_length = 0;
+    backend->buf_stdout[backend->buf_stdout_length] = '\0';
+    // Handle stderr
+    if (!backend->has_user_tooltip) {
+        char *start = strrstr(backend->buf_stderr, ansi_clear_screen);
+        start = start   ? start + strlen_const( ansi_clear_screen)
+                        : backend->buf_stderr;
+        if (*start) {
+            backend->tooltip = start;
+            printed_end( backend->tooltip )[0] = '\0';
+        } else
+            backend->tooltip = NULL;
+    }
+    backend->buf_stderr_length = 0;
+    backend->buf_stderr[backend->buf_stderr_length] = '\0';
+    //
+    backend->last_update_finish_time = time(NULL);
+    backend->last_update_duration =
+        backend->last_update_finish_time - backend->last_update_start_time;
+}
+
 const char *time_to_string(int s, char *buffer, size_t buffer_size)
 // WARNING: buffer size is used completely,
 // it's programmer responsibility to reserve place for terminating null
@@ -1195,7 +1647,7 @@ void execp_update_post_read(Execp *execp)
         hide(&execp->area);
     else {
         show(&execp->area);
-        execp->area.resize_needed = TRUE;
+        schedule_resize(&execp->area);
         schedule_panel_redraw();
     }
 
@@ -1220,3 +1672,83 @@ void handle_execp_events( fd_set *fds, int *fdn)
             }
     }
 }
+
+TEST(read_frames_from_pipe)
+{
+    int fds[2];
+    ASSERT_EQUAL(pipe(fds), 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    ExecpBackend backend;
+    memset(&backend, 0, sizeof(backend));
+    backend.continuous = 2;
+    backend.child_pipe_stdout = fds[0];
+    backend.buf_stdout_capacity = 1024;
+    backend.buf_stdout = calloc(backend.buf_stdout_capacity, 1);
+
+    // A backlog of frames and a partial one: only the newest complete frame is returned
+    char line[32];
+    for (int i = 0; i < 3000; i++) {
+        snprintf(line, sizeof(line), "a%d\nb%d\n", i, i);
+        ASSERT_EQUAL(write(fds[1], line, strlen(line)), (ssize_t)strlen(line));
+    }
+    ASSERT_EQUAL(write(fds[1], "a3000\n", 6), 6);
+
+    gboolean eof;
+    ssize_t frame_end;
+    ssize_t frame = read_frames_from_pipe(&backend, &frame_end, &eof);
+    ASSERT_FALSE(eof);
+    ASSERT(frame >= 0);
+    ASSERT_EQUAL(frame_end - frame, (ssize_t)strlen("a2999\nb2999\n"));
+    ASSERT_EQUAL(memcmp(backend.buf_stdout + frame, "a2999\nb2999\n", frame_end - frame), 0);
+    // Superseded frames were dropped instead of growing the buffer
+    ASSERT(backend.buf_stdout_capacity <= 4096);
+
+    execp_drop_stdout(&backend, frame_end);
+    ASSERT_STR_EQUAL(backend.buf_stdout, "a3000\n");
+    ASSERT_EQUAL(read_frames_from_pipe(&backend, &frame_end, &eof), (ssize_t)-1);
+
+    // The partial frame is completed by the next read
+    ASSERT_EQUAL(write(fds[1], "b3000\n", 6), 6);
+    close(fds[1]);
+    frame = read_frames_from_pipe(&backend, &frame_end, &eof);
+    ASSERT_TRUE(eof);
+    ASSERT_EQUAL(frame, (ssize_t)0);
+    ASSERT_STR_EQUAL(backend.buf_stdout, "a3000\nb3000\n");
+
+    close(fds[0]);
+    free(backend.buf_stdout);
+}
+
+TEST(execp_worker_output_complete)
+{
+    ExecpWorker worker;
+    memset(&worker, 0, sizeof(worker));
+    worker.run = 7;
+
+    ExecpBackend backend;
+    memset(&backend, 0, sizeof(backend));
+    backend.buf_stdout_capacity = backend.buf_stderr_capacity = 1024;
+    backend.buf_stdout = calloc(backend.buf_stdout_capacity, 1);
+    backend.buf_stderr = calloc(backend.buf_stderr_capacity, 1);
+
+    // A background job of run 6 wrote around the markers of run 7
+    strcpy(backend.buf_stdout,
+           "late\n" "\036tint2-execp-done-6\036\n" "\036tint2-execp-start-7\036\n" "text\n"
+           "\n\036tint2-execp-done-7\036\n" "later\n");
+    backend.buf_stdout_length = strlen(backend.buf_stdout);
+    strcpy(backend.buf_stderr, "\036tint2-execp-start-7\036\n" "tooltip");
+    backend.buf_stderr_length = strlen(backend.buf_stderr);
+    ASSERT_FALSE(execp_worker_output_complete(&worker, &backend));
+    ASSERT_STR_EQUAL(backend.buf_stderr, "tooltip");
+
+    // The end marker of stderr arrives with the next read
+    strcat(backend.buf_stderr, "\036tint2-execp-done-7\036\n");
+    backend.buf_stderr_length = strlen(backend.buf_stderr);
+    ASSERT_TRUE(execp_worker_output_complete(&worker, &backend));
+    ASSERT_STR_EQUAL(backend.buf_stdout, "text\n");
+    ASSERT_STR_EQUAL(backend.buf_stderr, "tooltip");
+
+    free(backend.buf_stdout);
+    free(backend.buf_stderr);
+}
@@ -23,6 +23,7 @@ typedef struct ExecpBackend {
     char name[21];
     char *command;  // Command to execute at a specified interval
     int interval;   // Interval in seconds
+    char *worker_name;  // Name of the persistent shell that runs the command, NULL to start a new shell each time
     int monitor;
     gboolean has_icon;  // 1 if first line of output is an icon path
     gboolean cache_icon;
@@ -58,6 +59,8 @@ typedef struct ExecpBackend {
     int child_pipe_stdout;
     int child_pipe_stderr;
     pid_t child;
+    struct ExecpWorker *worker; // Persistent shell running the command, if worker_name is set
+    struct ExecpBuiltin *builtin;   // Built-in metric source sampled instead of running the command
 
     // Command output buffer
     char *buf_stdout;
@@ -66,6 +69,10 @@ typedef struct ExecpBackend {
     char *buf_stderr;
     ssize_t buf_stderr_length;
     ssize_t buf_stderr_capacity;
+    // Continuous mode framing of buf_stdout
+    ssize_t buf_stdout_scanned; // Bytes already scanned for newlines
+    ssize_t frame_start;        // Offset of the frame being received
+    int frame_lines;            // Newlines received in that frame
 
     char *text;         // Text extracted from the output buffer
     char *icon_path;    // Icon path extracted from the output buffer
@@ -126,6 +133,10 @@ void init_execp_panel(void *panel);
 // Initializes the state of the frontend items. Also adds a pointer to it in backend->instances.
 // At this point the Area has not been added yet to the GUI tree, but it will be added right away.
 
+void cleanup_execp_panel(void *panel);
+// Called before a panel is destroyed while tint2 keeps running, e.g. when a monitor is unplugged.
+// Releases the frontend items of the panel and removes them from backend->instances.
+
 void cleanup_execp();
 // Called just before the panels are destroyed. Afterwards, tint2 exits or restarts and reads the config again.
 // Releases all frontends and then all the backends.
@@ -52,7 +52,7 @@ void init_freespace_panel(void *p)
             freespace->area.panel = p;
             snprintf(freespace->area.name, strlen_const(freespace->area.name), "Freespace");
             freespace->area.size_mode = LAYOUT_FIXED;
-            freespace->area.resize_needed = TRUE;
+            schedule_resize(&freespace->area);
             freespace->area.on_screen = TRUE;
             freespace->area._resize = resize_freespace;
             freespace->area._get_desired_size = freespace_get_desired_size;
@@ -76,8 +76,7 @@ int freespace_get_max_size(Panel *panel)
     int size = 0;
     int spacers = 0;
     int others = 0;
-    for (GList *walk = panel->area.children; walk; walk = walk->next) {
-        Area *a = walk->data;
+    for_children(&panel->area, a) {
         if (a->on_screen)
         {
             if (a->_resize == resize_freespace)
@@ -1,5 +1,6 @@
 #include "init.h"
 
+#include <fcntl.h>
 #include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +12,7 @@
 #include <X11/Xatom.h>
 #include <X11/extensions/XShm.h>
 
+#include "arena.h"
 #include "config.h"
 #include "default_icon.h"
 #include "drag_and_drop.h"
@@ -18,7 +20,9 @@
 #include "panel.h"
 #include "server.h"
 #include "signals.h"
+#include "launch.h"
 #include "test.h"
+#include "text-shadow.h"
 #include "tooltip.h"
 #include "tracing.h"
 #include "uevent.h"
@@ -39,7 +43,10 @@ void print_usage()
             "  -h, --help                        Display this help and exits.\n"
             "\n"
             "Developer options:\n"
-            "      --test                                 Run built-in self-tests.\n"
+            "      --bench [filter]                       Run the built-in benchmarks whose name contains filter.\n"
+            "      --bench-battery                        Measure the sysfs reads of a battery update (Linux).\n"
+            "      --bench-spawn                          Measure command launch latency against memory usage.\n"
+            "      --test                                 Run built-in self-tests in parallel (TEST_JOBS, TEST_TIMEOUT).\n"
             "      --test-verbose                         Same as --tests, but with verbose errors report.\n"
             "      --dump-image-data image output_prefix  Wraps image file into resource in the simplest possible form.\n"
             "\n"
@@ -51,6 +58,9 @@ void print_usage()
 // Must be sorted with "LANG=C sort" command.
 
 enum {  help_key_battery_sys_prefix,
+        help_key_bench,
+        help_key_bench_battery,
+        help_key_bench_spawn,
         help_key_config,
         help_key_dump_image_data,
         help_key_help,
@@ -65,6 +75,9 @@ enum {  help_key_battery_sys_prefix,
         HELP_KEYS
 };
 static char *help_opt_sv[] = {  "--battery-sys-prefix",
+                                "--bench",
+                                "--bench-battery",
+                                "--bench-spawn",
                                 "--config",
                                 "--dump-image-data",
                                 "--help",
@@ -93,6 +106,20 @@ void handle_cli_arguments(int argc, char **argv)
                 fprintf(stdout, "tint2 version %s\n", VERSION_STRING);
                 exit(0);
                 break;
+        #if defined(ENABLE_BATTERY) && defined(__linux__)
+            case help_key_bench_battery:
+                bench_battery();
+                exit(0);
+                break;
+        #endif
+            case help_key_bench:
+                run_all_benchmarks(i + 1 < argc ? argv[i + 1] : NULL);
+                exit(0);
+                break;
+            case help_key_bench_spawn:
+                bench_spawn();
+                exit(0);
+                break;
             case help_key_test:
                 run_all_tests(false);
                 exit(0);
@@ -170,6 +197,9 @@ void handle_env_vars()
             tracing_fps_threshold = 60;
         }
     }
+#ifdef HAVE_TRACING
+    tracing_json_path = getenv("TRACING_JSON");
+#endif
     #undef _load_env_flag
 }
 
@@ -268,6 +298,8 @@ void init_X11_pre_config()
         exit(EXIT_FAILURE);
     }
     server.x11_fd = ConnectionNumber(server.display);
+    // Commands are spawned without closing descriptors in the child
+    fcntl(server.x11_fd, F_SETFD, FD_CLOEXEC);
     server.errors = g_queue_new ();
     XSetErrorHandler(server_catch_error);
     XSetIOErrorHandler(x11_io_error);
@@ -357,6 +389,7 @@ void cleanup()
 
     cleanup_server();
     cleanup_timers();
+    cleanup_text_shadows();
     icon_theme_common_cleanup ();
 
     if (server.display)
@@ -374,6 +407,7 @@ void cleanup()
 
     uevent_cleanup();
     cleanup_fps_distribution();
+    arena_free(&frame_arena);
 
 #ifdef HAVE_TRACING
     cleanup_tracing();
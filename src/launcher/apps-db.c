@@ -0,0 +1,368 @@
+/**************************************************************************
+* Tint2 : .desktop file database
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+#include "apps-db.h"
+#include "common.h"
+#include "launcher.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+typedef struct AppsDbEntry {
+    DesktopEntry entry;
+    gboolean valid;     // Parsed successfully and has an Exec key
+    gboolean watched;   // The directory of the file is watched, no need to check mtime
+    time_t mtime;
+    off_t size;
+} AppsDbEntry;
+
+int apps_db_fd = -1;
+
+static GHashTable *entries = NULL;  // full path -> AppsDbEntry*
+static GHashTable *ids = NULL;      // desktop file ID -> full path
+static gboolean index_dirty = FALSE;
+
+#ifdef HAVE_INOTIFY
+static GHashTable *watches = NULL;      // watch descriptor -> directory path
+static GHashTable *watched_dirs = NULL; // directory path -> watch descriptor (keys are owned by watches)
+static GHashTable *parent_watches = NULL; // watch descriptors of the nearest existing parents of missing locations
+
+#define APPS_DB_WATCH_MASK  (IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO \
+                            | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+static void apps_db_entry_free(void *data)
+{
+    AppsDbEntry *e = data;
+    free_desktop_entry(&e->entry);
+    free(e);
+}
+
+static int apps_db_watch_dir(const char *dir)
+// Returns the new watch descriptor, or -1 if the directory was already watched or cannot be watched.
+{
+#ifdef HAVE_INOTIFY
+    if (apps_db_fd < 0 || g_hash_table_contains(watched_dirs, dir))
+        return -1;
+    int wd = inotify_add_watch(apps_db_fd, dir, APPS_DB_WATCH_MASK);
+    if (wd < 0)
+        return -1;
+    char *path = strdup(dir);
+    g_hash_table_replace(watches, GINT_TO_POINTER(wd), path);
+    g_hash_table_replace(watched_dirs, path, GINT_TO_POINTER(wd));
+    return wd;
+#else
+    return -1;
+#endif
+}
+
+static void apps_db_watch_missing_location(const char *location)
+// Watches the nearest existing parent of a location that does not exist (e.g. a deleted ~/.local/share/applications),
+// so that the location is indexed and watched again when it is created.
+{
+#ifdef HAVE_INOTIFY
+    gchar *dir = g_path_get_dirname(location);
+    while (!g_file_test(dir, G_FILE_TEST_IS_DIR) && strcmp(dir, "/") != 0 && strcmp(dir, ".") != 0) {
+        gchar *parent = g_path_get_dirname(dir);
+        g_free(dir);
+        dir = parent;
+    }
+    int wd = apps_db_watch_dir(dir);
+    if (wd >= 0)
+        g_hash_table_add(parent_watches, GINT_TO_POINTER(wd));
+    g_free(dir);
+#endif
+}
+
+#ifdef HAVE_INOTIFY
+static gboolean apps_db_leads_to_location(const char *path)
+// Returns TRUE if path is a location or one of its parents.
+{
+    size_t len = strlen(path);
+    for (const GSList *l = get_apps_locations(); l; l = l->next) {
+        const char *location = l->data;
+        if (strncmp(location, path, len) == 0 && (location[len] == '\0' || location[len] == '/'))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean apps_db_entry_in_dir(gpointer key, gpointer value, gpointer dir)
+{
+    gchar *entry_dir = g_path_get_dirname(key);
+    gboolean result = strcmp(entry_dir, dir) == 0;
+    g_free(entry_dir);
+    return result;
+}
+#endif
+
+static void apps_db_unwatch(int wd)
+{
+#ifdef HAVE_INOTIFY
+    const char *dir = g_hash_table_lookup(watches, GINT_TO_POINTER(wd));
+    if (!dir)
+        return;
+    g_hash_table_remove(watched_dirs, dir);
+    g_hash_table_remove(watches, GINT_TO_POINTER(wd));
+#endif
+}
+
+static gboolean apps_db_dir_is_watched(const char *path)
+{
+#ifdef HAVE_INOTIFY
+    if (apps_db_fd < 0)
+        return FALSE;
+    gchar *dir = g_path_get_dirname(path);
+    gboolean result = g_hash_table_contains(watched_dirs, dir);
+    g_free(dir);
+    return result;
+#else
+    return FALSE;
+#endif
+}
+
+static void apps_db_index_dir(const char *dir, const char *id_prefix)
+// Desktop file IDs are the paths relative to the location, with '/' replaced by '-'.
+// Locations are indexed in order of precedence, so the first file found for an ID wins.
+{
+    apps_db_watch_dir(dir);
+
+    GDir *d = g_dir_open(dir, 0, NULL);
+    if (!d)
+        return;
+    const gchar *name;
+    while ((name = g_dir_read_name(d)))
+    {
+        int tmpval;
+        char *path = strdup_printf( NULL, "%s/%s", dir, name);
+        if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+            char *prefix = strdup_printf( NULL, "%s%s-", id_prefix, name);
+            apps_db_index_dir(path, prefix);
+            free(prefix);
+        } else if (str_has_const_suffix(name, ".desktop", tmpval)) {
+            char *id = strdup_printf( NULL, "%s%s", id_prefix, name);
+            if (!g_hash_table_contains(ids, id)) {
+                g_hash_table_insert(ids, id, path);
+                path = NULL;
+            } else
+                free(id);
+        }
+        free(path);
+    }
+    g_dir_close(d);
+}
+
+static void apps_db_index()
+{
+    g_hash_table_remove_all(ids);
+    for (const GSList *l = get_apps_locations(); l; l = l->next) {
+        if (g_file_test(l->data, G_FILE_TEST_IS_DIR))
+            apps_db_index_dir(l->data, "");
+        else
+            apps_db_watch_missing_location(l->data);
+    }
+    index_dirty = FALSE;
+    if (debug_icons)
+        fprintf(stderr, "tint2: apps db: indexed %u desktop files\n", g_hash_table_size(ids));
+}
+
+void apps_db_init()
+{
+    if (entries)
+        return;
+
+    entries = g_hash_table_new_full(g_str_hash, g_str_equal, free, apps_db_entry_free);
+    ids = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+#ifdef HAVE_INOTIFY
+    watches = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free);
+    watched_dirs = g_hash_table_new(g_str_hash, g_str_equal);
+    parent_watches = g_hash_table_new(g_direct_hash, g_direct_equal);
+    apps_db_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (apps_db_fd < 0)
+        fprintf(stderr, "tint2: inotify_init1 failed, application directories will not be watched\n");
+#endif
+    apps_db_index();
+}
+
+void apps_db_cleanup()
+{
+    if (!entries)
+        return;
+#ifdef HAVE_INOTIFY
+    // Closing the descriptor releases all the watches
+    if (apps_db_fd >= 0)
+        close(apps_db_fd);
+    apps_db_fd = -1;
+    g_hash_table_destroy(parent_watches);
+    g_hash_table_destroy(watched_dirs);
+    g_hash_table_destroy(watches);
+    parent_watches = watched_dirs = watches = NULL;
+#endif
+    g_hash_table_destroy(entries);
+    g_hash_table_destroy(ids);
+    entries = ids = NULL;
+}
+
+const char *apps_db_resolve(const char *path)
+{
+    apps_db_init();
+
+    if (path[0] == '/')
+        return path;
+
+    if (index_dirty)
+        apps_db_index();
+
+    // Also accept IDs written as relative paths, e.g. "kde4/konsole.desktop"
+    char *id = strdup(path);
+    for (char *p = strchr(id, '/'); p; p = strchr(p + 1, '/'))
+        *p = '-';
+    const char *result = g_hash_table_lookup(ids, id);
+    free(id);
+    return result;
+}
+
+static gboolean apps_db_entry_is_fresh(AppsDbEntry *e, const char *path)
+{
+    if (e->watched)
+        return TRUE;
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return !e->mtime && !e->size;
+    return st.st_mtime == e->mtime && st.st_size == e->size;
+}
+
+static AppsDbEntry *apps_db_load(const char *path)
+{
+    AppsDbEntry *e = calloc(1, sizeof(AppsDbEntry));
+    e->watched = apps_db_dir_is_watched(path);
+
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        e->mtime = st.st_mtime;
+        e->size = st.st_size;
+        e->valid = read_desktop_file(path, &e->entry) && e->entry.exec;
+    }
+    if (debug_icons)
+        fprintf(stderr, "tint2: apps db: parsed %s (%s)\n", path, e->valid ? "ok" : "invalid");
+
+    g_hash_table_replace(entries, strdup(path), e);
+    return e;
+}
+
+const DesktopEntry *apps_db_get(const char *path)
+{
+    const char *full_path = apps_db_resolve(path);
+    if (!full_path)
+        return NULL;
+
+    AppsDbEntry *e = g_hash_table_lookup(entries, full_path);
+    if (e && !apps_db_entry_is_fresh(e, full_path))
+        e = NULL;
+    if (!e)
+        e = apps_db_load(full_path);
+    return e->valid ? &e->entry : NULL;
+}
+
+void apps_db_handler(fd_set *fds, int *fdn)
+{
+#ifdef HAVE_INOTIFY
+    if (!fd_set_unset_fd( fds, fdn, apps_db_fd))
+        return;
+
+    GHashTable *changed = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    gboolean structure_changed = FALSE;
+    gboolean overflow = FALSE;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(apps_db_fd, buf, sizeof(buf))) > 0)
+    {
+        for (char *p = buf; p < buf + len; )
+        {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // Events were lost, forget everything
+                g_hash_table_remove_all(entries);
+                structure_changed = overflow = TRUE;
+                continue;
+            }
+            const char *dir = g_hash_table_lookup(watches, GINT_TO_POINTER(ev->wd));
+            if (!dir)
+                continue;
+            if (g_hash_table_contains(parent_watches, GINT_TO_POINTER(ev->wd))) {
+                // Only the creation of a missing location (or of one of its parents) is of interest
+                if (ev->mask & IN_IGNORED) {
+                    // The parent is gone too, reindexing watches the next existing one
+                    g_hash_table_remove(parent_watches, GINT_TO_POINTER(ev->wd));
+                    apps_db_unwatch(ev->wd);
+                    structure_changed = TRUE;
+                } else if (ev->len && (ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    char *path = strdup_printf( NULL, "%s/%s", dir, ev->name);
+                    if (apps_db_leads_to_location(path))
+                        structure_changed = TRUE;
+                    free(path);
+                }
+                continue;
+            }
+            if (ev->mask & IN_MOVE_SELF) {
+                // The path we know is no longer valid; IN_IGNORED follows
+                inotify_rm_watch(apps_db_fd, ev->wd);
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                // The entries of the directory were trusted because of the watch, they must be validated again.
+                // The directory is watched again by the next reindexing if it still exists, or when it is created.
+                g_hash_table_foreach_remove(entries, apps_db_entry_in_dir, (gpointer)dir);
+                apps_db_unwatch(ev->wd);
+                structure_changed = TRUE;
+                continue;
+            }
+            if (!ev->len)
+                continue;
+            if (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+                structure_changed = TRUE;
+            if (ev->mask & IN_ISDIR)
+                // New subdirectories are picked up when reindexing
+                continue;
+
+            char *path = strdup_printf( NULL, "%s/%s", dir, ev->name);
+            g_hash_table_remove(entries, path);
+            g_hash_table_replace(changed, path, NULL);
+        }
+    }
+
+    if (structure_changed)
+        index_dirty = TRUE;
+    if (debug_icons)
+        fprintf(stderr, "tint2: apps db: %u desktop files changed%s\n",
+                g_hash_table_size(changed), structure_changed ? ", reindexing" : "");
+    if (structure_changed || g_hash_table_size(changed))
+        launcher_desktop_files_changed(overflow ? NULL : changed);
+    g_hash_table_destroy(changed);
+#endif
+}
@@ -0,0 +1,56 @@
+/**************************************************************************
+* Tint2 : .desktop file database
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+#ifndef APPS_DB_H
+#define APPS_DB_H
+
+#include <glib.h>
+#include <sys/select.h>
+
+#include "apps-common.h"
+
+// In-memory database of parsed .desktop files.
+// The directories returned by get_apps_locations() are indexed once (file names only),
+// entries are parsed lazily on first lookup and kept for the lifetime of the process,
+// so that they survive config reloads and icon theme changes.
+// Where inotify is available the indexed directories are watched, and only the files that
+// actually changed are re-parsed. Elsewhere, cached entries are validated by mtime on lookup.
+
+extern int apps_db_fd;
+// The inotify descriptor, or -1 if directories are not watched.
+
+void apps_db_init();
+// Indexes the application directories and starts watching them.
+// Does nothing if the database has already been initialized.
+
+void apps_db_cleanup();
+// Releases the database. To be called only when tint2 exits, not on reload.
+
+const char *apps_db_resolve(const char *path);
+// Resolves a desktop file ID (e.g. "org.gnome.Terminal.desktop") or a full path to the full path
+// of the desktop file that should be used. Returns NULL if an ID is not installed.
+// Do not free the result; it is valid until the next database update.
+
+const DesktopEntry *apps_db_get(const char *path);
+// Same as read_desktop_file(), but returns a cached entry when the file has not changed.
+// Returns NULL if the file could not be read or has no Exec key.
+// Do not free the result; it is valid until the next database update.
+
+void apps_db_handler(fd_set *fds, int *fdn);
+// Processes pending inotify events, if apps_db_fd is set in fds.
+// Notifies the launchers about the files that changed.
+
+#endif
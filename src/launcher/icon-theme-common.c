@@ -24,8 +24,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "apps-common.h"
+#include "arena.h"
 #include "common.h"
 #include "cache.h"
 #include "test.h"
@@ -552,6 +554,9 @@ char *icon_path_from_full_path(const char *s)
 {
     if (is_full_path(s) && file_exists(s))
         return strdup(s);
+    // Plain icon names are looked up on every frame, only copy the names that can expand to a path
+    if (s[0] != '~')
+        return NULL;
     char *expanded = expand_tilde(s);
     if (is_full_path(expanded) && file_exists(expanded))
         return expanded;
@@ -586,8 +591,10 @@ char *get_icon_path_helper(GSList *themes, const char *icon_name, int size)
     char    *next_name  = NULL;
     GSList  *next_theme = NULL;
 
+    // The candidate file names are built in the frame arena, only the result is copied
+    ArenaMark mark = arena_mark(&frame_arena);
     size_t file_name_size = 4096;
-    char *file_name = calloc (file_name_size, 1);
+    char *file_name = arena_alloc (&frame_arena, file_name_size);
 
     for (GSList *t_iter = themes; t_iter; t_iter = t_iter->next)
     {
@@ -634,12 +641,8 @@ char *get_icon_path_helper(GSList *themes, const char *icon_name, int size)
 
                     size_t fname_size_new = base_name_len + theme_name_len + dir_name_len +
                                             icon_name_len + strlen (extension)  + 100;
-                    if (fname_size_new > file_name_size) {
-                        char *tmp = realloc (file_name, (file_name_size = fname_size_new));
-                        if (!tmp)
-                            goto endfind;
-                        file_name = tmp;
-                    }
+                    if (fname_size_new > file_name_size)
+                        file_name = arena_alloc (&frame_arena, (file_name_size = fname_size_new));
 
                     // filename = directory/$(themename)/subdirectory/iconname.extension
                     snprintf (  file_name, (size_t)file_name_size - 1, "%s/%s/%s/%s%s",
@@ -656,9 +659,7 @@ char *get_icon_path_helper(GSList *themes, const char *icon_name, int size)
                         if ((!best_theme || t_iter == best_theme) &&
                             dir_size_dist < min_size )
                         {
-                            if (best_name)
-                                free (best_name);
-                            best_name = strdup (file_name);
+                            best_name = arena_strdup (&frame_arena, file_name);
                             min_size = dir_size_dist;
                             best_theme = t_iter;
 
@@ -670,9 +671,7 @@ char *get_icon_path_helper(GSList *themes, const char *icon_name, int size)
                             (next_size == -1 || dir->size < next_size) &&
                             (!next_theme || t_iter == next_theme))
                         {
-                            if (next_name)
-                                free (next_name);
-                            next_name = strdup (file_name);
+                            next_name = arena_strdup (&frame_arena, file_name);
                             next_size = dir->size;
                             next_theme = t_iter;
 
@@ -684,15 +683,12 @@ char *get_icon_path_helper(GSList *themes, const char *icon_name, int size)
             }
         }
     }
-endfind:
-    free_and_null (file_name);
-    if (next_name)
+    if (next_name || best_name)
     {
-        free (best_name);
-        return next_name;
+        result = strdup (next_name ? next_name : best_name);
+        arena_rewind (&frame_arena, mark);
+        return result;
     }
-    if (best_name)
-        return best_name;
 
     // Look in unthemed icons
     {
@@ -704,11 +700,12 @@ endfind:
             {
                 char *base_name = base->data;
                 char *extension = *ext;
-                size_t file_name_size2 = strlen (base_name) + strlen (icon_name) + strlen (extension) + 100;
-                file_name = calloc (file_name_size2, 1);
+                size_t fname_size_new = strlen (base_name) + strlen (icon_name) + strlen (extension) + 100;
+                if (fname_size_new > file_name_size)
+                    file_name = arena_alloc (&frame_arena, (file_name_size = fname_size_new));
 
                 // filename = directory/iconname.extension
-                snprintf (file_name, file_name_size2 - 1, "%s/%s%s", base_name, icon_name, extension);
+                snprintf (file_name, file_name_size - 1, "%s/%s%s", base_name, icon_name, extension);
                 if (debug_icons)
                     fprintf (stderr, "tint2: Checking %s\n", file_name);
 
@@ -716,14 +713,15 @@ endfind:
                 {
                     if (debug_icons)
                         fprintf (stderr, "tint2: Found %s\n", file_name);
-                    return file_name;
+                    result = strdup (file_name);
+                    arena_rewind (&frame_arena, mark);
+                    return result;
                 }
-                else
-                    free_and_null (file_name);
             }
         }
     }
 
+    arena_rewind (&frame_arena, mark);
     return NULL;
 }
 
@@ -734,9 +732,10 @@ char *get_icon_path_from_cache(IconThemeWrapper *wrapper, const char *icon_name,
 
     load_icon_cache(wrapper);
 
-    gchar *key = strdup_printf( NULL, "%s\t%s\t%d", wrapper->icon_theme_name, icon_name, size);
+    ArenaMark mark = arena_mark(&frame_arena);
+    gchar *key = arena_printf(&frame_arena, "%s\t%s\t%d", wrapper->icon_theme_name, icon_name, size);
     const gchar *value = get_from_cache(&wrapper->_cache, key);
-    free( key);
+    arena_rewind(&frame_arena, mark);
 
     if (!value) {
         fprintf(stderr,
@@ -770,9 +769,10 @@ void add_icon_path_to_cache(IconThemeWrapper *wrapper, const char *icon_name, in
 
     load_icon_cache(wrapper);
 
-    gchar *key = strdup_printf( NULL, "%s\t%s\t%d", wrapper->icon_theme_name, icon_name, size);
+    ArenaMark mark = arena_mark(&frame_arena);
+    gchar *key = arena_printf(&frame_arena, "%s\t%s\t%d", wrapper->icon_theme_name, icon_name, size);
     add_to_cache(&wrapper->_cache, key, path);
-    free( key);
+    arena_rewind(&frame_arena, mark);
 }
 
 char *get_icon_path(IconThemeWrapper *wrapper, const char *icon_name, int size, gboolean use_fallbacks)
@@ -831,6 +831,84 @@ notfound:
     return path;
 }
 
+BENCH(icon_lookup)
+{
+    // Theme search without the icon path cache, as on the first start or for a new icon
+    IconThemeWrapper *wrapper = load_themes("hicolor");
+    load_default_theme(wrapper);
+    if (!wrapper->themes) {
+        free_themes(wrapper);
+        BENCH_SKIP("hicolor icon theme not installed");
+    }
+    const char *icon_names[] = {"firefox",
+                                "utilities-terminal",
+                                "system-file-manager",
+                                "text-editor",
+                                "application-x-executable",
+                                "no-such-icon"};
+    size_t i = 0;
+    BENCH_LOOP
+        free(get_icon_path_helper(wrapper->themes, icon_names[i++ % ARRAY_SIZE(icon_names)], 48));
+    free_themes(wrapper);
+}
+
 // TESTS
 
 STR_ARRAY_TEST_SORTED (index_opt_sv, ARRAY_SIZE(index_opt_sv));
+
+TEST(icon_lookup_mallocs)
+{
+    // A theme with a single icon in a temporary icon location
+    char base[] = "/tmp/tint2-test-icons-XXXXXX";
+    ASSERT_NON_NULL(mkdtemp(base));
+    char *apps = strdup_printf(NULL, "%s/test/48x48/apps", base);
+    char *icon = strdup_printf(NULL, "%s/foo.png", apps);
+    g_mkdir_with_parents(apps, 0700);
+    fclose(fopen(icon, "w"));
+    icon_locations = g_slist_append(NULL, strdup(base));
+
+    IconThemeWrapper *wrapper = load_themes("test");
+    IconTheme *theme = make_theme("test");
+    IconThemeDir *dir = calloc(1, sizeof(IconThemeDir));
+    dir->name = strdup("48x48/apps");
+    dir->size = dir->min_size = dir->max_size = 48;
+    dir->type = ICON_DIR_TYPE_FIXED;
+    theme->list_directories = g_slist_append(NULL, dir);
+    wrapper->themes = g_slist_append(NULL, theme);
+    wrapper->_themes_loaded = TRUE;
+    init_cache(&wrapper->_cache);
+    wrapper->_cache.loaded = TRUE;
+    add_icon_path_to_cache(wrapper, "foo", 48, icon);
+    free(get_icon_path_helper(wrapper->themes, "foo", 48));
+    arena_reset(&frame_arena);
+
+    // Only the results are allocated: the file names and the cache keys are built in the frame arena.
+    // With heap strings, the same calls made 10 allocations (9 without SVG support) and 2.
+    test_count_mallocs_start();
+    char *found = get_icon_path_helper(wrapper->themes, "foo", 48);
+    char *missing = get_icon_path_helper(wrapper->themes, "bar", 48);
+    long helper_mallocs = test_count_mallocs_stop();
+    test_count_mallocs_start();
+    char *cached = get_icon_path_from_cache(wrapper, "foo", 48);
+    long cache_mallocs = test_count_mallocs_stop();
+
+    ASSERT_STR_EQUAL(found, icon);
+    ASSERT_NULL(missing);
+    ASSERT_STR_EQUAL(cached, icon);
+    if (helper_mallocs >= 0)
+        ASSERT_EQUAL(helper_mallocs, 1L);
+    if (cache_mallocs >= 0)
+        ASSERT_EQUAL(cache_mallocs, 1L);
+
+    free(found);
+    free(cached);
+    free_themes(wrapper);
+    icon_theme_common_cleanup();
+    arena_free(&frame_arena);
+    unlink(icon);
+    for (char *slash; (slash = strrchr(apps, '/')) && strcmp(apps, base) != 0; *slash = '\0')
+        rmdir(apps);
+    rmdir(base);
+    free(icon);
+    free(apps);
+}
@@ -39,6 +39,7 @@
 #include "taskbar.h"
 #include "launcher.h"
 #include "apps-common.h"
+#include "apps-db.h"
 #include "icon-theme-common.h"
 
 gboolean launcher_enabled;
@@ -99,7 +100,7 @@ void init_launcher_panel(void *p)
     launcher->area._resize = resize_launcher;
     launcher->area._on_change_layout = relayout_launcher;
     launcher->area._get_desired_size = launcher_get_desired_size;
-    launcher->area.resize_needed = TRUE;
+    schedule_resize(&launcher->area);
     schedule_redraw(&launcher->area);
     if (!launcher->area.bg)
         launcher->area.bg = &g_array_index(backgrounds, Background, 0);
@@ -119,6 +120,7 @@ void init_launcher_panel(void *p)
     area_gradients_create(&launcher->area);
 
     load_icon_themes();
+    apps_db_init();
     launcher_load_icons(launcher);
 }
 
@@ -131,7 +133,7 @@ void free_icon_themes()
 void cleanup_launcher()
 {
     for (int i = 0; i < num_panels; i++) {
-        Panel *panel = &panels[i];
+        Panel *panel = panels[i];
         Launcher *launcher = &panel->launcher;
         cleanup_launcher_theme(launcher);
     }
@@ -162,6 +164,7 @@ void cleanup_launcher_theme(Launcher *launcher)
             free(launcherIcon->cmd);
             free(launcherIcon->icon_tooltip);
             free(launcherIcon->config_path);
+            free(launcherIcon->desktop_path);
             free(launcherIcon);
         }
     }
@@ -491,8 +494,12 @@ void launcher_load_icons(Launcher *launcher)
 
 void launcher_reload_icon(Launcher *launcher, LauncherIcon *launcherIcon)
 {
-    DesktopEntry entry;
-    if (read_desktop_file(launcherIcon->config_path, &entry) && entry.exec) {
+    const DesktopEntry *entry = apps_db_get(launcherIcon->config_path);
+    const char *desktop_path = apps_db_resolve(launcherIcon->config_path);
+    free(launcherIcon->desktop_path);
+    launcherIcon->desktop_path = desktop_path ? strdup(desktop_path) : NULL;
+
+    if (entry) {
         schedule_redraw(&launcherIcon->area);
         if (launcherIcon->cmd)
             free(launcherIcon->cmd);
@@ -500,19 +507,19 @@ void launcher_reload_icon(Launcher *launcher, LauncherIcon *launcherIcon)
             free(launcherIcon->cwd);
         if (launcherIcon->icon_name)
             free(launcherIcon->icon_name);
-        launcherIcon->cmd = strdup(entry.exec);
-        launcherIcon->cwd = entry.cwd ? strdup(entry.cwd) : NULL;
-        launcherIcon->start_in_terminal = entry.start_in_terminal;
-        launcherIcon->startup_notification = entry.startup_notification;
-        launcherIcon->icon_name = strdup (entry.icon ? entry.icon : DEFAULT_ICON);
+        launcherIcon->cmd = strdup(entry->exec);
+        launcherIcon->cwd = entry->cwd ? strdup(entry->cwd) : NULL;
+        launcherIcon->start_in_terminal = entry->start_in_terminal;
+        launcherIcon->startup_notification = entry->startup_notification;
+        launcherIcon->icon_name = strdup (entry->icon ? entry->icon : DEFAULT_ICON);
         char *icon_tooltip = NULL;
-        if (entry.name)
-            icon_tooltip = entry.generic_name   ? strdup_printf( NULL, "%s (%s)", entry.name, entry.generic_name)
-                                                : strdup_printf( NULL, "%s", entry.name);
-        else if (entry.generic_name)
-            icon_tooltip = strdup_printf( NULL, "%s", entry.generic_name);
-        else if (entry.exec)
-            icon_tooltip = strdup_printf( NULL, "%s", entry.exec);
+        if (entry->name)
+            icon_tooltip = entry->generic_name  ? strdup_printf( NULL, "%s (%s)", entry->name, entry->generic_name)
+                                                : strdup_printf( NULL, "%s", entry->name);
+        else if (entry->generic_name)
+            icon_tooltip = strdup_printf( NULL, "%s", entry->generic_name);
+        else if (entry->exec)
+            icon_tooltip = strdup_printf( NULL, "%s", entry->exec);
 
         if (icon_tooltip) {
             free( launcherIcon->icon_tooltip);
@@ -523,7 +530,29 @@ void launcher_reload_icon(Launcher *launcher, LauncherIcon *launcherIcon)
     } else {
         hide(&launcherIcon->area);
     }
-    free_desktop_entry(&entry);
+}
+
+void launcher_desktop_files_changed(GHashTable *paths)
+{
+    for (int i = 0; i < num_panels; i++) {
+        Launcher *launcher = &panels[i]->launcher;
+        gboolean reloaded = FALSE;
+        for (GSList *l = launcher->list_icons; l; l = l->next) {
+            LauncherIcon *launcherIcon = l->data;
+            // Reload if the file changed, if the ID now resolves to another file, or if the icon is hidden
+            const char *desktop_path = apps_db_resolve(launcherIcon->config_path);
+            if (paths && launcherIcon->area.on_screen &&
+                g_strcmp0(desktop_path, launcherIcon->desktop_path) == 0 &&
+                !(desktop_path && g_hash_table_contains(paths, desktop_path)))
+                continue;
+            launcher_reload_icon(launcher, launcherIcon);
+            reloaded = TRUE;
+        }
+        if (reloaded) {
+            schedule_resize(&launcher->area);
+            schedule_panel_redraw();
+        }
+    }
 }
 
 void launcher_reload_hidden_icons(Launcher *launcher)
@@ -587,10 +616,10 @@ void load_icon_themes()
 void launcher_default_icon_theme_changed()
 {
     for (int i = 0; i < num_panels; i++) {
-        Launcher *launcher = &panels[i].launcher;
+        Launcher *launcher = &panels[i]->launcher;
         cleanup_launcher_theme(launcher);
         launcher_load_icons(launcher);
-        launcher->area.resize_needed = TRUE;
+        schedule_resize(&launcher->area);
     }
     schedule_panel_redraw();
 }
@@ -26,6 +26,7 @@ typedef struct Launcher {
 typedef struct LauncherIcon {
     Area area;          // always start with area
     char *config_path;
+    char *desktop_path; // Full path of the .desktop file config_path resolves to
     Imlib_Image image;
     Imlib_Image image_hover;
     Imlib_Image image_pressed;
@@ -70,6 +71,10 @@ void launcher_default_icon_theme_changed();
 void launcher_load_icons(Launcher *launcher);
 // Populates the list_icons list
 
+void launcher_desktop_files_changed(GHashTable *paths);
+// Reloads the icons affected by changes in the application directories.
+// paths is the set of full paths of the .desktop files that changed, or NULL if unknown.
+
 void launcher_action(LauncherIcon *icon, XEvent *e, int x, int y);
 
 void test_launcher_read_desktop_file();
@@ -43,6 +43,8 @@
 #include <libsn/sn.h>
 #endif
 
+#include "apps-db.h"
+#include "arena.h"
 #include "config.h"
 #include "drag_and_drop.h"
 #include "fps_distribution.h"
@@ -75,6 +77,8 @@ static double ts_event_read;
 static double ts_event_processed;
 static double ts_render_finished;
 static double ts_flush_finished;
+static unsigned long events_received;
+static unsigned long events_processed;
 
 static gboolean first_render;
 
@@ -89,7 +93,7 @@ void handle_event_property_notify(XEvent *e)
         xsettings_client_process_event(xsettings_client, e);
     for (int i = 0; i < num_panels; i++)
     {
-        Panel *p = &panels[i];
+        Panel *p = panels[i];
         if (win == p->main_win)
         {
             if (at == server.atom [_NET_WM_DESKTOP] && get_window_desktop( win) != ALL_DESKTOPS)
@@ -135,9 +139,9 @@ void handle_event_property_notify(XEvent *e)
                 init_taskbar();
                 for (int i = 0; i < num_panels; i++)
                 {
-                    init_taskbar_panel(&panels[i]);
-                    set_panel_items_order(&panels[i]);
-                    panels[i].area.resize_needed = TRUE;
+                    init_taskbar_panel(panels[i]);
+                    set_panel_items_order(panels[i]);
+                    schedule_resize(&panels[i]->area);
                 }
                 taskbar_refresh_tasklist();
                 reset_active_task();
@@ -151,7 +155,7 @@ void handle_event_property_notify(XEvent *e)
                 tooltip_trigger_hide();
                 for (int i = 0; i < num_panels; i++)
                 {
-                    Panel *panel = &panels[i];
+                    Panel *panel = panels[i];
                     set_taskbar_state(&panel->taskbar[old_desktop], TASKBAR_NORMAL);
                     set_taskbar_state(&panel->taskbar[server.desktop], TASKBAR_ACTIVE);
                     // check ALL_DESKTOPS task => resize taskbar
@@ -159,30 +163,28 @@ void handle_event_property_notify(XEvent *e)
                     if (server.num_desktops > old_desktop)
                     {
                         taskbar = &panel->taskbar[old_desktop];
-                        for_taskbar_tasks( taskbar, l)
+                        for_taskbar_tasks( taskbar, task)
                         {
-                            Task *task = l->data;
                             if (task->desktop == ALL_DESKTOPS)
                             {
                                 task->area.on_screen = always_show_all_desktop_tasks;
-                                taskbar->area.resize_needed = TRUE;
+                                schedule_resize(&taskbar->area);
                                 if (taskbar_mode == MULTI_DESKTOP)
-                                    panel->area.resize_needed = TRUE;
+                                    schedule_resize(&panel->area);
 
                                 schedule_panel_redraw();
                             }
                         }
                     }
                     taskbar = &panel->taskbar[server.desktop];
-                    for_taskbar_tasks( taskbar, l)
+                    for_taskbar_tasks( taskbar, task)
                     {
-                        Task *task = l->data;
                         if (task->desktop == ALL_DESKTOPS)
                         {
                             task->area.on_screen = TRUE;
-                            taskbar->area.resize_needed = TRUE;
+                            schedule_resize(&taskbar->area);
                             if (taskbar_mode == MULTI_DESKTOP)
-                                panel->area.resize_needed = TRUE;
+                                schedule_resize(&panel->area);
                         }
                     }
                     if (server.viewports)
@@ -235,7 +237,7 @@ void handle_event_property_notify(XEvent *e)
                 fprintf(stderr, "tint2: %s %d: win = root, atom = _XROOTPMAP_ID\n", __func__, __LINE__);
             // change Wallpaper
             for (int i = 0; i < num_panels; i++)
-                set_panel_background(&panels[i]);
+                set_panel_background(panels[i]);
             schedule_panel_redraw();
         }
     } else {
@@ -253,7 +255,7 @@ void handle_event_property_notify(XEvent *e)
                     __func__,
                     __LINE__,
                     win,
-                    task ? (task->title ? task->title : "??") : "null",
+                    task ? (task->model->title ? task->model->title : "??") : "null",
                     atom_name);
             XFree(atom_name);
         }
@@ -272,7 +274,7 @@ void handle_event_property_notify(XEvent *e)
             }
             return;
         }
-        // fprintf(stderr, "tint2: atom root_win = %s, %s\n", XGetAtomName(server.display, at), task->title);
+        // fprintf(stderr, "tint2: atom root_win = %s, %s\n", XGetAtomName(server.display, at), task->model->title);
 
         // Window title changed
         if (at == server.atom [_NET_WM_VISIBLE_NAME]  ||
@@ -322,8 +324,8 @@ void handle_event_property_notify(XEvent *e)
         }
         // Window icon changed
         else if (at == server.atom [_NET_WM_ICON]) {
-            task_update_icon(task);
-            schedule_panel_redraw();
+            if (task_update_icon(task))
+                schedule_panel_redraw();
         }
         // Window desktop changed
         else if (at == server.atom [_NET_WM_DESKTOP])
@@ -340,8 +342,9 @@ void handle_event_property_notify(XEvent *e)
             if (wmhints && wmhints->flags & XUrgencyHint)
                 add_urgent(task);
             XFree(wmhints);
-            task_update_icon(task);
-            schedule_panel_redraw();
+            // _NET_WM_ICON takes precedence over the icon in WM_HINTS, which is mostly updated for urgency
+            if (!task->model->icon_from_net_wm_icon && task_update_icon(task))
+                schedule_panel_redraw();
         }
 
         if (!server.got_root_win)
@@ -365,7 +368,8 @@ void handle_event_configure_notify(XEvent *e)
 
     // change in root window (xrandr)
     if (win == server.root_win) {
-        emit_self_restart("configuration change in the root window");
+        if (!reconfigure_panels())
+            emit_self_restart("monitor layout changed");
         return;
     }
 
@@ -534,10 +538,10 @@ void handle_x_event(XEvent *e)
         }
         if (e->xany.window == g_tooltip.window || !systray_enabled)
             break;
-        for (GSList *it = systray.list_icons; it; it = it->next)
         {
-            if (((TrayWindow *)it->data)->win == e->xany.window)
-                systray_destroy_event(it->data);
+            TrayWindow *traywin = systray_find_icon(e->xany.window);
+            if (traywin && traywin->win == e->xany.window)
+                systray_destroy_event(traywin);
         }
         break;
 
@@ -599,7 +603,21 @@ void handle_x_events()
         XNextEvent(server.display, &e);
         if (debug_fps)
             ts_event_read = get_time();
+        events_received++;
 
+        // Motion compression: of consecutive pointer motions over the same window, only the last one matters.
+        // Motions separated by other events (e.g. LeaveNotify) are kept, so that the order is preserved.
+        while (e.type == MotionNotify && XEventsQueued(server.display, QueuedAfterReading) > 0)
+        {
+            XEvent next;
+            XPeekEvent(server.display, &next);
+            if (next.type != MotionNotify || next.xmotion.window != e.xmotion.window)
+                break;
+            XNextEvent(server.display, &e);
+            events_received++;
+        }
+
+        events_processed++;
         handle_x_event(&e);
     }
 }
@@ -627,6 +645,7 @@ void prepare_fd_set(fd_set *set, int *max_fd)
         fd_add_if_set_ (execp->backend->child_pipe_stderr);
     }
     fd_add_if_set_ (uevent_fd);
+    fd_add_if_set_ (apps_db_fd);
 
     #undef fd_add_if_set_
 }
@@ -639,7 +658,7 @@ void handle_panel_refresh()
 
     for (int i = 0; i < num_panels; i++)
     {
-        Panel *panel = &panels[i];
+        Panel *panel = panels[i];
         if (!first_render && panel_shrink)
             shrink_panel(panel);
 
@@ -720,7 +739,8 @@ void handle_panel_refresh()
         fprintf(stderr,
                 BLUE "frame %d: fps = %.0f (low %.0f, med %.0f, high %.0f, samples %.0f) : processing %.0f%%, "
                      "rendering %.0f%%, "
-                     "flushing %.0f%%" RESET "\n",
+                     "flushing %.0f%%, "
+                     "X events %lu received, %lu processed" RESET "\n",
                 frame,
                 fps,
                 fps_low,
@@ -729,7 +749,10 @@ void handle_panel_refresh()
                 fps_samples,
                 proc_ratio * 100,
                 render_ratio * 100,
-                flush_ratio * 100);
+                flush_ratio * 100,
+                events_received,
+                events_processed);
+        events_received = events_processed = 0;
 #ifdef HAVE_TRACING
         stop_tracing();
         if (fps <= tracing_fps_threshold)
@@ -741,7 +764,7 @@ void handle_panel_refresh()
         {
             char path[256];
             STRBUF_AUTO_PRINTF (path, "tint2-%d-panel-%d-frame-%d.png", getpid(), i, frame);
-            save_panel_screenshot(&panels[i], path);
+            save_panel_screenshot(panels[i], path);
         }
     frame++;
 }
@@ -758,6 +781,7 @@ void run_tint2_event_loop()
     {
         if (panel_redraw)
             handle_panel_refresh();
+        arena_reset(&frame_arena);
 
         int    fdn;
         fd_set fds;
@@ -773,6 +797,8 @@ void run_tint2_event_loop()
 #endif
             if (fdn)
                 uevent_handler( &fds, &fdn);
+            if (fdn)
+                apps_db_handler( &fds, &fdn);
             if (fdn)
                 handle_sigchld_events( &fds, &fdn);
             if (fdn == 1) {
@@ -869,5 +895,6 @@ int main(int argc, char **argv)
     do{ restart = FALSE;
         tint2(argc, argv, &restart);
     } while(restart);
+    apps_db_cleanup();
     return 0;
 }
@@ -98,15 +98,10 @@ void handle_mouse_move_event(XEvent *e)
     if (&event_taskbar->area == task_drag->area.parent) {
         if (taskbar_sort_method == TASKBAR_NOSORT) {
             // Swap the task_drag with the task on the event's location (if they differ)
-            GList *drag_iter, *task_iter;
-            if ((event_task && event_task != task_drag) &&
-                (drag_iter = g_list_find (event_taskbar->area.children, task_drag)) &&
-                (task_iter = g_list_find (event_taskbar->area.children, event_task)) )
+            if (event_task && event_task != task_drag)
             {
-                gpointer temp = task_iter->data;
-                task_iter->data = drag_iter->data;
-                drag_iter->data = temp;
-                event_taskbar->area.resize_needed = TRUE;
+                swap_child_areas(&task_drag->area, &event_task->area);
+                schedule_resize(&event_taskbar->area);
                 schedule_panel_redraw();
                 task_dragged = TRUE;
             }
@@ -118,13 +113,13 @@ void handle_mouse_move_event(XEvent *e)
         Taskbar *drag_taskbar = task_drag->area.parent;
         remove_area((Area *)task_drag);
 
-        event_taskbar->area.children =  (event_taskbar->area.posx > drag_taskbar->area.posx ||
-                                         event_taskbar->area.posy > drag_taskbar->area.posy)
-                                    ?   g_list_insert ( event_taskbar->area.children, task_drag, !!taskbarname_enabled)
-                                    :   g_list_append ( event_taskbar->area.children, task_drag );
-
         // Move task to other desktop (but avoid the 'Window desktop changed' code in 'event_property_notify')
-        task_drag->area.parent = &event_taskbar->area;
+        task_drag->area.parent = NULL;
+        insert_area(&task_drag->area,
+                    &event_taskbar->area,
+                    (event_taskbar->area.posx > drag_taskbar->area.posx ||
+                     event_taskbar->area.posy > drag_taskbar->area.posy)
+                    ? taskbar_first_task_index(event_taskbar) : -1);
         task_drag->desktop = event_taskbar->desktop;
 
         change_window_desktop(task_drag->win, event_taskbar->desktop);
@@ -134,11 +129,11 @@ void handle_mouse_move_event(XEvent *e)
         if (taskbar_sort_method != TASKBAR_NOSORT)
             sort_tasks(event_taskbar);
 
-        event_taskbar->area.resize_needed = TRUE;
-        drag_taskbar->area.resize_needed = TRUE;
+        schedule_resize(&event_taskbar->area);
+        schedule_resize(&drag_taskbar->area);
         task_dragged = TRUE;
         schedule_panel_redraw();
-        panel->area.resize_needed = TRUE;
+        schedule_resize(&panel->area);
     }
 }
 
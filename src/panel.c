@@ -75,7 +75,7 @@ int max_tick_urgent;
 // panel's initial config
 Panel panel_config;
 // panels (one panel per monitor)
-Panel *panels;
+Panel **panels;
 int num_panels;
 
 GArray *backgrounds;
@@ -133,30 +133,33 @@ void default_panel()
     g_array_append_val(gradients, transparent_gradient);
 }
 
+static void free_panel(Panel *p)
+{
+    free_area(&p->area);
+    if (p->temp_pmap) {
+        XFreePixmap(server.display, p->temp_pmap);
+        p->temp_pmap = None;
+    }
+    if (p->hidden_pixmap) {
+        XFreePixmap(server.display, p->hidden_pixmap);
+        p->hidden_pixmap = None;
+    }
+    if (p->main_win) {
+        XDestroyWindow(server.display, p->main_win);
+        p->main_win = None;
+    }
+    destroy_timer(&p->autohide_timer);
+    cleanup_freespace(p);
+    free(p);
+}
+
 void cleanup_panel()
 {
     if (!panels)
         return;
 
-    for (int i = 0; i < num_panels; i++) {
-        Panel *p = &panels[i];
-
-        free_area(&p->area);
-        if (p->temp_pmap) {
-            XFreePixmap(server.display, p->temp_pmap);
-            p->temp_pmap = None;
-        }
-        if (p->hidden_pixmap) {
-            XFreePixmap(server.display, p->hidden_pixmap);
-            p->hidden_pixmap = None;
-        }
-        if (p->main_win) {
-            XDestroyWindow(server.display, p->main_win);
-            p->main_win = None;
-        }
-        destroy_timer(&p->autohide_timer);
-        cleanup_freespace(p);
-    }
+    for (int i = 0; i < num_panels; i++)
+        free_panel(panels[i]);
 
     free_icon_themes();
     free_and_null( panel_items_order);
@@ -179,6 +182,143 @@ void cleanup_panel()
     panel_config.taskbarname_font_desc = NULL;
 }
 
+static double panel_get_scale(Panel *p)
+{
+    Monitor *mon = &server.monitors[p->monitor];
+    double scale = (ui_scale_dpi_ref > 0 && mon->dpi > 0) ? mon->dpi / ui_scale_dpi_ref : 1;
+    if (ui_scale_monitor_size_ref > 0)
+        scale *= mon->height / ui_scale_monitor_size_ref;
+    if (scale > 8 || scale < 1./8) {
+        fprintf(stderr, RED "tint2: panel %d having scale %g outside bounds, resetting to 1.0" RESET "\n",
+                get_panel_index(p) + 1, scale);
+        scale = 1;
+    }
+    return scale;
+}
+
+static void create_panel(int i)
+// Creates panels[i] from panel_config, with its children and its window.
+// The backends of the panel items must have been initialized.
+{
+    Panel *p = panels[i] = malloc(sizeof(Panel));
+    *p = panel_config;
+    INIT_TIMER(p->autohide_timer);
+
+    if (panel_config.monitor < 0)
+        p->monitor = i;
+    p->scale = panel_get_scale(p);
+    fprintf(stderr, BLUE "tint2: panel %d uses scale %g " RESET "\n", i + 1, p->scale);
+    if (!p->area.bg)
+        p->area.bg = &g_array_index(backgrounds, Background, 0);
+    p->area.parent = p;
+    p->area.panel = p;
+    snprintf(p->area.name, strlen_const(p->area.name), "Panel %d", i);
+    p->area.on_screen = TRUE;
+    schedule_resize(&p->area);
+    p->area.size_mode = LAYOUT_DYNAMIC;
+    p->area._resize = resize_panel;
+    p->area._clear = panel_clear_background;
+    p->separator_list = NULL;
+    init_panel_geometry(p);
+    area_gradients_create(&p->area);
+    // add children according to panel_items
+    for_panel_items_order()
+    {
+        switch (panel_items_order[k]) {
+        case 'L':   init_launcher_panel(p);
+                    break;
+        case 'T':   init_taskbar_panel(p);
+                    break;
+#ifdef ENABLE_BATTERY
+        case 'B':   init_battery_panel(p);
+                    break;
+#endif
+        case 'S':   if (systray_on_monitor(i, num_panels)) {
+                        init_systray_panel(p);
+                        refresh_systray = TRUE;
+                    }
+                    break;
+        case 'C':   init_clock_panel(p);
+                    break;
+        case 'F':   if (!strstr(panel_items_order, "T"))
+                        init_freespace_panel(p);
+                    break;
+        case ':':   init_separator_panel(p);
+                    break;
+        case 'E':   init_execp_panel(p);
+                    break;
+        case 'P':   init_button_panel(p);
+                    break;
+        }
+    }
+    set_panel_items_order(p);
+
+    // catch some events
+    XSetWindowAttributes att = {
+        .colormap = server.colormap, .background_pixel = 0, .border_pixel = 0,
+        .event_mask = ExposureMask | ButtonPressMask | ButtonReleaseMask | ButtonMotionMask | PropertyChangeMask
+    };
+    if (p->mouse_effects || p->g_task.tooltip_enabled || p->clock.area._get_tooltip_text ||
+        (launcher_enabled && launcher_tooltip_enabled))
+    {
+        att.event_mask |= PointerMotionMask | LeaveWindowMask;
+    }
+    if (panel_autohide)
+        att.event_mask |= LeaveWindowMask | EnterWindowMask;
+    p->main_win = XCreateWindow(server.display, server.root_win,
+                                p->posx, p->posy, p->area.width, p->area.height, 0,
+                                server.depth,
+                                InputOutput,
+                                server.visual,
+                                CWEventMask | CWColormap | CWBackPixel | CWBorderPixel,
+                                &att);
+    if (!server.gc) {
+        XGCValues gcv;
+        server.gc = XCreateGC(server.display, p->main_win, 0, &gcv);
+    }
+    // fprintf(stderr, "tint2: panel %d : %d, %d, %d, %d\n", i, p->posx, p->posy, p->area.width, p->area.height);
+    set_panel_properties(p);
+    set_panel_background(p);
+
+    if (snapshot_path)
+        return;
+
+    // if we are not in 'snapshot' mode then map new panel
+    XMapWindow(server.display, p->main_win);
+
+    if (panel_autohide)
+        autohide_trigger_hide(p, false);
+}
+
+static void destroy_panel(Panel *p)
+// Releases a panel while tint2 keeps running. Its taskbars must have been released by cleanup_taskbar(),
+// and it must not host the systray.
+{
+    tooltip_forget_panel(p);
+    cleanup_launcher_theme(&p->launcher);
+    cleanup_separator_panel(p);
+    cleanup_execp_panel(p);
+    cleanup_button_panel(p);
+    free_panel(p);
+}
+
+static int get_systray_panel_index(int n_panels)
+{
+    if (!systray_enabled)
+        return -1;
+    for (int i = 0; i < n_panels; i++)
+        if (systray_on_monitor(i, n_panels))
+            return i;
+    return -1;
+}
+
+static void schedule_resize_tree(Area *a)
+{
+    schedule_resize(a);
+    for_children(a, child)
+        schedule_resize_tree(child);
+}
+
 void init_panel()
 {
     if (panel_config.monitor > (server.num_monitors - 1)) {
@@ -205,117 +345,100 @@ void init_panel()
 
     // number of panels (one monitor or 'all' monitors)
     num_panels = panel_config.monitor >= 0 ? 1 : server.num_monitors;
-    panels = calloc(num_panels, sizeof(Panel));
-    for (int i = 0; i < num_panels; i++)
-    {
-        panels[i] = panel_config;
-        INIT_TIMER(panels[i].autohide_timer);
-    }
+    panels = calloc(num_panels, sizeof(Panel *));
 
     fprintf(stderr,
             "tint2: nb monitors %d, nb monitors used %d, nb desktops %d\n",
             server.num_monitors,
             num_panels,
             server.num_desktops);
-    for (int i = 0; i < num_panels; i++) {
-        Panel *p = &panels[i];
-
-        if (panel_config.monitor < 0)
-            p->monitor = i;
-        p->scale = (ui_scale_dpi_ref > 0 && server.monitors[p->monitor].dpi > 0)
-                    ? server.monitors[p->monitor].dpi / ui_scale_dpi_ref : 1;
-        if (ui_scale_monitor_size_ref > 0)
-            p->scale *= server.monitors[p->monitor].height / ui_scale_monitor_size_ref;
-        if (p->scale > 8 || p->scale < 1./8) {
-            fprintf(stderr, RED "tint2: panel %d having scale %g outside bounds, resetting to 1.0" RESET "\n", i + 1, p->scale);
-            p->scale = 1;
-        }
-        fprintf(stderr, BLUE "tint2: panel %d uses scale %g " RESET "\n", i + 1, p->scale);
-        if (!p->area.bg)
-            p->area.bg = &g_array_index(backgrounds, Background, 0);
-        p->area.parent = p;
-        p->area.panel = p;
-        snprintf(p->area.name, strlen_const(p->area.name), "Panel %d", i);
-        p->area.on_screen = TRUE;
-        p->area.resize_needed = TRUE;
-        p->area.size_mode = LAYOUT_DYNAMIC;
-        p->area._resize = resize_panel;
-        p->area._clear = panel_clear_background;
-        p->separator_list = NULL;
-        init_panel_geometry(p);
-        area_gradients_create(&p->area);
-        // add children according to panel_items
-        for_panel_items_order()
-        {
-            switch (panel_items_order[k]) {
-            case 'L':   init_launcher_panel(p);
-                        break;
-            case 'T':   init_taskbar_panel(p);
-                        break;
-#ifdef ENABLE_BATTERY
-            case 'B':   init_battery_panel(p);
-                        break;
-#endif
-            case 'S':   if (systray_on_monitor(i, num_panels)) {
-                            init_systray_panel(p);
-                            refresh_systray = TRUE;
-                        }
-                        break;
-            case 'C':   init_clock_panel(p);
-                        break;
-            case 'F':   if (!strstr(panel_items_order, "T"))
-                            init_freespace_panel(p);
-                        break;
-            case ':':   init_separator_panel(p);
-                        break;
-            case 'E':   init_execp_panel(p);
-                        break;
-            case 'P':   init_button_panel(p);
-                        break;
-            }
-        }
-        set_panel_items_order(p);
-
-        // catch some events
-        XSetWindowAttributes att = {
-            .colormap = server.colormap, .background_pixel = 0, .border_pixel = 0,
-            .event_mask = ExposureMask | ButtonPressMask | ButtonReleaseMask | ButtonMotionMask | PropertyChangeMask
-        };
-        if (p->mouse_effects || p->g_task.tooltip_enabled || p->clock.area._get_tooltip_text ||
-            (launcher_enabled && launcher_tooltip_enabled))
-        {
-            att.event_mask |= PointerMotionMask | LeaveWindowMask;
-        }
-        if (panel_autohide)
-            att.event_mask |= LeaveWindowMask | EnterWindowMask;
-        p->main_win = XCreateWindow(server.display, server.root_win,
-                                    p->posx, p->posy, p->area.width, p->area.height, 0,
-                                    server.depth,
-                                    InputOutput,
-                                    server.visual,
-                                    CWEventMask | CWColormap | CWBackPixel | CWBorderPixel,
-                                    &att);
-        if (!server.gc) {
-            XGCValues gcv;
-            server.gc = XCreateGC(server.display, p->main_win, 0, &gcv);
-        }
-        // fprintf(stderr, "tint2: panel %d : %d, %d, %d, %d\n", i, p->posx, p->posy, p->area.width, p->area.height);
-        set_panel_properties(p);
-        set_panel_background(p);
+    for (int i = 0; i < num_panels; i++)
+        create_panel(i);
 
-        if (snapshot_path)
-            continue;
+    taskbar_refresh_tasklist();
+    reset_active_task();
+    update_all_taskbars_visibility();
+}
 
-        // if we are not in 'snapshot' mode then map new panel
-        XMapWindow(server.display, p->main_win);
 
-        if (panel_autohide)
-            autohide_trigger_hide(p, false);
+gboolean reconfigure_panels()
+{
+    Monitor *old_monitors = server.monitors;
+    int old_num_monitors = server.num_monitors;
+    server.monitors = NULL;
+    server.num_monitors = 0;
+    get_monitors();
+
+    gboolean changed = server.num_monitors != old_num_monitors;
+    for (int i = 0; !changed && i < server.num_monitors; i++)
+        if (!monitors_equal(&old_monitors[i], &server.monitors[i]))
+            changed = TRUE;
+    free_monitors(old_monitors, old_num_monitors);
+    if (!changed) {
+        if (debug_geometry)
+            fprintf(stderr, "tint2: monitors unchanged\n");
+        return TRUE;
     }
 
-    taskbar_refresh_tasklist();
-    reset_active_task();
-    update_all_taskbars_visibility();
+    // Panels are bound to monitors by index, as on startup
+    if (panel_config.monitor >= server.num_monitors)
+        return FALSE;
+    int old_num_panels = num_panels;
+    int new_num_panels = panel_config.monitor >= 0 ? 1 : server.num_monitors;
+    // The systray icons are embedded in the window of their panel, which must stay
+    if (get_systray_panel_index(new_num_panels) != get_systray_panel_index(old_num_panels))
+        return FALSE;
+
+    print_monitors();
+    // Sizes inside the panels depend on the scale, the taskbars keep some of them
+    gboolean rebuild_taskbars = new_num_panels != old_num_panels;
+    for (int i = 0; i < MIN(old_num_panels, new_num_panels); i++)
+        if (panel_get_scale(panels[i]) != panels[i]->scale)
+            rebuild_taskbars = TRUE;
+    rebuild_taskbars = rebuild_taskbars && taskbar_enabled;
+    if (rebuild_taskbars) {
+        cleanup_taskbar();
+        init_taskbar();
+    }
+
+    for (int i = new_num_panels; i < old_num_panels; i++)
+        destroy_panel(panels[i]);
+    panels = realloc(panels, new_num_panels * sizeof(Panel *));
+    num_panels = new_num_panels;
+    for (int i = old_num_panels; i < new_num_panels; i++)
+        create_panel(i);
+
+    for (int i = 0; i < MIN(old_num_panels, new_num_panels); i++) {
+        Panel *p = panels[i];
+        double scale = panel_get_scale(p);
+        if (scale != p->scale) {
+            p->scale = scale;
+            fprintf(stderr, BLUE "tint2: panel %d uses scale %g " RESET "\n", i + 1, p->scale);
+        }
+        // init_panel_geometry() turns the configured size into pixels, start over from the configuration
+        p->area.width = panel_config.area.width;
+        p->area.height = panel_config.area.height;
+        p->fractional_width = panel_config.fractional_width;
+        p->fractional_height = panel_config.fractional_height;
+        init_panel_geometry(p);
+        set_panel_window_geometry(p);
+        set_panel_background(p);
+        if (rebuild_taskbars) {
+            init_taskbar_panel(p);
+            set_panel_items_order(p);
+        }
+        schedule_resize_tree(&p->area);
+        update_minimized_icon_positions(p);
+    }
+    if (rebuild_taskbars) {
+        taskbar_refresh_tasklist();
+        reset_active_task();
+        update_all_taskbars_visibility();
+    }
+    schedule_resize(&systray.area);
+    refresh_systray = TRUE;
+    schedule_panel_redraw();
+    return TRUE;
 }
 
 void panel_get_size(Panel *panel)
@@ -440,7 +563,7 @@ gboolean resize_panel(void *obj)
                     continue;
                 if (panel->taskbar[i].area.width  != width || panel->taskbar[i].area.height != height)
                 {
-                    panel->taskbar[i].area.resize_needed = TRUE;
+                    schedule_resize(&panel->taskbar[i].area);
                     panel->taskbar[i].area.width  = width;
                     panel->taskbar[i].area.height = height;
                 }
@@ -477,7 +600,7 @@ gboolean resize_panel(void *obj)
                                             + 2 * taskbar->area.paddingx * panel->scale;
                 }
 
-                if (taskbarname_enabled && taskbar->area.children) {
+                if (taskbarname_enabled && area_num_children(&taskbar->area)) {
                     Area *name = (Area *)&taskbar->bar_name;
                     if (name->on_screen) {
                         if (panel_horizontal)
@@ -487,16 +610,15 @@ gboolean resize_panel(void *obj)
                     }
                 }
                 int gaps_count = -1;
-                for (GList *l = taskbar->area.children; l; l = l->next)
+                for_children(&taskbar->area, child)
                 {
-                    Area *child = l->data;
                     if (!child->on_screen)
                         continue;
 
                     gaps_count++;
 
                     // By the way: Compute the total number of tasks
-                    if (!taskbarname_enabled || l != taskbar->area.children)
+                    if (!taskbarname_enabled || child != area_child(&taskbar->area, 0))
                         num_tasks++;
                 }
                 if (gaps_count > 0) {
@@ -522,11 +644,9 @@ gboolean resize_panel(void *obj)
                     if (!taskbar->area.on_screen)
                         continue;
 
-                    for (GList *l = taskbar->area.children; l; l = l->next)
+                    for_taskbar_tasks( taskbar, task)
                     {
-                        if (taskbarname_enabled && l == taskbar->area.children)
-                            continue;
-                        Area *child = l->data;
+                        Area *child = &task->area;
                         if (child->on_screen)
                         {
                             if (panel_horizontal)
@@ -612,8 +732,11 @@ gboolean resize_panel(void *obj)
                 }
             for (int i = 0; i < panel->num_desktops; i++) {
                 Taskbar *taskbar = &panel->taskbar[i];
-                taskbar->area.resize_needed = taskbar->area.old_width  != taskbar->area.width ||
-                                              taskbar->area.old_height != taskbar->area.height;
+                if (taskbar->area.old_width  != taskbar->area.width ||
+                    taskbar->area.old_height != taskbar->area.height)
+                    schedule_resize(&taskbar->area);
+                else
+                    taskbar->area.resize_needed = FALSE;
             }
         }
     }
@@ -690,12 +813,11 @@ void update_strut(Panel *p)
 void set_panel_items_order(Panel *p)
 {
     if (p->area.children) {
-        g_list_free(p->area.children);
-        p->area.children = 0;
+        g_ptr_array_free(p->area.children, TRUE);
+        p->area.children = NULL;
     }
-    GList *ch_tail = NULL;
 
-    #define ADD_CHILD(c) g_list_append_tail (p->area.children, ch_tail, (c))
+    #define ADD_CHILD(c) area_append_child (&p->area, (Area *)(c))
 
     int i_execp = 0;
     int i_separator = 0;
@@ -703,10 +825,10 @@ void set_panel_items_order(Panel *p)
     int i_button = 0;
     for_panel_items_order()
     {
-        int i = p - panels;
+        int i = get_panel_index(p);
         switch (panel_items_order[k]) {
         case 'L':   ADD_CHILD (&p->launcher);
-                    p->launcher.area.resize_needed = TRUE;
+                    schedule_resize(&p->launcher.area);
                     break;
         case 'T':   for (int j = 0; j < p->num_desktops; j++)
                         ADD_CHILD (&p->taskbar[j]);
@@ -958,11 +1080,19 @@ void set_panel_background(Panel *p)
 Panel *get_panel(Window win)
 {
     for (int i = 0; i < num_panels; i++)
-        if (panels[i].main_win == win)
-            return &panels[i];
+        if (panels[i]->main_win == win)
+            return panels[i];
     return NULL;
 }
 
+int get_panel_index(Panel *p)
+{
+    for (int i = 0; i < num_panels; i++)
+        if (panels[i] == p)
+            return i;
+    return -1;
+}
+
 Taskbar *click_taskbar(Panel *panel, int x, int y)
 {
     for (int i = 0; i < panel->num_desktops; i++) {
@@ -976,13 +1106,11 @@ Taskbar *click_taskbar(Panel *panel, int x, int y)
 Task *click_task(Panel *panel, int x, int y)
 {
     Taskbar *taskbar = click_taskbar(panel, x, y);
-    if (taskbar)
-        for_taskbar_tasks( taskbar, l)
-        {
-            Task *task = l->data;
-            if (area_is_under_mouse(task, x, y))
-                return task;
-        }
+    if (taskbar) {
+        Area *area = find_child_under_mouse(&taskbar->area, x, y);
+        if (area && area != &taskbar->bar_name.area)
+            return (Task *)area;
+    }
     return NULL;
 }
 
@@ -995,13 +1123,7 @@ Launcher *click_launcher(Panel *panel, int x, int y)
 LauncherIcon *click_launcher_icon(Panel *panel, int x, int y)
 {
     Launcher *launcher = click_launcher(panel, x, y);
-    if (launcher)
-        for (GSList *l = launcher->list_icons; l; l = l->next) {
-            LauncherIcon *icon = l->data;
-            if (area_is_under_mouse(icon, x, y))
-                return icon;
-        }
-    return NULL;
+    return launcher ? (LauncherIcon *)find_child_under_mouse(&launcher->area, x, y) : NULL;
 }
 
 Clock *click_clock(Panel *panel, int x, int y)
@@ -1120,8 +1242,8 @@ void shrink_panel(Panel *panel)
         panel_get_position(panel);
         set_panel_window_geometry(panel);
         set_panel_background(panel);
-        panel->area.resize_needed = TRUE;
-        systray.area.resize_needed = TRUE;
+        schedule_resize(&panel->area);
+        schedule_resize(&systray.area);
         schedule_redraw(&systray.area);
         refresh_systray = TRUE;
         update_minimized_icon_positions(panel);
@@ -1131,8 +1253,10 @@ void shrink_panel(Panel *panel)
 void render_panel(Panel *panel)
 {
     relayout(&panel->area);
-    if (debug_geometry)
+    if (debug_geometry) {
+        fprintf(stderr, "tint2: relayout visited %d areas\n", relayout_num_visited);
         area_dump_geometry(&panel->area, 0);
+    }
     update_dependent_gradients(&panel->area);
     draw_tree(&panel->area);
 }
@@ -1220,7 +1344,7 @@ void save_panel_screenshot(const Panel *panel, const char *path)
 
 void save_screenshot(const char *path)
 {
-    Panel *panel = &panels[0];
+    Panel *panel = panels[0];
 
     if (panel->area.width > server.monitors[0].width)
         panel->area.width = server.monitors[0].width;
@@ -173,7 +173,8 @@ typedef struct Panel {
 } Panel;
 
 extern Panel panel_config;
-extern Panel *panels;
+// Panels are allocated one by one, so that Areas and timers may keep pointers to them while panels are added or removed
+extern Panel **panels;
 extern int num_panels;
 
 void default_panel();   // default global data
@@ -184,6 +185,12 @@ void init_panel();
 // use panel_config as default value
 
 void init_panel_geometry(Panel *panel);
+
+gboolean reconfigure_panels();
+// Re-reads the monitors after a RandR change and moves, resizes and rescales the panels in place. Panels are created
+// or destroyed when monitors are added or removed.
+// Returns FALSE if the panels cannot follow the new layout without a restart, i.e. when the monitor of the panel or
+// the panel hosting the systray would go away.
 gboolean resize_panel(void *obj);
 void render_panel(Panel *panel);
 void shrink_panel(Panel *panel);
@@ -203,6 +210,9 @@ void set_panel_background(Panel *p);
 Panel *get_panel(Window win);
 // detect witch panel
 
+int get_panel_index(Panel *p);
+// position of p in panels, or -1
+
 Taskbar *click_taskbar(Panel *panel, int x, int y);
 Task *click_task(Panel *panel, int x, int y);
 Launcher *click_launcher(Panel *panel, int x, int y);
@@ -88,7 +88,7 @@ void init_separator_panel(void *p)
         separator->area.panel = p;
         snprintf (separator->area.name, strlen_const(separator->area.name), "separator");
         separator->area.size_mode = LAYOUT_FIXED;
-        separator->area.resize_needed = TRUE;
+        schedule_resize(&separator->area);
         separator->area.on_screen = TRUE;
         separator->area._resize = resize_separator;
         separator->area._get_desired_size = separator_get_desired_size;
@@ -97,13 +97,18 @@ void init_separator_panel(void *p)
     }
 }
 
+void cleanup_separator_panel(void *p)
+{
+    Panel *panel = p;
+    g_list_free_full(panel->separator_list, destroy_separator);
+    panel->separator_list = NULL;
+}
+
 void cleanup_separator()
 {
     // Cleanup frontends
-    for (int i = 0; i < num_panels; i++) {
-        g_list_free_full(panels[i].separator_list, destroy_separator);
-        panels[i].separator_list = NULL;
-    }
+    for (int i = 0; i < num_panels; i++)
+        cleanup_separator_panel(panels[i]);
 
     // Cleanup backends
     g_list_free_full(panel_config.separator_list, destroy_separator);
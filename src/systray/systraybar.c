@@ -59,6 +59,9 @@ char *systray_hide_name_filter;
 regex_t *systray_hide_name_regex;
 // background pixmap if we render ourselves the icons
 static Pixmap render_background;
+// Lookup of the icons by window, both the icon window and its parent -> TrayWindow*.
+// systray.list_icons keeps the display order.
+static GHashTable *icons_by_window;
 
 const int min_refresh_period = 50;
 const int max_fast_refreshes = 5;
@@ -507,6 +510,10 @@ void stop_net()
     // remove_icon change systray.list_icons
     while (systray.list_icons)
         remove_icon((TrayWindow *)systray.list_icons->data, false);
+    if (icons_by_window) {
+        g_hash_table_destroy(icons_by_window);
+        icons_by_window = NULL;
+    }
 
     if (net_sel_win != None) {
         XDestroyWindow(server.display, net_sel_win);
@@ -589,13 +596,9 @@ gboolean reject_icon(Window win)
 gboolean add_icon(Window win)
 {
     // Avoid duplicates
-    for (GSList *l = systray.list_icons; l; l = l->next) {
-        TrayWindow *other = l->data;
-
-        if (other->win == win)
-            return FALSE;
-
-    }
+    TrayWindow *other = systray_find_icon(win);
+    if (other && other->win == win)
+        return FALSE;
 
     // Filter out systray_hide_by_icon_name
     if (reject_icon(win))
@@ -719,6 +722,10 @@ gboolean add_icon(Window win)
     show(&systray.area);
 
     systray.list_icons = g_slist_insert_sorted (systray.list_icons, traywin, compare_traywindows);
+    if (!icons_by_window)
+        icons_by_window = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_hash_table_insert(icons_by_window, GSIZE_TO_POINTER(traywin->win), traywin);
+    g_hash_table_insert(icons_by_window, GSIZE_TO_POINTER(traywin->parent), traywin);
     // print_icons();
 
     if (!panel->is_hidden) {
@@ -736,8 +743,8 @@ gboolean add_icon(Window win)
                 BLUE "[%f] %s:%d trigger resize & redraw" RESET "\n",
                 profiling_get_time(),
                 __func__, __LINE__);
-    systray.area.resize_needed = TRUE;
-    panel->area.resize_needed = TRUE;
+    schedule_resize(&systray.area);
+    schedule_resize(&panel->area);
     schedule_redraw(&systray.area);
     refresh_systray = TRUE;
     return TRUE;
@@ -886,6 +893,8 @@ void remove_icon(TrayWindow *traywin, bool destroyed)
 
     // remove from our list
     systray.list_icons = g_slist_remove(systray.list_icons, traywin);
+    g_hash_table_remove(icons_by_window, GSIZE_TO_POINTER(traywin->win));
+    g_hash_table_remove(icons_by_window, GSIZE_TO_POINTER(traywin->parent));
     fprintf(stderr, YELLOW "tint2: remove_icon: %lu (%s)" RESET "\n", traywin->win, traywin->name);
 
     if (! destroyed)
@@ -923,8 +932,8 @@ void remove_icon(TrayWindow *traywin, bool destroyed)
                 BLUE "[%f] %s:%d trigger resize & redraw" RESET "\n",
                 profiling_get_time(),
                 __func__, __LINE__);
-    systray.area.resize_needed = TRUE;
-    panel->area.resize_needed = TRUE;
+    schedule_resize(&systray.area);
+    schedule_resize(&panel->area);
     schedule_redraw(&systray.area);
     refresh_systray = TRUE;
 }
@@ -1423,11 +1432,5 @@ gboolean systray_on_monitor(int i_monitor, int n_panels)
 
 TrayWindow *systray_find_icon(Window win)
 {
-    for (GSList *l = systray.list_icons; l; l = l->next)
-    {
-        TrayWindow *traywin = l->data;
-        if (traywin->win == win || traywin->parent == win)
-            return traywin;
-    }
-    return NULL;
+    return icons_by_window ? g_hash_table_lookup(icons_by_window, GSIZE_TO_POINTER(win)) : NULL;
 }
@@ -31,6 +31,7 @@
 #include "server.h"
 #include "task.h"
 #include "taskbar.h"
+#include "test.h"
 #include "timer.h"
 #include "tooltip.h"
 #include "window.h"
@@ -46,7 +47,7 @@ void task_get_content_color(void *obj, Color *color);
 char *task_get_tooltip(void *obj)
 {
     Task *t = obj;
-    return strdup(t->title);
+    return strdup(t->model->title);
 }
 
 cairo_surface_t *task_get_thumbnail(void *obj)
@@ -54,10 +55,42 @@ cairo_surface_t *task_get_thumbnail(void *obj)
     if (!panel_config.g_task.thumbnail_enabled)
         return NULL;
     Task *t = obj;
-    if (!t->thumbnail)
+    if (!t->model->thumbnail)
         task_refresh_thumbnail(t);
     taskbar_start_thumbnail_timer(THUMB_MODE_TOOLTIP_WINDOW);
-    return t->thumbnail;
+    return t->model->thumbnail;
+}
+
+static Task *add_task_button(const Task *task_template, Taskbar *taskbar)
+// Creates the button of a window on a taskbar. It shares the model of the template with the other buttons.
+{
+    Panel *panel = taskbar->area.panel;
+    Task *task_instance = calloc(1, sizeof(Task));
+    memcpy(&task_instance->area, &panel->g_task.area, sizeof(Area));
+    task_instance->area.has_mouse_over_effect = panel_config.mouse_effects;
+    task_instance->area.has_mouse_press_effect = panel_config.mouse_effects;
+    task_instance->area._dump_geometry = task_dump_geometry;
+    task_instance->area._is_under_mouse = full_width_area_is_under_mouse;
+    task_instance->area._get_desired_size = task_get_desired_size;
+    task_instance->area._get_content_color = task_get_content_color;
+    task_instance->model = task_template->model;
+    task_instance->win = task_template->win;
+    task_instance->desktop = task_template->desktop;
+    task_instance->win_x = task_template->win_x;
+    task_instance->win_y = task_template->win_y;
+    task_instance->win_w = task_template->win_w;
+    task_instance->win_h = task_template->win_h;
+    task_instance->current_state = TASK_UNDEFINED; // to update the current state later in set_task_state...
+    if (task_instance->desktop == ALL_DESKTOPS && server.desktop != taskbar->desktop)
+        task_instance->area.on_screen = always_show_all_desktop_tasks;
+
+    if (panel->g_task.tooltip_enabled) {
+        task_instance->area._get_tooltip_text = task_get_tooltip;
+        task_instance->area._get_tooltip_image = task_get_thumbnail;
+    }
+
+    add_area(&task_instance->area, &taskbar->area);
+    return task_instance;
 }
 
 Task *add_task(Window win)
@@ -86,15 +119,14 @@ Task *add_task(Window win)
     task_template.area._get_content_color = task_get_content_color;
     task_template.win = win;
     task_template.desktop = get_window_desktop(win);
-    task_template.area.panel = &panels[monitor];
+    task_template.area.panel = panels[monitor];
     task_template.current_state = window_is_iconified(win) ? TASK_ICONIFIED : TASK_NORMAL;
     get_window_coordinates(win, &task_template.win_x, &task_template.win_y, &task_template.win_w, &task_template.win_h);
 
-    // allocate only one title and one icon
+    // load the title and the icon only once
     // even with task_on_all_desktop and with task_on_all_panel
-    task_template.title = NULL;
-    for (int k = 0; k < TASK_STATE_COUNT; ++k)
-        task_template.icon[k] = NULL;
+    TaskModel *model = calloc(1, sizeof(TaskModel));
+    task_template.model = model;
 
     task_update_title(&task_template);
     task_update_icon(&task_template);
@@ -102,12 +134,12 @@ Task *add_task(Window win)
              strlen_const(task_template.area.name),
              "Task %d %s",
              (int)win,
-             task_template.title ? task_template.title : "null");
+             model->title ? model->title : "null");
 
     // get application name
     // use res_class property of WM_CLASS as res_name is easily overridable by user
     XClassHint *classhint = XAllocClassHint();
-    task_template.application = strdup( classhint && XGetClassHint(server.display, win, classhint)
+    model->application = strdup( classhint && XGetClassHint(server.display, win, classhint)
                                         ? classhint->res_class : "Untitled" );
     if (classhint)
     {
@@ -119,49 +151,12 @@ Task *add_task(Window win)
     }
 
     GPtrArray *task_buttons = g_ptr_array_new();
-    for (int j = 0; j < panels[monitor].num_desktops; j++)
+    for (int j = 0; j < panels[monitor]->num_desktops; j++)
     {
         if (task_template.desktop != ALL_DESKTOPS && task_template.desktop != j)
             continue;
 
-        Taskbar *taskbar = &panels[monitor].taskbar[j];
-        Task *task_instance = calloc(1, sizeof(Task));
-        memcpy(&task_instance->area, &panels[monitor].g_task.area, sizeof(Area));
-        task_instance->area.has_mouse_over_effect = panel_config.mouse_effects;
-        task_instance->area.has_mouse_press_effect = panel_config.mouse_effects;
-        task_instance->area._dump_geometry = task_dump_geometry;
-        task_instance->area._is_under_mouse = full_width_area_is_under_mouse;
-        task_instance->area._get_desired_size = task_get_desired_size;
-        task_instance->area._get_content_color = task_get_content_color;
-        task_instance->win = task_template.win;
-        task_instance->desktop = task_template.desktop;
-        task_instance->win_x = task_template.win_x;
-        task_instance->win_y = task_template.win_y;
-        task_instance->win_w = task_template.win_w;
-        task_instance->win_h = task_template.win_h;
-        task_instance->current_state = TASK_UNDEFINED; // to update the current state later in set_task_state...
-        if (task_instance->desktop == ALL_DESKTOPS && server.desktop != j)
-            task_instance->area.on_screen = always_show_all_desktop_tasks;
-
-        task_instance->title = task_template.title;
-        task_instance->application = task_template.application;
-        if (panels[monitor].g_task.tooltip_enabled) {
-            task_instance->area._get_tooltip_text = task_get_tooltip;
-            task_instance->area._get_tooltip_image = task_get_thumbnail;
-        }
-        task_instance->icon_color = task_template.icon_color;
-        task_instance->icon_color_hover = task_template.icon_color_hover;
-        task_instance->icon_color_press = task_template.icon_color_press;
-        for (int k = 0; k < TASK_STATE_COUNT; ++k)
-        {
-            task_instance->icon[k] = task_template.icon[k];
-            task_instance->icon_hover[k] = task_template.icon_hover[k];
-            task_instance->icon_press[k] = task_template.icon_press[k];
-        }
-        task_instance->icon_width = task_template.icon_width;
-        task_instance->icon_height = task_template.icon_height;
-
-        add_area(&task_instance->area, &taskbar->area);
+        Task *task_instance = add_task_button(&task_template, &panels[monitor]->taskbar[j]);
         g_ptr_array_add(task_buttons, task_instance);
     }
     Window *key = calloc(1, sizeof(Window));
@@ -174,7 +169,7 @@ Task *add_task(Window win)
 
     if (taskbar_mode == MULTI_DESKTOP) {
         Panel *panel = task_template.area.panel;
-        panel->area.resize_needed = TRUE;
+        schedule_resize(&panel->area);
     }
 
     if (window_is_urgent(win))
@@ -186,12 +181,9 @@ Task *add_task(Window win)
     return (Task *)g_ptr_array_index(task_buttons, 0);
 }
 
-void task_remove_icon(Task *task)
+static void task_remove_icon(TaskModel *model)
 {
-    if (!task)
-        return;
-
-    Imlib_Image *icon_lists[3] = { task->icon, task->icon_hover, task->icon_press };
+    Imlib_Image *icon_lists[3] = { model->icon, model->icon_hover, model->icon_press };
     for (int k = 0; k < TASK_STATE_COUNT; k++)
         for (int i = 0; i < ARRAY_SIZE(icon_lists); i++)
         {
@@ -210,20 +202,22 @@ void remove_task(Task *task)
 
     if (taskbar_mode == MULTI_DESKTOP) {
         Panel *panel = task->area.panel;
-        panel->area.resize_needed = TRUE;
+        schedule_resize(&panel->area);
     }
 
     Window win = task->win;
 
-    // free title, icon and application name just for the first task
+    // the model is shared by all the buttons of the window
     // even with task_on_all_desktop and with task_on_all_panel
-    if (task->title)
-        free(task->title);
-    if (task->thumbnail)
-        cairo_surface_destroy(task->thumbnail);
-    if (task->application)
-        free(task->application);
-    task_remove_icon(task);
+    TaskModel *model = task->model;
+    if (model->title)
+        free(model->title);
+    if (model->thumbnail)
+        cairo_surface_destroy(model->thumbnail);
+    if (model->application)
+        free(model->application);
+    task_remove_icon(model);
+    free(model);
 
     GPtrArray *task_buttons = g_hash_table_lookup(win_to_task, &win);
     for (int i = 0; i < task_buttons->len; ++i) {
@@ -246,6 +240,25 @@ void remove_task(Task *task)
         update_all_taskbars_visibility();
 }
 
+static gboolean task_set_title(Task *task, const char *title)
+// Sets the title in the model, shared by all the buttons of the window, and redraws them
+{
+    if (task->model->title) {
+        // check unecessary title change
+        if (strcmp( task->model->title, title) == 0)
+            return FALSE;
+        free( task->model->title);
+    }
+
+    task->model->title = strdup( title);
+
+    GPtrArray *task_buttons = get_task_buttons(task->win);
+    if (task_buttons)
+        for (int i = 0; i < task_buttons->len; ++i)
+            schedule_redraw(&((Task *)g_ptr_array_index(task_buttons, i))->area);
+    return TRUE;
+}
+
 gboolean task_update_title(Task *task)
 {
     Panel *panel = task->area.panel;
@@ -260,57 +273,30 @@ gboolean task_update_title(Task *task)
             name = get_property(task->win, server.atom [WM_NAME], XA_STRING, NULL);
     }
 
-    char *title = name && name[0] ? name : "Untitled";
-
-    if (task->title) {
-        // check unecessary title change
-        if (strcmp( task->title, title) == 0)
-        {
-            if (name)
-                XFree( name);
-            return FALSE;
-        }
-        free( task->title);
-    }
-
-    task->title = strdup( title);
+    gboolean changed = task_set_title(task, name && name[0] ? name : "Untitled");
     if (name)
         XFree( name);
-
-    GPtrArray *task_buttons = get_task_buttons(task->win);
-    if (task_buttons)
-        for (int i = 0; i < task_buttons->len; ++i)
-        {
-            Task *task2 = g_ptr_array_index(task_buttons, i);
-            task2->title = task->title;
-            schedule_redraw(&task2->area);
-        }
-    return TRUE;
+    return changed;
 }
 
-Imlib_Image task_get_icon(Window win, int icon_size)
+Imlib_Image task_get_icon(Window win, int icon_size, gboolean *from_net_wm_icon)
 {
     Imlib_Image img = NULL;
 
-    int len;
-    gulong *data = get_property(win, server.atom [_NET_WM_ICON], XA_CARDINAL, &len);
+    // get ARGB icon
+    int w, h;
+    gulong *data = get_window_icon(win, icon_size, &w, &h);
+    *from_net_wm_icon = data != NULL;
     if (data) {
-        if (len > 0) {
-            // get ARGB icon
-            int w, h;
-            gulong *tmp_data = get_best_icon(data, get_icon_count(data, len), len, &w, &h, icon_size);
-            if (tmp_data) {
-                int array_size = w * h;
-                // imlib needs the array in DATA32 type
-                if (( img = imlib_create_image( w, h) ))
-                {
-                    imlib_context_set_image( img);
-                    DATA32 *icon_data = imlib_image_get_data();
-                    for (int j = 0; j < array_size; ++j)
-                        icon_data[j] = tmp_data[j];
-                    imlib_image_put_back_data( icon_data);
-                }
-            }
+        int array_size = w * h;
+        // imlib needs the array in DATA32 type
+        if (( img = imlib_create_image( w, h) ))
+        {
+            imlib_context_set_image( img);
+            DATA32 *icon_data = imlib_image_get_data();
+            for (int j = 0; j < array_size; ++j)
+                icon_data[j] = data[j];
+            imlib_image_put_back_data( icon_data);
         }
         XFree(data);
     }
@@ -342,97 +328,108 @@ Imlib_Image task_get_icon(Window win, int icon_size)
     return img;
 }
 
-void task_set_icon_color(Task *task, Imlib_Image icon)
+void task_set_icon_color(TaskModel *model, Imlib_Image icon)
 {
-    get_image_mean_color(icon, &task->icon_color);
+    get_image_mean_color(icon, &model->icon_color);
     if (panel_config.mouse_effects)
     {
-        task->icon_color_hover = task->icon_color;
-        adjust_color(&task->icon_color_hover,
+        model->icon_color_hover = model->icon_color;
+        adjust_color(&model->icon_color_hover,
                      panel_config.mouse_over_alpha,
                      panel_config.mouse_over_saturation,
                      panel_config.mouse_over_brightness);
-        task->icon_color_press = task->icon_color;
-        adjust_color(&task->icon_color_press,
+        model->icon_color_press = model->icon_color;
+        adjust_color(&model->icon_color_press,
                      panel_config.mouse_pressed_alpha,
                      panel_config.mouse_pressed_saturation,
                      panel_config.mouse_pressed_brightness);
     }
 }
 
-void task_update_icon(Task *task)
+static guint64 icon_hash(Imlib_Image image)
+// FNV-1a, one step per 32-bit word, over the size and the pixels of the image
 {
-    Panel *panel = task->area.panel;
+    imlib_context_set_image(image);
+    int w = imlib_image_get_width();
+    int h = imlib_image_get_height();
+    const DATA32 *data = imlib_image_get_data_for_reading_only();
+    guint64 hash = 14695981039346656037ULL;
+    #define hash_value(v) (hash = (hash ^ (guint64)(v)) * 1099511628211ULL)
+    hash_value(w);
+    hash_value(h);
+    for (int i = 0; data && i < w * h; i++)
+        hash_value(data[i]);
+    #undef hash_value
+    return hash ? hash : 1;
+}
 
-    Imlib_Image img_src = task_get_icon( task->win, panel->g_task.icon_size1);
-    task_set_icon_color( task, img_src);
+gboolean task_update_icon(Task *task)
+{
+    Panel *panel = task->area.panel;
+    TaskModel *model = task->model;
+
+    Imlib_Image img_src = task_get_icon( task->win, panel->g_task.icon_size1, &model->icon_from_net_wm_icon);
+    guint64 hash = icon_hash(img_src);
+    if (hash == model->icon_hash) {
+        // Same pixels, the scaled and adjusted copies are still valid
+        imlib_context_set_image( img_src);
+        imlib_free_image();
+        return FALSE;
+    }
+    model->icon_hash = hash;
+    task_set_icon_color( model, img_src);
 
     if (!panel->g_task.has_icon) {
-        if (panel_config.g_task.has_content_tint)
-        {
-            imlib_context_set_image( img_src);
-            imlib_free_image();
-        }
-        return;
+        imlib_context_set_image( img_src);
+        imlib_free_image();
+        goto update_buttons;
     }
 
-    task_remove_icon(task);
+    task_remove_icon(model);
 
     // transform icons
-    task->icon_width = task->icon_height = panel->g_task.icon_size1;
+    model->icon_width = model->icon_height = panel->g_task.icon_size1;
     imlib_context_set_image( img_src);
     imlib_image_set_has_alpha(1);
     int w = imlib_image_get_width();
     int h = imlib_image_get_height();
-    Imlib_Image img_crop = imlib_create_cropped_scaled_image( 0, 0, w, h,   task->icon_width,
-                                                                            task->icon_height );
+    Imlib_Image img_crop = imlib_create_cropped_scaled_image( 0, 0, w, h,   model->icon_width,
+                                                                            model->icon_height );
     imlib_free_image();
 
     imlib_context_set_image( img_crop);
     for (int k = 0; k < TASK_STATE_COUNT; ++k)
     {
-        task->icon[k] = adjust_img( img_crop,
-                                    panel->g_task.alpha[k],
-                                    panel->g_task.saturation[k],
-                                    panel->g_task.brightness[k]);
+        model->icon[k] = adjust_img( img_crop,
+                                     panel->g_task.alpha[k],
+                                     panel->g_task.saturation[k],
+                                     panel->g_task.brightness[k]);
         if (panel_config.mouse_effects) {
-            task->icon_hover[k] = adjust_img( task->icon[k],
-                                              panel_config.mouse_over_alpha,
-                                              panel_config.mouse_over_saturation,
-                                              panel_config.mouse_over_brightness);
-            task->icon_press[k] = adjust_img( task->icon[k],
-                                              panel_config.mouse_pressed_alpha,
-                                              panel_config.mouse_pressed_saturation,
-                                              panel_config.mouse_pressed_brightness);
+            model->icon_hover[k] = adjust_img( model->icon[k],
+                                               panel_config.mouse_over_alpha,
+                                               panel_config.mouse_over_saturation,
+                                               panel_config.mouse_over_brightness);
+            model->icon_press[k] = adjust_img( model->icon[k],
+                                               panel_config.mouse_pressed_alpha,
+                                               panel_config.mouse_pressed_saturation,
+                                               panel_config.mouse_pressed_brightness);
         }
     }
     imlib_context_set_image( img_crop);
     imlib_free_image();
 
+update_buttons:;
     GPtrArray *task_buttons = get_task_buttons(task->win);
     if (task_buttons)
         for (int i = 0; i < task_buttons->len; ++i)
-        {
-            Task *task2 = (Task *)g_ptr_array_index(task_buttons, i);
-            task2->icon_width = task->icon_width;
-            task2->icon_height = task->icon_height;
-            task2->icon_color = task->icon_color;
-            task2->icon_color_hover = task->icon_color_hover;
-            task2->icon_color_press = task->icon_color_press;
-            for (int k = 0; k < TASK_STATE_COUNT; ++k)
-            {
-                task2->icon[k] = task->icon[k];
-                task2->icon_hover[k] = task->icon_hover[k];
-                task2->icon_press[k] = task->icon_press[k];
-            }
-            schedule_redraw(&task2->area);
-        }
+            schedule_redraw(&((Task *)g_ptr_array_index(task_buttons, i))->area);
+    return TRUE;
 }
 
 // TODO icons look too large when the panel is large
 void draw_task_icon(Task *task, int text_width)
 {
-    if (!task->icon[task->current_state])
+    if (!task->model->icon[task->current_state])
         return;
 
     // Find pos
@@ -454,13 +451,13 @@ void draw_task_icon(Task *task, int text_width)
     if (panel_config.mouse_effects)
         goto nofx;
     switch (task->area.mouse_state) {
-    case MOUSE_OVER:    image = task->icon_hover[task->current_state];
+    case MOUSE_OVER:    image = task->model->icon_hover[task->current_state];
                         break;
-    case MOUSE_DOWN:    image = task->icon_press[task->current_state];
+    case MOUSE_DOWN:    image = task->model->icon_press[task->current_state];
                         break;
     default:
     nofx:
-        image = task->icon[task->current_state];
+        image = task->model->icon[task->current_state];
     }
 
     task->_icon_y = (task->area.height - panel->g_task.icon_size1) / 2;
@@ -483,7 +480,7 @@ void draw_task(void *obj, cairo_t *c)
         pango_cairo_context_set_resolution(context, 96 * panel->scale);
         layout = pango_layout_new(context);
         pango_layout_set_font_description(layout, panel->g_task.font_desc);
-        pango_layout_set_text(layout, task->title, -1);
+        pango_layout_set_text(layout, task->model->title, -1);
 
         pango_layout_set_width(layout, (TINT2_PANGO_SLACK + ((Taskbar *)task->area.parent)->text_width) * PANGO_SCALE);
         pango_layout_set_height(layout, panel->g_task.text_height * PANGO_SCALE);
@@ -524,7 +521,7 @@ void task_dump_geometry(void *obj, int indent)
             task->_text_width,
             task->_text_height,
             panel->g_task.centered ? "center" : "left",
-            task->title);
+            task->model->title);
     fprintf(stderr,
             "tint2: %*sIcon: x = %d, y = %d, w = h = %d\n",
             indent,
@@ -541,13 +538,13 @@ void task_get_content_color(void *obj, Color *color)
     if (!panel_config.mouse_effects)
         goto nofx;
     switch (task->area.mouse_state) {
-    case MOUSE_OVER:    content_color = &task->icon_color_hover;
+    case MOUSE_OVER:    content_color = &task->model->icon_color_hover;
                         break;
-    case MOUSE_DOWN:    content_color = &task->icon_color_press;
+    case MOUSE_DOWN:    content_color = &task->model->icon_color_press;
                         break;
     default:
     nofx:
-        content_color = &task->icon_color;
+        content_color = &task->model->icon_color;
     }
     if (content_color)
         *color = *content_color;
@@ -588,9 +585,8 @@ Task *find_active_task(Task *current_task)
         return current_task;
 
     Taskbar *taskbar = current_task->area.parent;
-    for_taskbar_tasks( taskbar, l)
+    for_taskbar_tasks( taskbar, task)
     {
-        Task *task = l->data;
         if (task->win == active_task->win)
             return task;
     }
@@ -604,18 +600,11 @@ Task *next_task(Task *task)
         return NULL;
 
     Taskbar *taskbar = task->area.parent;
-
-    GList *lfirst_task = taskbarname_enabled ? taskbar->area.children->next : taskbar->area.children;
-    for (GList *l = lfirst_task; l; l = l->next)
-    {
-        Task *task1 = l->data;
-        if (task1 == task) {
-            l = l->next ? l->next : lfirst_task;
-            return l->data;
-        }
-    }
-
-    return NULL;
+    int first = taskbar_first_task_index(taskbar);
+    int i = area_child_position(&taskbar->area, &task->area);
+    if (i < first)
+        return NULL;
+    return (Task *)area_child(&taskbar->area, i + 1 < area_num_children(&taskbar->area) ? i + 1 : first);
 }
 
 Task *prev_task(Task *task)
@@ -624,23 +613,11 @@ Task *prev_task(Task *task)
         return NULL;
 
     Taskbar *taskbar = task->area.parent;
-
-    Task *task2 = NULL;
-    GList *lfirst_task = taskbarname_enabled ? taskbar->area.children->next : taskbar->area.children;
-    for (GList *l = lfirst_task; l; l = l->next)
-    {
-        Task *task1 = l->data;
-        if (task1 == task) {
-            if (l == lfirst_task) {
-                l = g_list_last(l);
-                task2 = l->data;
-            }
-            return task2;
-        }
-        task2 = task1;
-    }
-
-    return NULL;
+    int first = taskbar_first_task_index(taskbar);
+    int i = area_child_position(&taskbar->area, &task->area);
+    if (i < first)
+        return NULL;
+    return (Task *)area_child(&taskbar->area, i > first ? i - 1 : area_num_children(&taskbar->area) - 1);
 }
 
 void reset_active_task()
@@ -670,26 +647,30 @@ void task_refresh_thumbnail(Task *task)
 
     Panel *panel = task->area.panel;
     double now = get_time();
-    if (now - task->thumbnail_last_update < 0.1)
+    if (now - task->model->thumbnail_last_update < 0.1)
         return;
 
     if (debug_thumbnails)
-        fprintf(stderr, "tint2: thumbnail for window: %s" RESET "\n", task->title ? task->title : "");
+        fprintf(stderr, "tint2: thumbnail for window: %s" RESET "\n", task->model->title ? task->model->title : "");
     cairo_surface_t *thumbnail = get_window_thumbnail(task->win, panel_config.g_task.thumbnail_width * panel->scale);
     if (!thumbnail)
         return;
 
-    if (task->thumbnail)
-        cairo_surface_destroy(task->thumbnail);
-    task->thumbnail = thumbnail;
-    task->thumbnail_last_update = now;
+    if (task->model->thumbnail)
+        cairo_surface_destroy(task->model->thumbnail);
+    task->model->thumbnail = thumbnail;
+    task->model->thumbnail_last_update = now;
     if (debug_thumbnails)
         fprintf(stderr,
                 YELLOW "tint2: %s took %f ms (window: %s)" RESET "\n",
                 __func__,
-                1000 * (task->thumbnail_last_update - now),
-                task->title ? task->title : "");
-    tooltip_update_for_area (&task->area);
+                1000 * (task->model->thumbnail_last_update - now),
+                task->model->title ? task->model->title : "");
+    // The thumbnail is shared, the tooltip may be showing for any button of the window
+    GPtrArray *task_buttons = get_task_buttons(task->win);
+    if (task_buttons)
+        for (int i = 0; i < task_buttons->len; ++i)
+            tooltip_update_for_area (&((Task *)g_ptr_array_index(task_buttons, i))->area);
 }
 
 void set_task_state(Task *task, TaskState state)
@@ -699,7 +680,7 @@ void set_task_state(Task *task, TaskState state)
 
     GPtrArray *task_buttons = NULL;
 
-    if (!task->thumbnail)
+    if (!task->model->thumbnail)
         task_refresh_thumbnail(task);
     if (state == TASK_ACTIVE)
     {
@@ -708,7 +689,7 @@ void set_task_state(Task *task, TaskState state)
         taskbar_start_thumbnail_timer(THUMB_MODE_ACTIVE_WINDOW);
         if (task->current_state != state)
         {
-            clock_gettime(CLOCK_MONOTONIC, &task->last_activation_time);
+            clock_gettime(CLOCK_MONOTONIC, &task->model->last_activation_time);
             if (taskbar_sort_method == TASKBAR_SORT_LRU || taskbar_sort_method == TASKBAR_SORT_MRU)
             {
                 task_buttons = get_task_buttons(task->win);
@@ -732,31 +713,33 @@ void set_task_state(Task *task, TaskState state)
             {
                 Task *task1 = g_ptr_array_index(task_buttons, i);
                 task1->current_state = state;
-                task1->area.bg = panels[0].g_task.background[state];
+                task1->area.bg = panels[0]->g_task.background[state];
                 area_gradients_reset( & task1->area);
                 schedule_redraw(&task1->area);
                 if (state == TASK_ACTIVE && g_slist_find(urgent_list, task1))
                     del_urgent(task1);
-                gboolean hide = FALSE;
+                gboolean hidden = FALSE;
                 Taskbar *taskbar = task1->area.parent;
                 if (task->desktop == ALL_DESKTOPS && server.desktop != taskbar->desktop)
                     // Hide ALL_DESKTOPS task on non-current desktop
-                    hide = !always_show_all_desktop_tasks;
+                    hidden = !always_show_all_desktop_tasks;
 
                 if ((hide_inactive_tasks    && state != TASK_ACTIVE)               ||
                     (hide_task_diff_desktop && taskbar->desktop != server.desktop) ||
                     ((hide_task_diff_monitor || num_panels > 1) &&
                      get_window_monitor(task->win) != ((Panel *)task->area.panel)->monitor) )
 
-                    hide = TRUE;
-                
-                if (hide == task1->area.on_screen) {
-                    task1->area.on_screen = !hide;
+                    hidden = TRUE;
+
+                if (hidden == task1->area.on_screen) {
+                    // The taskbar holding the button relayouts its children, not taskbar 0 of the panel
+                    if (hidden)
+                        hide(&task1->area);
+                    else
+                        show(&task1->area);
                     schedule_redraw(&task1->area);
-                    Panel *p = task->area.panel;
-                    task->area.resize_needed = TRUE;
-                    p->taskbar->area.resize_needed = TRUE;
-                    p->area.resize_needed = TRUE;
+                    schedule_resize(&taskbar->area);
+                    schedule_resize(&((Panel *)taskbar->area.panel)->area);
                 }
             }
             schedule_panel_redraw();
@@ -770,8 +753,8 @@ void blink_urgent(void *arg)
          urgent_task; urgent_task = urgent_task->next)
     {
         Task *t = urgent_task->data;
-        if (t->urgent_tick <= max_tick_urgent)
-            set_task_state(t,   ++t->urgent_tick % 2        ? TASK_URGENT
+        if (t->model->urgent_tick <= max_tick_urgent)
+            set_task_state(t,   ++t->model->urgent_tick % 2        ? TASK_URGENT
                             :   window_is_iconified(t->win) ? TASK_ICONIFIED : TASK_NORMAL);
     }
     schedule_panel_redraw();
@@ -787,7 +770,7 @@ void add_urgent(Task *task)
         return;
 
     task = get_task(task->win); // always add the first task for the task buttons (omnipresent windows)
-    task->urgent_tick = 0;
+    task->model->urgent_tick = 0;
     if (g_slist_find(urgent_list, task))
         return;
 
@@ -871,3 +854,60 @@ void task_update_desktop(Task *task)
     reset_active_task();
     schedule_panel_redraw();
 }
+
+TEST(task_buttons_share_model)
+{
+    // A window on all desktops has a button on the taskbar of each desktop
+    Panel panel;
+    memset(&panel, 0, sizeof(panel));
+    Taskbar taskbars[2];
+    memset(taskbars, 0, sizeof(taskbars));
+    panel.taskbar = taskbars;
+    panel.num_desktops = 2;
+    panel.g_task.tooltip_enabled = TRUE;
+    for (int i = 0; i < 2; i++) {
+        taskbars[i].desktop = i;
+        taskbars[i].area.panel = &panel;
+    }
+    Task task_template;
+    memset(&task_template, 0, sizeof(task_template));
+    task_template.win = 0x2a;
+    task_template.desktop = ALL_DESKTOPS;
+    task_template.model = calloc(1, sizeof(TaskModel));
+
+    gboolean enabled = taskbar_enabled;
+    taskbar_enabled = TRUE;
+    win_to_task = g_hash_table_new(win_hash, win_compare);
+    GPtrArray *task_buttons = g_ptr_array_new();
+    for (int i = 0; i < 2; i++)
+        g_ptr_array_add(task_buttons, add_task_button(&task_template, &taskbars[i]));
+    g_hash_table_insert(win_to_task, &task_template.win, task_buttons);
+    Task *buttons[2] = { g_ptr_array_index(task_buttons, 0), g_ptr_array_index(task_buttons, 1) };
+
+    ASSERT(buttons[0] != buttons[1]);
+    ASSERT(buttons[0]->model == task_template.model);
+    ASSERT(buttons[1]->model == task_template.model);
+
+    // A title change through one button shows on both, and redraws both
+    ASSERT_TRUE(task_set_title(buttons[0], "Old title"));
+    buttons[0]->area._redraw_needed = buttons[1]->area._redraw_needed = FALSE;
+    ASSERT_TRUE(task_set_title(buttons[1], "New title"));
+    ASSERT_FALSE(task_set_title(buttons[0], "New title"));
+    for (int i = 0; i < 2; i++) {
+        ASSERT_TRUE(buttons[i]->area._redraw_needed);
+        char *tooltip = buttons[i]->area._get_tooltip_text(buttons[i]);
+        ASSERT_STR_EQUAL(tooltip, "New title");
+        free(tooltip);
+    }
+
+    g_hash_table_destroy(win_to_task);
+    win_to_task = NULL;
+    taskbar_enabled = enabled;
+    for (int i = 0; i < 2; i++) {
+        g_ptr_array_free(taskbars[i].area.children, TRUE);
+        free(buttons[i]);
+    }
+    g_ptr_array_free(task_buttons, TRUE);
+    free(task_template.model->title);
+    free(task_template.model);
+}
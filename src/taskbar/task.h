@@ -53,15 +53,11 @@ typedef struct GlobalTask {
     int thumbnail_width;
 } GlobalTask;
 
-typedef struct Task
-// Stores information about a task.
-// Warning: any dynamically allocated members are shared between the Task instances created for the same window
-// (if the task appears on all desktops, there will be a different instance on each desktop's taskbar).
+typedef struct TaskModel
+// Stores the information about a window that does not depend on where it is shown.
+// It is loaded once per window and shared by all the Task buttons of the window
+// (if the task appears on all desktops, there is a different button on each desktop's taskbar).
 {
-    Area area;
-    Window win;
-    int desktop;
-    TaskState current_state;
     Imlib_Image icon[TASK_STATE_COUNT];
     Imlib_Image icon_hover[TASK_STATE_COUNT];
     Imlib_Image icon_press[TASK_STATE_COUNT];
@@ -70,23 +66,36 @@ typedef struct Task
     Color icon_color;
     Color icon_color_hover;
     Color icon_color_press;
+    guint64 icon_hash;              // Hash of the source icon the icons above were made from
+    gboolean icon_from_net_wm_icon; // Otherwise the icon comes from WM_HINTS or is the default one
     char *title;
     char *application;
     int urgent_tick;
+    struct timespec last_activation_time;
+    cairo_surface_t *thumbnail;
+    double thumbnail_last_update;
+} TaskModel;
+
+typedef struct Task
+// Stores information about a task button.
+// The buttons of the same window share the model; win, desktop and current_state are kept equal on all of them.
+{
+    Area area;
+    TaskModel *model;
+    Window win;
+    int desktop;
+    TaskState current_state;
 
     // These may not be up-to-date
     int win_x;
     int win_y;
     int win_w;
     int win_h;
-    struct timespec last_activation_time;
     int _text_width;
     int _text_height;
     double _text_posy;
     int _icon_x;
     int _icon_y;
-    cairo_surface_t *thumbnail;
-    double thumbnail_last_update;
 } Task;
 
 extern Timer urgent_timer;
@@ -98,7 +107,8 @@ void remove_task(Task *task);
 void draw_task(void *obj, cairo_t *c);
 void on_change_task(void *obj);
 
-void task_update_icon(Task *task);
+gboolean task_update_icon(Task *task);
+// Reloads the icon of the window. Returns FALSE if the icon did not change.
 void task_update_desktop(Task *task);
 gboolean task_update_title(Task *task);
 void reset_active_task();
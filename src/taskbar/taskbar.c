@@ -26,6 +26,7 @@
 #include <glib.h>
 #include <Imlib2.h>
 
+#include "arena.h"
 #include "task.h"
 #include "taskbar.h"
 #include "server.h"
@@ -33,6 +34,7 @@
 #include "panel.h"
 #include "strnatcmp.h"
 #include "tooltip.h"
+#include "test.h"
 
 GHashTable *win_to_task;
 
@@ -116,20 +118,20 @@ void taskbar_save_orderings()
     GList   *tbto_tail = NULL;
     for (int i = 0; i < num_panels; i++)
     {
-        Panel *panel = &panels[i];
+        Panel *panel = panels[i];
         for (int j = 0; j < panel->num_desktops; j++)
         {
             Taskbar *taskbar = &panel->taskbar[j];
             GList   *task_order = NULL,
                     *to_tail = NULL;
-            for_taskbar_tasks( taskbar, c)
+            for_taskbar_tasks( taskbar, task)
             {
                 if (sizeof(Window) > sizeof(gpointer)) {
                     Window *window = calloc( 1, sizeof(Window));
-                    *window = ((Task *)c->data)->win;
+                    *window = task->win;
                     g_list_append_tail( task_order, to_tail, window );
                 } else
-                    g_list_append_tail( task_order, to_tail, (gpointer)((Task *)c->data)->win );
+                    g_list_append_tail( task_order, to_tail, (gpointer)task->win );
             }
             g_list_append_tail( taskbar_task_orderings, tbto_tail, task_order);
         }
@@ -158,7 +160,7 @@ void cleanup_taskbar()
     cleanup_taskbarname();
     for (int i = 0; i < num_panels; i++)
     {
-        Panel *panel = &panels[i];
+        Panel *panel = panels[i];
         for (int j = 0; j < panel->num_desktops; j++)
         {
             Taskbar *taskbar = &panel->taskbar[j];
@@ -247,6 +249,7 @@ void init_taskbar_panel(void *p)
     panel->g_taskbar.area_name._draw_foreground     = draw_taskbarname;
     panel->g_taskbar.area_name._on_change_layout    = 0;
     panel->g_taskbar.area_name.resize_needed        = TRUE;
+    panel->g_taskbar.area_name._subtree_dirty       = TRUE;
     panel->g_taskbar.area_name.on_screen            = TRUE;
 
     // taskbar
@@ -259,6 +262,7 @@ void init_taskbar_panel(void *p)
     panel->g_taskbar.area._get_desired_size     = taskbar_get_desired_size;
     panel->g_taskbar.area._is_under_mouse       = full_width_area_is_under_mouse;
     panel->g_taskbar.area.resize_needed         = TRUE;
+    panel->g_taskbar.area._subtree_dirty        = TRUE;
     panel->g_taskbar.area.on_screen             = TRUE;
     if (panel_horizontal)
     {
@@ -288,6 +292,7 @@ void init_taskbar_panel(void *p)
     panel->g_task.area._draw_foreground     = draw_task;
     panel->g_task.area._on_change_layout    = on_change_task;
     panel->g_task.area.resize_needed        = TRUE;
+    panel->g_task.area._subtree_dirty       = TRUE;
     panel->g_task.area.on_screen            = TRUE;
     if ((panel->g_task.config_asb_mask & (1 << TASK_NORMAL)) == 0)
     {
@@ -410,11 +415,11 @@ void taskbar_start_thumbnail_timer(ThumbnailUpdateMode mode)
 void taskbar_init_fonts()
 {
     for (int i = 0; i < num_panels; i++)
-        if (!panels[i].g_task.font_desc)
+        if (!panels[i]->g_task.font_desc)
         {
-            panels[i].g_task.font_desc = pango_font_description_from_string(get_default_font());
-            pango_font_description_set_size(panels[i].g_task.font_desc,
-                                            pango_font_description_get_size(panels[i].g_task.font_desc) - PANGO_SCALE);
+            panels[i]->g_task.font_desc = pango_font_description_from_string(get_default_font());
+            pango_font_description_set_size(panels[i]->g_task.font_desc,
+                                            pango_font_description_get_size(panels[i]->g_task.font_desc) - PANGO_SCALE);
         }
 }
 
@@ -425,23 +430,22 @@ void taskbar_default_font_changed()
 
     gboolean needs_update = FALSE;
     for (int i = 0; i < num_panels; i++)
-        if (!panels[i].g_task.has_font)
+        if (!panels[i]->g_task.has_font)
         {
-            pango_font_description_free(panels[i].g_task.font_desc);
-            panels[i].g_task.font_desc = NULL;
+            pango_font_description_free(panels[i]->g_task.font_desc);
+            panels[i]->g_task.font_desc = NULL;
             needs_update = TRUE;
         }
     if (!needs_update)
         return;
     taskbar_init_fonts();
     for (int i = 0; i < num_panels; i++)
-        for (int j = 0; j < panels[i].num_desktops; j++)
+        for (int j = 0; j < panels[i]->num_desktops; j++)
         {
-            Taskbar *taskbar = &panels[i].taskbar[j];
-            for (GList *c = taskbar->area.children; c; c = c->next) {
-                Task *t = c->data;
-                t->area.resize_needed = TRUE;
-                schedule_redraw(&t->area);
+            Taskbar *taskbar = &panels[i]->taskbar[j];
+            for_children(&taskbar->area, child) {
+                schedule_resize(child);
+                schedule_redraw(child);
             }
         }
     schedule_panel_redraw();
@@ -491,25 +495,19 @@ int compare_windows(const void *a, const void *b)
 
 void sort_win_list(Window *windows, int count)
 {
-    Window *result = malloc( count * sizeof(Window));
+    ArenaMark mark = arena_mark(&frame_arena);
+    Window *result = arena_alloc(&frame_arena, count * sizeof(Window));
     memcpy( result, windows, count * sizeof(Window));
     qsort( windows, count, sizeof(Window), compare_windows);
 
     memcpy(windows, result, count * sizeof(Window));
-    free(result);
+    arena_rewind(&frame_arena, mark);
 }
 
-void taskbar_refresh_tasklist()
+static void taskbar_update_tasklist(Window *win, int num_results)
+// Removes the tasks of the windows missing from the client list win, and adds the new ones
 {
-    if (!taskbar_enabled)
-        return;
-
-    int num_results;
-    Window *win = get_property(server.root_win, server.atom [_NET_CLIENT_LIST], XA_WINDOW, &num_results);
-    if (!win)
-        return;
-
-    Window *sorted = calloc(num_results, sizeof(Window));
+    Window *sorted = arena_alloc(&frame_arena, num_results * sizeof(Window));
     memcpy(sorted, win, num_results * sizeof(Window));
     if (taskbar_task_orderings)
     {
@@ -517,26 +515,42 @@ void taskbar_refresh_tasklist()
         taskbar_clear_orderings();
     }
 
-    GList *win_list = g_hash_table_get_keys(win_to_task);
-    for (GList *it = win_list, *p;
-         it;
-         it = (p = it)->next, g_list_free_1( p))
+    // Copy the known windows, removing tasks modifies the table
+    int num_tasks = g_hash_table_size(win_to_task);
+    Window *tasks = arena_alloc(&frame_arena, num_tasks * sizeof(Window));
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, win_to_task);
+    for (int k = 0; g_hash_table_iter_next(&iter, &key, NULL); k++)
+        tasks[k] = *(Window *)key;
+    for (int k = 0; k < num_tasks; k++)
     {
         int i;
         for (i = 0; i < num_results; i++)
-            if (*(Window *)it->data == sorted[i])
+            if (tasks[k] == sorted[i])
                 break;
         if (i == num_results)
-            taskbar_remove_task(it->data);
+            taskbar_remove_task(&tasks[k]);
     }
 
     // Add any new
     for (int i = 0; i < num_results; i++)
         if (!get_task(sorted[i]))
             add_task(sorted[i]);
+}
+
+void taskbar_refresh_tasklist()
+{
+    if (!taskbar_enabled)
+        return;
 
+    int num_results;
+    Window *win = get_property(server.root_win, server.atom [_NET_CLIENT_LIST], XA_WINDOW, &num_results);
+    if (!win)
+        return;
+
+    taskbar_update_tasklist(win, num_results);
     XFree(win);
-    free(sorted);
 }
 
 int taskbar_get_desired_size(void *obj)
@@ -567,10 +581,10 @@ gboolean resize_taskbar(void *obj)
         relayout_with_constraint(&taskbar->area, panel->g_task.maximum_width * panel->scale);
 
         int text_width = panel->g_task.maximum_width * panel->scale;
-        for_taskbar_tasks( taskbar, l)
-            if (((Task *)l->data)->area.on_screen)
+        for_taskbar_tasks( taskbar, task)
+            if (task->area.on_screen)
             {
-                text_width = ((Task *)l->data)->area.width;
+                text_width = task->area.width;
                 break;
             }
         taskbar->text_width = text_width - panel->g_task.text_posx - right_border_width(&panel->g_task.area)
@@ -589,8 +603,8 @@ gboolean resize_taskbar(void *obj)
 
 gboolean taskbar_is_empty(Taskbar *taskbar)
 {
-    for_taskbar_tasks( taskbar, l)
-        if (((Task *)l->data)->area.on_screen)
+    for_taskbar_tasks( taskbar, task)
+        if (task->area.on_screen)
             return FALSE;
     return TRUE;
 }
@@ -607,7 +621,7 @@ void update_taskbar_visibility(Taskbar *taskbar)
 void update_all_taskbars_visibility()
 {
     for (int i = 0; i < num_panels; i++) {
-        Panel *panel = &panels[i];
+        Panel *panel = panels[i];
 
         for (int j = 0; j < panel->num_desktops; j++)
             update_taskbar_visibility(&panel->taskbar[j]);
@@ -619,32 +633,28 @@ void set_taskbar_state(Taskbar *taskbar, TaskbarState state)
     update_taskbar_visibility(taskbar);
     if (taskbarname_enabled)
     {
-        taskbar->bar_name.area.bg = panels[0].g_taskbar.background_name[state];
+        taskbar->bar_name.area.bg = panels[0]->g_taskbar.background_name[state];
         area_gradients_reset( & taskbar->bar_name.area);
 
         if (taskbar->area.on_screen)
             schedule_redraw( & taskbar->bar_name.area);
     }
-    taskbar->area.bg = panels[0].g_taskbar.background[state];
+    taskbar->area.bg = panels[0]->g_taskbar.background[state];
     area_gradients_reset( & taskbar->area);
     if (taskbar->area.on_screen)
     {
         schedule_redraw( & taskbar->area);
         if (taskbar_mode == MULTI_DESKTOP) {
-            GList *lfirst = taskbarname_enabled ? taskbar->area.children->next : taskbar->area.children;
-
-            Background **bg = panels[0].g_taskbar.background;
+            Background **bg = panels[0]->g_taskbar.background;
             if (bg[TASKBAR_NORMAL] != bg[TASKBAR_ACTIVE])
             {
-                for (GList *l = lfirst; l; l = l->next)
-                    schedule_redraw(l->data);
+                for_taskbar_tasks( taskbar, task)
+                    schedule_redraw(&task->area);
             }
             if (hide_task_diff_desktop)
             {
-                for (GList *l = lfirst; l; l = l->next) {
-                    Task *task = l->data;
+                for_taskbar_tasks( taskbar, task)
                     set_task_state(task, task->current_state);
-                }
             }
         }
     }
@@ -656,8 +666,8 @@ gint compare_tasks_trivial(Task *a, Task *b, Taskbar *taskbar)
 {
     return  a == b ? 0
         :   !taskbarname_enabled ? NONTRIVIAL
-        :   a == taskbar->area.children->data ? -1
-        :   b == taskbar->area.children->data ? 1
+        :   &a->area == area_child(&taskbar->area, 0) ? -1
+        :   &b->area == area_child(&taskbar->area, 0) ? 1
         :   NONTRIVIAL;
 }
 
@@ -696,16 +706,16 @@ gint compare_task_titles(Task *a, Task *b, Taskbar *taskbar)
 {
     int trivial = compare_tasks_trivial(a, b, taskbar);
     return  trivial != NONTRIVIAL ? trivial
-        :   strnatcasecmp(  a->title ? a->title : "",
-                            b->title ? b->title : "");
+        :   strnatcasecmp(  a->model->title ? a->model->title : "",
+                            b->model->title ? b->model->title : "");
 }
 
 gint compare_task_applications(Task *a, Task *b, Taskbar *taskbar)
 {
     int trivial = compare_tasks_trivial(a, b, taskbar);
     return  trivial != NONTRIVIAL ? trivial 
-        :   strnatcasecmp(  a->application ? a->application : "",
-                            b->application ? b->application : "");
+        :   strnatcasecmp(  a->model->application ? a->model->application : "",
+                            b->model->application ? b->model->application : "");
 }
 
 gint compare_tasks(Task *a, Task *b, Taskbar *taskbar)
@@ -719,8 +729,8 @@ gint compare_tasks(Task *a, Task *b, Taskbar *taskbar)
     case TASKBAR_SORT_CENTER:       return compare_task_centers(a, b, taskbar);
     case TASKBAR_SORT_TITLE:        return compare_task_titles(a, b, taskbar);
     case TASKBAR_SORT_APPLICATION:  return compare_task_applications(a, b, taskbar);
-    case TASKBAR_SORT_LRU:          return compare_timespecs(&a->last_activation_time, &b->last_activation_time);
-    case TASKBAR_SORT_MRU:          return -compare_timespecs(&a->last_activation_time, &b->last_activation_time);
+    case TASKBAR_SORT_LRU:          return compare_timespecs(&a->model->last_activation_time, &b->model->last_activation_time);
+    case TASKBAR_SORT_MRU:          return -compare_timespecs(&a->model->last_activation_time, &b->model->last_activation_time);
     }
     return 0;
 }
@@ -728,11 +738,9 @@ gint compare_tasks(Task *a, Task *b, Taskbar *taskbar)
 gboolean taskbar_needs_sort(Taskbar *taskbar)
 {
     if (taskbar_sort_method != TASKBAR_NOSORT)
-        for (GList *i = taskbar->area.children, *j = i ? i->next : NULL;
-            i && j;
-            i = i->next, j = j->next)
+        for (int i = 1; i < area_num_children(&taskbar->area); i++)
         {
-            if (compare_tasks(i->data, j->data, taskbar) > 0)
+            if (compare_tasks((Task *)area_child(&taskbar->area, i - 1), (Task *)area_child(&taskbar->area, i), taskbar) > 0)
                 return TRUE;
         }
     return FALSE;
@@ -743,7 +751,7 @@ void sort_tasks(Taskbar *taskbar)
     if (!taskbar || !taskbar_needs_sort(taskbar))
         return;
 
-    taskbar->area.children = g_list_sort_with_data(taskbar->area.children, (GCompareDataFunc)compare_tasks, taskbar);
+    sort_child_areas(&taskbar->area, 0, (GCompareDataFunc)compare_tasks, taskbar);
     schedule_panel_redraw();
 }
 
@@ -779,9 +787,7 @@ void update_minimized_icon_positions(void *p)
 
         if (!taskbar->area.on_screen)
             continue;
-        for (GList *c = taskbar->area.children; c; c = c->next) {
-            Area *area = c->data;
-
+        for_children(&taskbar->area, area) {
             if (area->_on_change_layout)
                 area->_on_change_layout(area);
         }
@@ -800,13 +806,12 @@ void taskbar_update_thumbnails(void *arg)
 
     double start_time = get_time();
     for (int i = 0; i < num_panels; i++) {
-        Panel *panel = &panels[i];
+        Panel *panel = panels[i];
 
         for (int j = 0; j < panel->num_desktops; j++) {
             Taskbar *taskbar = &panel->taskbar[j];
-            for_taskbar_tasks( taskbar, c)
+            for_taskbar_tasks( taskbar, t)
             {
-                Task *t = c->data;
                 if ((mode == THUMB_MODE_ALL && t->current_state == TASK_ACTIVE && !g_list_find(taskbar_thumbnail_jobs_done, t)) ||
                     (mode == THUMB_MODE_ACTIVE_WINDOW && t->current_state == TASK_ACTIVE) ||
                     (mode == THUMB_MODE_TOOLTIP_WINDOW && g_tooltip.mapped && g_tooltip.area == &t->area))
@@ -814,7 +819,7 @@ void taskbar_update_thumbnails(void *arg)
                     task_refresh_thumbnail(t);
                     if (mode == THUMB_MODE_ALL)
                         g_list_append_tail (taskbar_thumbnail_jobs_done, jdone_tail, t);
-                    if (t->thumbnail && mode == THUMB_MODE_TOOLTIP_WINDOW)
+                    if (t->model->thumbnail && mode == THUMB_MODE_TOOLTIP_WINDOW)
                         taskbar_start_thumbnail_timer(THUMB_MODE_TOOLTIP_WINDOW);
                 }
                 if (mode == THUMB_MODE_ALL &&
@@ -834,3 +839,37 @@ void taskbar_update_thumbnails(void *arg)
         change_timer(&thumbnail_update_timer_all, true, 10 * 1000, 10 * 1000, taskbar_update_thumbnails, arg);
     }
 }
+
+TEST(taskbar_update_tasklist_mallocs)
+{
+    // Every client is a known task: the refresh only compares the client list with the known windows
+    enum { NUM_CLIENTS = 500 };
+    Task task;
+    memset(&task, 0, sizeof(task));
+    Window clients[NUM_CLIENTS];
+    taskbar_enabled = TRUE;
+    win_to_task = g_hash_table_new_full(win_hash, win_compare, free, free_ptr_array);
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        clients[i] = 0x1000 + i;
+        Window *key = malloc(sizeof(Window));
+        *key = clients[i];
+        GPtrArray *task_buttons = g_ptr_array_new();
+        g_ptr_array_add(task_buttons, &task);
+        g_hash_table_insert(win_to_task, key, task_buttons);
+    }
+    taskbar_update_tasklist(clients, NUM_CLIENTS);
+    arena_reset(&frame_arena);
+
+    test_count_mallocs_start();
+    for (int frame = 0; frame < 10; frame++) {
+        taskbar_update_tasklist(clients, NUM_CLIENTS);
+        arena_reset(&frame_arena);
+    }
+    long mallocs = test_count_mallocs_stop();
+
+    if (mallocs >= 0)
+        ASSERT_EQUAL(mallocs, 0L);
+    g_hash_table_destroy(win_to_task);
+    win_to_task = NULL;
+    arena_free(&frame_arena);
+}
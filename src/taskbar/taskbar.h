@@ -68,14 +68,22 @@ extern GHashTable *win_to_task;
 // win_to_task holds for every Window an array of tasks. Usually the array contains only one
 // element. However for omnipresent windows (windows which are visible in every taskbar) the array
 // contains to every Task* on each panel a pointer (i.e. GPtrArray.len == server.num_desktops)
+guint win_hash(gconstpointer key);
+gboolean win_compare(gconstpointer a, gconstpointer b);
+// Hash and equality of the Window keys of win_to_task
 
 extern Task *active_task;
 extern Task *task_drag;
 
-#define for_taskbar_tasks( tb, tl)                                                       \
-    for (GList *tl = (tb->area.children && taskbarname_enabled)                          \
-         ? tb->area.children->next                                                       \
-         : tb->area.children; tl; tl = tl->next)
+// Position of the first task among the children of the taskbar, after the taskbar name
+#define taskbar_first_task_index(tb) (taskbarname_enabled && area_num_children(&(tb)->area) ? 1 : 0)
+
+// Iterates over the tasks of the taskbar, declaring Task *task
+#define for_taskbar_tasks( tb, task)                                                                    \
+    for (Task **task##_it_ = (Task **)area_children_data(&(tb)->area) + taskbar_first_task_index(tb),  \
+              **task##_end_ = (Task **)area_children_data(&(tb)->area) + area_num_children(&(tb)->area), \
+              *task;                                                                                    \
+         task##_it_ < task##_end_ && (task = *task##_it_); task##_it_++)
 
 void default_taskbar();
 void cleanup_taskbar();
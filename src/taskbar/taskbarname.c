@@ -73,7 +73,7 @@ void init_taskbarname_panel(void *p)
             taskbar->bar_name.name = strdup_printf( NULL, "%d", j + 1);
 
         // append the name at the beginning of taskbar
-        taskbar->area.children = g_list_append(taskbar->area.children, &taskbar->bar_name);
+        area_append_child(&taskbar->area, &taskbar->bar_name.area);
         area_gradients_create(&taskbar->bar_name.area);
     }
     g_slist_free_full( list, free);
@@ -96,10 +96,10 @@ void taskbarname_default_font_changed()
     panel_config.taskbarname_font_desc = NULL;
     taskbarname_init_fonts();
     for (int i = 0; i < num_panels; i++) {
-        for (int j = 0; j < panels[i].num_desktops; j++)
+        for (int j = 0; j < panels[i]->num_desktops; j++)
         {
-            Taskbar *taskbar = &panels[i].taskbar[j];
-            taskbar->bar_name.area.resize_needed = TRUE;
+            Taskbar *taskbar = &panels[i]->taskbar[j];
+            schedule_resize(&taskbar->bar_name.area);
             schedule_redraw(&taskbar->bar_name.area);
         }
     }
@@ -110,7 +110,7 @@ void cleanup_taskbarname()
 {
     for (int i = 0; i < num_panels; i++)
     {
-        Panel *panel = &panels[i];
+        Panel *panel = panels[i];
         for (int j = 0; j < panel->num_desktops; j++)
         {
             Taskbar *taskbar = &panel->taskbar[j];
@@ -219,7 +219,7 @@ void update_desktop_names()
     {
         int j;
         GSList *l;
-        for (j = 0, l = list; j < panels[i].num_desktops; j++)
+        for (j = 0, l = list; j < panels[i]->num_desktops; j++)
         {
             gchar *name;
             if (l) {
@@ -228,11 +228,11 @@ void update_desktop_names()
             } else
                 name = strdup_printf( NULL, "%d", j + 1);
 
-            Taskbar *taskbar = &panels[i].taskbar[j];
+            Taskbar *taskbar = &panels[i]->taskbar[j];
             if (strcmp(name, taskbar->bar_name.name) != 0) {
                 free( taskbar->bar_name.name);
                 taskbar->bar_name.name = name;
-                taskbar->bar_name.area.resize_needed = TRUE;
+                schedule_resize(&taskbar->bar_name.area);
             } else
                 free( name);
         }
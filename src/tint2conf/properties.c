@@ -4140,6 +4140,25 @@ void create_execp(GtkWidget *stack, int i)
                                 _("Specifies the interval at which the command is executed, in seconds. "
                                   "If zero, the command is executed only once."));
 
+    row++, col = 2;
+    label = gtk_label_new(_("Worker shell"));
+    gtk_misc_set_alignment(GTK_MISC(label), 0, 0);
+    gtk_widget_show(label);
+    gtk_table_attach(GTK_TABLE(table), label, col, col + 1, row, row + 1, GTK_FILL, 0, 0, 0);
+    col++;
+
+    executor->worker = gtk_entry_new();
+    gtk_widget_show(executor->worker);
+    gtk_entry_set_width_chars(GTK_ENTRY(executor->worker), 20);
+    gtk_table_attach(GTK_TABLE(table), executor->worker, col, col + 1, row, row + 1, GTK_FILL, 0, 0, 0);
+    col++;
+    gtk_widget_set_tooltip_text(executor->worker,
+                                _("If not empty, the command is run by a persistent shell with this name instead of "
+                                  "a new shell each time. Executors with the same worker name share the shell and "
+                                  "run one after another. Not used with continuous output, or when a click command "
+                                  "is sent to the executor process. A command still running after the interval "
+                                  "(at least 10 seconds) is killed, and then run in a new shell each time."));
+
     row++, col = 2;
     label = gtk_label_new(_("Show icon"));
     gtk_misc_set_alignment(GTK_MISC(label), 0, 0);
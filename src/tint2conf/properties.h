@@ -121,7 +121,7 @@ typedef struct Executor {
     char name[256];
     GtkWidget *page;
     GtkWidget *id;
-    GtkWidget *cmd, *interval, *has_icon, *cache_icon, *show_tooltip;
+    GtkWidget *cmd, *interval, *worker, *has_icon, *cache_icon, *show_tooltip;
     GtkWidget *cont, *markup, *tooltip, *mon;
     GtkWidget *cmd_lclick, *cmd_rclick, *cmd_mclick;
     GtkWidget *cmd_uwheel, *cmd_dwheel;
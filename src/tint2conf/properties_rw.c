@@ -843,6 +843,7 @@ void config_write_execp(FILE *fp)
         fprintf(fp, "execp_name = %s\n", gtk_entry_get_text(GTK_ENTRY(executor->id)));
         fprintf(fp, "execp_command = %s\n", gtk_entry_get_text(GTK_ENTRY(executor->cmd)));
         fprintf(fp, "execp_interval = %d\n", (int)gtk_spin_button_get_value(GTK_SPIN_BUTTON(executor->interval)));
+        fprintf(fp, "execp_worker = %s\n", gtk_entry_get_text(GTK_ENTRY(executor->worker)));
         fprintf(fp,
                 "execp_has_icon = %d\n",
                 gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(executor->has_icon)) ? 1 : 0);
@@ -1936,6 +1937,9 @@ void add_entry(char *key, char *value)
     case key_execp_interval:
         gtk_spin_button_set_value(GTK_SPIN_BUTTON(execp_get_last()->interval), atoi(value));
         break;
+    case key_execp_worker:
+        gtk_entry_set_text(GTK_ENTRY(execp_get_last()->worker), value);
+        break;
     case key_execp_has_icon:
         gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(execp_get_last()->has_icon), atoi(value));
         break;
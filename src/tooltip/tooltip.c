@@ -30,6 +30,16 @@
 static int x, y, width, height;
 static gboolean just_shown;
 
+// The tooltip is rendered into a pixmap set as the background of the window, so that X repaints it by itself.
+// It is rendered again only if the text, the image or the position change.
+static Pixmap tooltip_pixmap;
+static int pixmap_width, pixmap_height;
+static char *rendered_text;
+static cairo_surface_t *rendered_image;
+static Panel *rendered_panel;
+static int rendered_x, rendered_y;
+static PangoLayout *tooltip_layout;
+
 // the next functions are helper functions for tooltip handling
 void start_show_timer();
 void start_hide_timer();
@@ -39,6 +49,49 @@ void tooltip_init_fonts();
 
 Tooltip g_tooltip;
 
+static void tooltip_invalidate()
+{
+    free_and_null(rendered_text);
+    if (rendered_image)
+        cairo_surface_destroy(rendered_image);
+    rendered_image = NULL;
+    rendered_panel = NULL;
+}
+
+static void tooltip_free_rendering()
+{
+    tooltip_invalidate();
+    if (tooltip_pixmap)
+        XFreePixmap(server.display, tooltip_pixmap);
+    tooltip_pixmap = None;
+    pixmap_width = pixmap_height = 0;
+    if (tooltip_layout)
+        g_object_unref(tooltip_layout);
+    tooltip_layout = NULL;
+}
+
+static PangoLayout *tooltip_get_layout()
+// Returns the layout of the tooltip text, kept across updates.
+{
+    double resolution = 96 * g_tooltip.panel->scale;
+    if (!tooltip_layout) {
+        cairo_surface_t *cs = cairo_xlib_surface_create(server.display, g_tooltip.window, server.visual, 1, 1);
+        cairo_t *c = cairo_create(cs);
+        PangoContext *context = pango_cairo_create_context(c);
+        pango_cairo_context_set_resolution(context, resolution);
+        tooltip_layout = pango_layout_new(context);
+        g_object_unref(context);
+        cairo_destroy(c);
+        cairo_surface_destroy(cs);
+        pango_layout_set_wrap(tooltip_layout, PANGO_WRAP_WORD);
+    } else if (pango_cairo_context_get_resolution(pango_layout_get_context(tooltip_layout)) != resolution) {
+        pango_cairo_context_set_resolution(pango_layout_get_context(tooltip_layout), resolution);
+        pango_layout_context_changed(tooltip_layout);
+    }
+    pango_layout_set_font_description(tooltip_layout, g_tooltip.font_desc);
+    return tooltip_layout;
+}
+
 void default_tooltip()
 {
     // give the tooltip some reasonable default values
@@ -61,6 +114,7 @@ void cleanup_tooltip()
     destroy_timer(&g_tooltip.update_timer);
     tooltip_hide(NULL);
     tooltip_set_area(NULL);
+    tooltip_free_rendering();
     if (g_tooltip.window)
         XDestroyWindow(server.display, g_tooltip.window);
     g_tooltip.window = 0;
@@ -68,6 +122,17 @@ void cleanup_tooltip()
     g_tooltip.font_desc = NULL;
 }
 
+void tooltip_forget_panel(Panel *p)
+{
+    if (g_tooltip.panel != p && rendered_panel != p)
+        return;
+    stop_tooltip_timer();
+    tooltip_hide(NULL);
+    tooltip_set_area(NULL);
+    tooltip_invalidate();
+    g_tooltip.panel = NULL;
+}
+
 void init_tooltip()
 {
     if (!g_tooltip.bg)
@@ -81,6 +146,7 @@ void init_tooltip()
     attr.background_pixel = 0;
     attr.border_pixel = 0;
     unsigned long mask = CWEventMask | CWColormap | CWBorderPixel | CWBackPixel | CWOverrideRedirect;
+    tooltip_free_rendering();
     if (g_tooltip.window)
         XDestroyWindow(server.display, g_tooltip.window);
     g_tooltip.window = XCreateWindow(server.display, server.root_win,
@@ -107,6 +173,7 @@ void tooltip_default_font_changed()
         g_tooltip.font_desc = NULL;
     }
     tooltip_init_fonts();
+    tooltip_invalidate();
     tooltip_update();
 }
 
@@ -136,8 +203,10 @@ void tooltip_show(void *arg)
     if (!g_tooltip.mapped && area->_get_tooltip_text) {
         tooltip_set_area(area);
         g_tooltip.mapped = True;
-        XMapWindow(server.display, g_tooltip.window);
+        // Render before mapping, otherwise the previous tooltip would show up for a moment
         tooltip_update();
+        if (g_tooltip.mapped)
+            XMapWindow(server.display, g_tooltip.window);
         XFlush(server.display);
     }
 }
@@ -152,12 +221,10 @@ void tooltip_update_geometry()
         pango_layout_get_pixel_extents(layout, NULL, (r)); \
     }
 
-    cairo_surface_t *cs = cairo_xlib_surface_create(server.display, g_tooltip.window, server.visual, width, height);
-    cairo_t *c = cairo_create(cs);
-    PangoContext *context = pango_cairo_create_context(c);
-    pango_cairo_context_set_resolution(context, 96 * panel->scale);
-    PangoLayout *layout = pango_layout_new(context);
-    pango_layout_set_font_description(layout, g_tooltip.font_desc);
+    PangoLayout *layout = tooltip_get_layout();
+    pango_layout_set_width(layout, -1);
+    pango_layout_set_height(layout, -1);
+    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_NONE);
 
     PangoRectangle rect;
 
@@ -175,7 +242,6 @@ void tooltip_update_geometry()
         ) * PANGO_SCALE
     );
 
-    pango_layout_set_wrap(layout, PANGO_WRAP_WORD);
     GET_TEXT_PIXEL_EXTENTS(g_tooltip.tooltip_text ? g_tooltip.tooltip_text : "1234567890abcdef", &rect);
     height = top_bottom_bg_border_width( g_tooltip.bg) + 2 * g_tooltip.paddingy * panel->scale + rect.height;
 
@@ -196,11 +262,6 @@ void tooltip_update_geometry()
     xlim: x = panel->posx + (panel_position & LEFT ? panel->area.width : -width);
 
     #undef GET_TEXT_PIXEL_EXTENTS
-
-    g_object_unref(layout);
-    g_object_unref(context);
-    cairo_destroy(c);
-    cairo_surface_destroy(cs);
 }
 
 void tooltip_adjust_geometry()
@@ -257,6 +318,11 @@ void tooltip_update()
     }
     Panel *panel = g_tooltip.panel;
 
+    // Clock, battery, executor and thumbnail refreshes mostly leave the tooltip unchanged
+    if (!just_shown && rendered_text && rendered_panel == panel && rendered_x == x && rendered_y == y &&
+        rendered_image == g_tooltip.image && strcmp(rendered_text, g_tooltip.tooltip_text) == 0)
+        return;
+
     tooltip_update_geometry();
     if (just_shown) {
         if (!panel_horizontal)
@@ -266,13 +332,21 @@ void tooltip_update()
     tooltip_adjust_geometry();
     XMoveResizeWindow(server.display, g_tooltip.window, x, y, width, height);
 
+    if (width != pixmap_width || height != pixmap_height) {
+        if (tooltip_pixmap)
+            XFreePixmap(server.display, tooltip_pixmap);
+        tooltip_pixmap = XCreatePixmap(server.display, g_tooltip.window, width, height, server.depth);
+        pixmap_width = width;
+        pixmap_height = height;
+    }
+
     // Stuff for drawing the tooltip
-    cairo_surface_t *cs = cairo_xlib_surface_create(server.display, g_tooltip.window, server.visual, width, height);
+    cairo_surface_t *cs = cairo_xlib_surface_create(server.display, tooltip_pixmap, server.visual, width, height);
     cairo_t *c = cairo_create(cs);
     Color bc = g_tooltip.bg->fill_color;
     Border b = g_tooltip.bg->border;
     if (server.real_transparency) {
-        clear_pixmap(g_tooltip.window, 0, 0, width, height);
+        clear_pixmap(tooltip_pixmap, 0, 0, width, height);
         draw_rect(c, b.width, b.width, width - 2 * b.width, height - 2 * b.width, b.radius - b.width / 2.0, g_tooltip.bg->border.rmask);
         cairo_set_source_rgba(c, bc.rgb[0], bc.rgb[1], bc.rgb[2], bc.alpha);
     } else {
@@ -293,11 +367,7 @@ void tooltip_update()
 
     Color fc = g_tooltip.font_color;
     cairo_set_source_rgba(c, fc.rgb[0], fc.rgb[1], fc.rgb[2], fc.alpha);
-    PangoContext *context = pango_cairo_create_context(c);
-    pango_cairo_context_set_resolution(context, 96 * panel->scale);
-    PangoLayout *layout = pango_layout_new(context);
-    pango_layout_set_font_description(layout, g_tooltip.font_desc);
-    pango_layout_set_wrap(layout, PANGO_WRAP_WORD);
+    PangoLayout *layout = tooltip_get_layout();
     pango_layout_set_text(layout, g_tooltip.tooltip_text, -1);
     pango_layout_set_width(layout, width * PANGO_SCALE);
     pango_layout_set_height(layout, height * PANGO_SCALE);
@@ -311,8 +381,6 @@ void tooltip_update()
                       -ext.y / 2 +  top_bg_border_width(g_tooltip.bg) + g_tooltip.paddingy * panel->scale + 1);
     }
     pango_cairo_show_layout(c, layout);
-    g_object_unref(layout);
-    g_object_unref(context);
 
     if (g_tooltip.image) {
         cairo_translate(c,
@@ -328,6 +396,16 @@ void tooltip_update()
 
     cairo_destroy(c);
     cairo_surface_destroy(cs);
+
+    XSetWindowBackgroundPixmap(server.display, g_tooltip.window, tooltip_pixmap);
+    XClearWindow(server.display, g_tooltip.window);
+
+    tooltip_invalidate();
+    rendered_text = strdup(g_tooltip.tooltip_text);
+    rendered_image = g_tooltip.image ? cairo_surface_reference(g_tooltip.image) : NULL;
+    rendered_panel = panel;
+    rendered_x = x;
+    rendered_y = y;
 }
 
 void tooltip_update_for_area(Area *area)
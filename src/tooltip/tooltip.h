@@ -49,6 +49,9 @@ void default_tooltip();
 void cleanup_tooltip();
 // freed memory
 
+void tooltip_forget_panel(Panel *p);
+// hides the tooltip if it belongs to p, which is about to be destroyed
+
 // display update
 void tooltip_update();                        // update, using set area
 void tooltip_update_for_area(Area *area);     // comprehensive update function for use in widgets, FIXME
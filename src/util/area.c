@@ -29,15 +29,153 @@
 #include <pango/pangocairo.h>
 
 #include "area.h"
+#include "arena.h"
 #include "server.h"
 #include "panel.h"
 #include "common.h"
+#include "test.h"
+#include "timer.h"
 
-#define for_children(a,i,T)     for (T i = (a)->children; i; i = i->next)
-#define for_children_rev(a,i,T) for (T i = g_list_last((a)->children); i; i = i->prev)
+// Containers with fewer children are searched linearly
+#define HIT_INDEX_MIN_CHILDREN 8
+
+typedef struct AreaHitEntry {
+    int start, end;     // Extent along the panel axis, both inclusive like in area_is_under_mouse
+    Area *area;
+} AreaHitEntry;
 
 Area *mouse_over_area = NULL;
 
+static void invalidate_hit_index(Area *a)
+{
+    if (a->hit_index) {
+        g_array_free(a->hit_index, TRUE);
+        a->hit_index = NULL;
+    }
+}
+
+static void update_hit_index(Area *a)
+// Indexes the on-screen children of a by their extent along the panel axis.
+// Children that overlap along the axis (e.g. launcher icons laid out in a table) are not indexed.
+{
+    if (area_num_children(a) < HIT_INDEX_MIN_CHILDREN) {
+        invalidate_hit_index(a);
+        return;
+    }
+    if (!a->hit_index)
+        a->hit_index = g_array_new(FALSE, FALSE, sizeof(AreaHitEntry));
+    g_array_set_size(a->hit_index, 0);
+    for_children(a, child)
+    {
+        if (!child->on_screen || !child->width || !child->height)
+            continue;
+        AreaHitEntry entry;
+        entry.start = panel_horizontal ? child->posx : child->posy;
+        entry.end = entry.start + (panel_horizontal ? child->width : child->height);
+        entry.area = child;
+        // Neighbours may share a boundary pixel
+        if (a->hit_index->len &&
+            entry.start < g_array_index(a->hit_index, AreaHitEntry, a->hit_index->len - 1).end) {
+            invalidate_hit_index(a);
+            return;
+        }
+        g_array_append_val(a->hit_index, entry);
+    }
+}
+
+static void reindex_children(Area *a, int first)
+// Updates child_index of the children of a from position first
+{
+    for (int i = first; i < area_num_children(a); i++)
+        area_child(a, i)->child_index = i;
+}
+
+static void mark_subtree_dirty(Area *a)
+{
+    // Walks up to the root, which is its own parent.
+    // Hidden subtrees keep their marks until shown, so the walk cannot stop at the first marked Area.
+    while (a) {
+        a->_subtree_dirty = TRUE;
+        a = a->parent != a ? a->parent : NULL;
+    }
+}
+
+void area_append_child(Area *parent, Area *child)
+{
+    if (!parent->children)
+        parent->children = g_ptr_array_new();
+    child->child_index = parent->children->len;
+    g_ptr_array_add(parent->children, child);
+    child->_subtree_dirty = TRUE;
+    mark_subtree_dirty(parent);
+}
+
+int area_child_position(Area *parent, Area *child)
+{
+    int n = area_num_children(parent);
+    if (child->child_index >= 0 && child->child_index < n && area_child(parent, child->child_index) == child)
+        return child->child_index;
+    for (int i = 0; i < n; i++)
+        if (area_child(parent, i) == child)
+            return i;
+    return -1;
+}
+
+void swap_child_areas(Area *a, Area *b)
+{
+    Area *parent = a->parent;
+    int ia = area_child_position(parent, a);
+    int ib = area_child_position(parent, b);
+    if (ia < 0 || ib < 0)
+        return;
+    parent->children->pdata[ia] = b;
+    parent->children->pdata[ib] = a;
+    a->child_index = ib;
+    b->child_index = ia;
+    invalidate_hit_index(parent);
+}
+
+static void merge_sort_areas(Area **items, Area **tmp, int n, GCompareDataFunc compare, void *data)
+// Stable sort of items, tmp must hold n / 2 elements
+{
+    if (n <= 8) {
+        for (int i = 1; i < n; i++) {
+            Area *item = items[i];
+            int j = i;
+            for (; j > 0 && compare(items[j - 1], item, data) > 0; j--)
+                items[j] = items[j - 1];
+            items[j] = item;
+        }
+        return;
+    }
+    int half = n / 2;
+    merge_sort_areas(items, tmp, half, compare, data);
+    merge_sort_areas(items + half, tmp, n - half, compare, data);
+    if (compare(items[half - 1], items[half], data) <= 0)
+        return;
+    memcpy(tmp, items, half * sizeof(Area *));
+    int i = 0, j = half, k = 0;
+    while (i < half && j < n)
+        items[k++] = compare(items[j], tmp[i], data) < 0 ? items[j++] : tmp[i++];
+    while (i < half)
+        items[k++] = tmp[i++];
+}
+
+void sort_child_areas(Area *a, int first, GCompareDataFunc compare, void *data)
+{
+    int n = area_num_children(a) - first;
+    if (n < 2)
+        return;
+    ArenaMark mark = arena_mark(&frame_arena);
+    Area **tmp = arena_alloc(&frame_arena, (n / 2) * sizeof(Area *));
+    merge_sort_areas((Area **)a->children->pdata + first, tmp, n, compare, data);
+    arena_rewind(&frame_arena, mark);
+    reindex_children(a, first);
+    invalidate_hit_index(a);
+    // The children must be moved to their new positions
+    mark_subtree_dirty(a);
+}
+
 void init_background(Background *bg)
 {
     memset(bg, 0, sizeof(Background));
@@ -50,9 +188,8 @@ void initialize_positions(void *obj)
 {
     Area *a = obj;
     double scale = ((Panel *)a->panel)->scale;
-    for_children(a, l, GList *)
+    for_children(a, child)
     {
-        Area *child = l->data;
         if (panel_horizontal) {
             child->posy   = a->posy   + top_border_width(a)        + a->paddingy * scale;
             child->height = a->height - top_bottom_border_width(a) - 2 * a->paddingy * scale;
@@ -69,14 +206,22 @@ void initialize_positions(void *obj)
     }
 }
 
+int relayout_num_visited;
+
+void schedule_resize(Area *a)
+{
+    a->resize_needed = TRUE;
+    mark_subtree_dirty(a);
+}
+
 void relayout_fixed(Area *a)
 {
-    if (!a->on_screen)
+    if (!a->on_screen || !a->_subtree_dirty)
         return;
 
     // Children are resized before the parent
-    for_children(a, l, GList *)
-        relayout_fixed(l->data);
+    for_children(a, child)
+        relayout_fixed(child);
 
     // Recalculate size
     a->_changed = CHANGE_NONE;
@@ -92,10 +237,30 @@ void relayout_fixed(Area *a)
     }
 }
 
-void relayout_dynamic(Area *a)
+static void relayout_dynamic(Area *a);
+
+static void relayout_dynamic_child(Area *child, int pos)
+// Moves the child to pos along the panel axis, then relayouts it unless its subtree is unchanged
+{
+    int *child_pos = panel_horizontal ? &child->posx : &child->posy;
+    if (pos != *child_pos) {
+        // pos changed => redraw
+        if (!child->_subtree_dirty)
+            // Skipped by relayout_fixed, the flags are left over from an earlier frame
+            child->_changed = CHANGE_NONE;
+        *child_pos = pos;
+        child->_changed |= CHANGE_MOVE;
+    } else if (!child->_subtree_dirty) {
+        return;
+    }
+    relayout_dynamic(child);
+}
+
+static void relayout_dynamic(Area *a)
 {
     if (!a->on_screen)
         return;
+    relayout_num_visited++;
 
     double scale = ((Panel *)a->panel)->scale;
 
@@ -107,43 +272,30 @@ void relayout_dynamic(Area *a)
             if (a->_resize(a))
                 a->_changed |= CHANGE_RESIZE;
             // resize children with LAYOUT_DYNAMIC
-            for_children(a, l, GList *)
+            for_children(a, child)
             {
-                Area *child = l->data;
-                if (child->size_mode == LAYOUT_DYNAMIC && child->children)
+                if (child->size_mode == LAYOUT_DYNAMIC && area_num_children(child)) {
                     child->resize_needed = TRUE;
+                    child->_subtree_dirty = TRUE;
+                }
             }
         }
     }
 
     // Layout children
-    if (a->children) {
+    if (area_num_children(a)) {
         int pos;
         switch (a->alignment) {
         case ALIGN_LEFT:
             pos = (panel_horizontal ? a->posx + left_border_width(a)
                                     : a->posy + top_border_width (a)) + a->paddingx * scale;
 
-            for_children(a, l, GList *)
+            for_children(a, child)
             {
-                Area *child = l->data;
                 if (!child->on_screen)
                     continue;
 
-                if (panel_horizontal) {
-                    if (pos != child->posx) {
-                        // pos changed => redraw
-                        child->posx = pos;
-                        child->_changed |= CHANGE_MOVE;
-                    }
-                } else {
-                    if (pos != child->posy) {
-                        // pos changed => redraw
-                        child->posy = pos;
-                        child->_changed |= CHANGE_MOVE;
-                    }
-                }
-                relayout_dynamic( child);
+                relayout_dynamic_child(child, pos);
                 pos += (panel_horizontal ? child->width : child->height) + a->spacing * scale;
             }
             break;
@@ -151,27 +303,13 @@ void relayout_dynamic(Area *a)
             pos = (panel_horizontal ? a->posx + a->width - right_border_width(a)
                                     : a->posy + a->height - bottom_border_width(a)) - a->paddingx * scale;
 
-            for_children_rev(a, l, GList *)
+            for_children_rev(a, child)
             {
-                Area *child = l->data;
                 if (!child->on_screen)
                     continue;
 
                 pos -= panel_horizontal ? child->width : child->height;
-                if (panel_horizontal) {
-                    if (pos != child->posx) {
-                        // pos changed => redraw
-                        child->posx = pos;
-                        child->_changed |= CHANGE_MOVE;
-                    }
-                } else {
-                    if (pos != child->posy) {
-                        // pos changed => redraw
-                        child->posy = pos;
-                        child->_changed |= CHANGE_MOVE;
-                    }
-                }
-                relayout_dynamic( child);
+                relayout_dynamic_child(child, pos);
                 pos -= a->spacing * scale;
             }
             break;
@@ -179,9 +317,8 @@ void relayout_dynamic(Area *a)
             {
                 int children_size = 0;
                 int gaps_count = -1;
-                for_children(a, l, GList *)
+                for_children(a, child)
                 {
-                    Area *child = l->data;
                     if (!child->on_screen)
                         continue;
 
@@ -192,26 +329,12 @@ void relayout_dynamic(Area *a)
                 pos = (panel_horizontal ? a->posx + (a->width - children_size) / 2
                                         : a->posy + (a->height - children_size) / 2);
             }
-            for_children(a, l, GList *)
+            for_children(a, child)
             {
-                Area *child = l->data;
                 if (!child->on_screen)
                     continue;
 
-                if (panel_horizontal) {
-                    if (pos != child->posx) {
-                        // pos changed => redraw
-                        child->posx = pos;
-                        child->_changed |= CHANGE_MOVE;
-                    }
-                } else {
-                    if (pos != child->posy) {
-                        // pos changed => redraw
-                        child->posy = pos;
-                        child->_changed |= CHANGE_MOVE;
-                    }
-                }
-                relayout_dynamic( child);
+                relayout_dynamic_child(child, pos);
                 pos += (panel_horizontal ? child->width : child->height) + a->spacing * scale;
             }
             break;
@@ -224,6 +347,11 @@ void relayout_dynamic(Area *a)
         if (a->_on_change_layout)
             a->_on_change_layout(a);
     }
+
+    // The positions of the children are final now
+    if (area_num_children(a))
+        update_hit_index(a);
+    a->_subtree_dirty = FALSE;
 }
 
 int get_desired_size(Area *a)
@@ -245,9 +373,8 @@ int container_get_desired_size(Area *a)
     double scale = ((Panel *)a->panel)->scale;
     int result = (panel_horizontal ? left_right_border_width(a) : top_bottom_border_width(a)) + 2 * a->paddingx * scale;
     int children_count = 0;
-    for_children(a, l, GList *)
+    for_children(a, child)
     {
-        Area *child = l->data;
         if (child->on_screen) {
             result += get_desired_size(child);
             children_count++;
@@ -260,6 +387,9 @@ int container_get_desired_size(Area *a)
 
 void relayout(Area *a)
 {
+    relayout_num_visited = 0;
+    if (!a->_subtree_dirty)
+        return;
     relayout_fixed(a);
     relayout_dynamic(a);
 }
@@ -275,8 +405,7 @@ int relayout_with_constraint(Area *a, int maximum_size)
     if (panel_horizontal) {
         // compute free space for areas with LAYOUT_DYNAMIC
         int dyn_space = a->width - left_right_border_width(a) - 2 * a->paddingx * scale;
-        for_children( a, l, GList *) {
-            Area *child = l->data;
+        for_children(a, child) {
             if (child->on_screen)
             {
                 switch (child->size_mode) {
@@ -306,8 +435,7 @@ int relayout_with_constraint(Area *a, int maximum_size)
 
         // Resize LAYOUT_DYNAMIC objects
         // they get same computed size with the rest shared evenly for first of them
-        for_children( a, l, GList *) {
-            Area *child = l->data;
+        for_children(a, child) {
             if (child->on_screen && child->size_mode == LAYOUT_DYNAMIC)
             {
                 int old_width = child->width;
@@ -316,15 +444,16 @@ int relayout_with_constraint(Area *a, int maximum_size)
                     rest--;
                     child->width++;
                 }
-                if (child->width != old_width)
+                if (child->width != old_width) {
                     child->_changed |= CHANGE_RESIZE;
+                    child->_subtree_dirty = TRUE;
+                }
             }
         }
     } else {
         // compute free space for areas with LAYOUT_DYNAMIC
         int dyn_space = a->height - top_bottom_border_width(a) - 2 * a->paddingx * scale;
-        for_children( a, l, GList *) {
-            Area *child = l->data;
+        for_children(a, child) {
             if (child->on_screen)
             {
                 switch (child->size_mode) {
@@ -354,8 +483,7 @@ int relayout_with_constraint(Area *a, int maximum_size)
 
         // Resize LAYOUT_DYNAMIC objects
         // they get same computed size with the rest shared evenly for first of them
-        for_children( a, l, GList *) {
-            Area *child = l->data;
+        for_children(a, child) {
             if (child->on_screen && child->size_mode == LAYOUT_DYNAMIC)
             {
                 int old_height = child->height;
@@ -364,8 +492,10 @@ int relayout_with_constraint(Area *a, int maximum_size)
                     rest--;
                     child->height++;
                 }
-                if (child->height != old_height)
+                if (child->height != old_height) {
                     child->_changed |= CHANGE_RESIZE;
+                    child->_subtree_dirty = TRUE;
+                }
             }
         }
     }
@@ -376,8 +506,8 @@ void schedule_redraw(Area *a)
 {
     a->_redraw_needed = TRUE;
 
-    for_children(a, l, GList *)
-        schedule_redraw(l->data);
+    for_children(a, child)
+        schedule_redraw(child);
     schedule_panel_redraw();
 }
 
@@ -400,8 +530,8 @@ void draw_tree(Area *a)
     else
         fprintf(stderr, RED "tint2: %s %d: area %s has no pixmap!!!" RESET "\n", __FILE__, __LINE__, a->name);
 
-    for_children(a, l, GList *)
-        draw_tree(l->data);
+    for_children(a, child)
+        draw_tree(child);
 }
 
 void free_pixmaps(Area *a)
@@ -429,8 +559,10 @@ void hide(Area *a)
     free_pixmaps( a);
 
     Area *parent = a->parent;
-    if (parent)
-        parent->resize_needed = TRUE;
+    if (parent) {
+        invalidate_hit_index(parent);
+        schedule_resize(parent);
+    }
 }
 
 void show(Area *a)
@@ -439,11 +571,9 @@ void show(Area *a)
         return;
 
     a->on_screen = TRUE;
-    a->resize_needed = TRUE;
-
-    Area *parent = a->parent;
-    if (parent)
-        parent->resize_needed = TRUE;
+    if (a->parent)
+        invalidate_hit_index(a->parent);
+    schedule_resize(a);
 
     schedule_panel_redraw();
 }
@@ -470,8 +600,8 @@ void update_dependent_gradients(Area *a)
             if (gi->area != a)
                 schedule_redraw(gi->area);
         }
-    for_children(a, l, GList *)
-        update_dependent_gradients(l->data);
+    for_children(a, child)
+        update_dependent_gradients(child);
 }
 
 void draw(Area *a)
@@ -698,8 +828,13 @@ void remove_area(Area *a)
     area_gradients_free(a);
 
     if (parent) {
-        parent->children = g_list_remove(parent->children, area);
-        parent->resize_needed = TRUE;
+        int index = area_child_position(parent, area);
+        if (index >= 0) {
+            g_ptr_array_remove_index(parent->children, index);
+            reindex_children(parent, index);
+        }
+        invalidate_hit_index(parent);
+        schedule_resize(parent);
         schedule_panel_redraw();
         schedule_redraw(parent);
     }
@@ -709,30 +844,53 @@ void remove_area(Area *a)
 }
 
 void add_area(Area *a, Area *parent)
+{
+    insert_area(a, parent, -1);
+}
+
+void insert_area(Area *a, Area *parent, int index)
 {
     g_assert_null(a->parent);
 
     a->parent = parent;
     if (parent) {
-        parent->children = g_list_append(parent->children, a);
-        parent->resize_needed = TRUE;
+        if (!parent->children)
+            parent->children = g_ptr_array_new();
+        if (index < 0 || index > (int)parent->children->len)
+            index = parent->children->len;
+        g_ptr_array_insert(parent->children, index, a);
+        reindex_children(parent, index);
+        invalidate_hit_index(parent);
+        a->_subtree_dirty = TRUE;
+        schedule_resize(parent);
         schedule_redraw(parent);
     }
 }
 
+static void area_free_text_layouts(Area *area)
+{
+    for (int i = 0; i < ARRAY_SIZE(area->_text_layouts); i++) {
+        if (area->_text_layouts[i])
+            g_object_unref(area->_text_layouts[i]);
+        area->_text_layouts[i] = NULL;
+    }
+}
+
 void free_area(Area *a)
 {
     if (!a)
         return;
 
-    for_children(a, l, GList *)
-        free_area(l->data);
+    for_children(a, child)
+        free_area(child);
 
     if (a->children) {
-        g_list_free(a->children);
+        g_ptr_array_free(a->children, TRUE);
         a->children = NULL;
     }
+    invalidate_hit_index(a);
     free_pixmaps (a);
+    area_free_text_layouts(a);
     if (mouse_over_area == a)
         mouse_over_area = NULL;
 
@@ -794,10 +952,9 @@ gboolean area_is_end(void *obj, gboolean first)
         if (node == a)
             return TRUE;
 
-        GList *l = node->children;
+        Area *parent = node;
         node = NULL;
-        for (; l; l = l->next) {
-            Area *child = l->data;
+        for_children(parent, child) {
             if (!child->on_screen || child->width == 0 || child->height == 0)
                 continue;
             node = child;
@@ -830,18 +987,48 @@ gboolean full_width_area_is_under_mouse(void *obj, int x, int y)
                              : (y >= a->posy) && (y <= a->posy + a->height);
 }
 
-Area *find_area_under_mouse(void *root, int x, int y)
+Area *find_child_under_mouse(Area *a, int x, int y)
 {
-    Area *result = root;
-deeper:
-    for (GList *it = result->children; it; it = it->next)
-    {
-        Area *a = it->data;
-        if (area_is_under_mouse(a, x, y)) {
-            result = a;
-            goto deeper;
+    if (a->hit_index) {
+        const AreaHitEntry *entries = (const AreaHitEntry *)a->hit_index->data;
+        int pos = panel_horizontal ? x : y;
+        // Find the first entry starting after pos
+        int lo = 0, hi = a->hit_index->len;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (entries[mid].start <= pos)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        // The two entries before it may contain pos, the first one wins like in the list
+        for (int k = MAX(lo - 2, 0); k < lo; k++) {
+            if (pos > entries[k].end)
+                continue;
+            Area *child = entries[k].area;
+            if (!child->on_screen)
+                // Hidden since the last relayout, the index is stale
+                goto linear;
+            // If it does not take the mouse (e.g. outside of it on the other axis), the next one may
+            if (area_is_under_mouse(child, x, y))
+                return child;
         }
+        return NULL;
+    }
+linear:
+    for_children(a, child)
+    {
+        if (area_is_under_mouse(child, x, y))
+            return child;
     }
+    return NULL;
+}
+
+Area *find_area_under_mouse(void *root, int x, int y)
+{
+    Area *result = root;
+    for (Area *child; (child = find_child_under_mouse(result, x, y)); )
+        result = child;
     return result;
 }
 
@@ -944,11 +1131,11 @@ void area_dump_geometry(Area *area, int indent)
             area->spacing);
     if (area->_dump_geometry)
         area->_dump_geometry(area, indent);
-    if (area->children) {
+    if (area_num_children(area)) {
         fprintf(stderr, "tint2: %*sChildren:\n", indent, "");
         indent += 2;
-        for_children(area, l, GList *)
-            area_dump_geometry(l->data, indent);
+        for_children(area, child)
+            area_dump_geometry(child, indent);
     }
 }
 
@@ -975,6 +1162,54 @@ void area_get_inner_size(Area *area,
     *inner_h = area->height - top_bottom_border_width (area) - 2 * area->paddingy * scale;
 }
 
+static PangoLayout *area_get_text_layout(Area *area, int line, const char *text, PangoFontDescription *font_desc)
+// Returns the layout of a text line (0 or 1) of the area, as wide as the available space.
+// The layouts are kept across frames, so Pango only shapes the text again when the text, the font
+// or the available size change.
+{
+    double resolution = 96 * ((Panel *)area->panel)->scale;
+    PangoLayout *layout = area->_text_layouts[line];
+    if (!layout) {
+        // Same font options as an X drawable, so that measurement matches rendering
+        Pixmap pmap = XCreatePixmap(server.display, server.root_win, 1, 1, server.depth);
+        cairo_surface_t *cs = cairo_xlib_surface_create(server.display, pmap, server.visual, 1, 1);
+        cairo_t *c = cairo_create(cs);
+        PangoContext *context = pango_cairo_create_context(c);
+        pango_cairo_context_set_resolution(context, resolution);
+        layout = area->_text_layouts[line] = pango_layout_new(context);
+        g_object_unref(context);
+        cairo_destroy(c);
+        cairo_surface_destroy(cs);
+        XFreePixmap(server.display, pmap);
+
+        pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+        pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
+        pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_NONE);
+    } else if (pango_cairo_context_get_resolution(pango_layout_get_context(layout)) != resolution) {
+        pango_cairo_context_set_resolution(pango_layout_get_context(layout), resolution);
+        pango_layout_context_changed(layout);
+    }
+
+    int available_w, available_h;
+    area_get_available_size(area, &available_w, &available_h);
+    // Setting unchanged values does not invalidate the layout, except for the text
+    pango_layout_set_width(layout, MAX(0, available_w) * PANGO_SCALE);
+    pango_layout_set_height(layout, MAX(0, available_h) * PANGO_SCALE);
+    pango_layout_set_font_description(layout, font_desc);
+    if (g_strcmp0(pango_layout_get_text(layout), text) != 0)
+        pango_layout_set_text(layout, text, -1);
+    return layout;
+}
+
+static void get_text_layout_size(PangoLayout *layout, int *height, int *width)
+// Same rounding as get_text_size2
+{
+    PangoRectangle rect;
+    pango_layout_get_extents(layout, NULL, &rect);
+    *width  = ceil((rect.x + rect.width ) / (double)PANGO_SCALE) - floor(rect.x / (double)PANGO_SCALE);
+    *height = ceil((rect.y + rect.height) / (double)PANGO_SCALE) - floor(rect.y / (double)PANGO_SCALE);
+}
+
 void area_get_text_geometry(Area *area,
                                 const char *line1,
                                 const char *line2,
@@ -985,38 +1220,13 @@ void area_get_text_geometry(Area *area,
                                 int *line2_height,
                                 int *line2_width)
 {
-    int available_w, available_h;
-    area_get_available_size(area, &available_w, &available_h);
-
     if (line1 && line1[0])
-        get_text_size2( line1_font_desc,
-                        line1_height,
-                        line1_width,
-                        available_h,
-                        available_w,
-                        line1,
-                        strlen( line1),
-                        PANGO_WRAP_WORD_CHAR,
-                        PANGO_ELLIPSIZE_NONE,
-                        PANGO_ALIGN_CENTER,
-                        FALSE,
-                        ((Panel*)area->panel)->scale );
+        get_text_layout_size(area_get_text_layout(area, 0, line1, line1_font_desc), line1_height, line1_width);
     else
         *line1_width = *line1_height = 0;
 
     if (line2 && line2[0])
-        get_text_size2( line2_font_desc,
-                        line2_height,
-                        line2_width,
-                        available_h,
-                        available_w,
-                        line2,
-                        strlen( line2),
-                        PANGO_WRAP_WORD_CHAR,
-                        PANGO_ELLIPSIZE_NONE,
-                        PANGO_ALIGN_CENTER,
-                        FALSE,
-                        ((Panel*)area->panel)->scale );
+        get_text_layout_size(area_get_text_layout(area, 1, line2, line2_font_desc), line2_height, line2_width);
     else
         *line2_width = *line2_height = 0;
 }
@@ -1115,35 +1325,29 @@ void draw_text_area(Area *area,
 {
     int inner_w, inner_h;
     area_get_inner_size(area, &inner_w, &inner_h);
+    int available_w, available_h;
+    area_get_available_size(area, &available_w, &available_h);
 
-    PangoContext *context = pango_cairo_create_context(c);
-    pango_cairo_context_set_resolution(context, 96 * scale);
-    PangoLayout *layout = pango_layout_new(context);
-
-    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
-    pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
-    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_NONE);
-    pango_layout_set_width(layout, inner_w * PANGO_SCALE);
-    pango_layout_set_height(layout, inner_h * PANGO_SCALE);
+    // The layouts used for measuring are as wide as the available space.
+    // They are shifted so that the text is centered exactly as in a layout of the inner width.
+    double posx = (area->width - inner_w) / 2 + (inner_w - MAX(0, available_w)) / 2.0;
+    cairo_save(c);
+    cairo_translate(c, posx - floor(posx), 0);
     cairo_set_source_rgba(c, color->rgb[0], color->rgb[1], color->rgb[2], color->alpha);
 
     if (line1 && line1[0]) {
-        pango_layout_set_font_description(layout, line1_font_desc);
-        pango_layout_set_text(layout, line1, strlen(line1));
+        PangoLayout *layout = area_get_text_layout(area, 0, line1, line1_font_desc);
         pango_cairo_update_layout(c, layout);
-        draw_text(layout, c, (area->width - inner_w) / 2, line1_posy, color, ((Panel *)area->panel)->font_shadow ? layout : NULL);
+        draw_text(layout, c, floor(posx), line1_posy, color, ((Panel *)area->panel)->font_shadow ? layout : NULL);
     }
 
     if (line2 && line2[0]) {
-        pango_layout_set_font_description(layout, line2_font_desc);
-        pango_layout_set_indent(layout, 0);
-        pango_layout_set_text(layout, line2, strlen(line2));
+        PangoLayout *layout = area_get_text_layout(area, 1, line2, line2_font_desc);
         pango_cairo_update_layout(c, layout);
-        draw_text(layout, c, (area->width - inner_w) / 2, line2_posy, color, ((Panel *)area->panel)->font_shadow ? layout : NULL);
+        draw_text(layout, c, floor(posx), line2_posy, color, ((Panel *)area->panel)->font_shadow ? layout : NULL);
     }
 
-    g_object_unref(layout);
-    g_object_unref(context);
+    cairo_restore(c);
 }
 
 gboolean gradient_point_area_dependent(ControlPoint *control)
@@ -1328,3 +1532,251 @@ void update_gradient(GradientInstance *gi)
                                       gi->gradient_class->end_color.rgb[2],
                                       gi->gradient_class->end_color.alpha);
 }
+
+#define BENCH_NUM_TASKS 500
+#define BENCH_TASK_WIDTH 40
+
+static Panel *bench_layout_create()
+// A horizontal panel with a single taskbar-like container, which holds the tasks
+{
+    static Background bg;
+    init_background(&bg);
+    panel_horizontal = TRUE;
+
+    Panel *panel = calloc(1, sizeof(Panel));
+    panel->scale = 1;
+    Area *root = &panel->area;
+    Area *container = calloc(1, sizeof(Area));
+    Area *tasks = calloc(BENCH_NUM_TASKS, sizeof(Area));
+    Area *areas[] = { root, container };
+    for (int i = 0; i < ARRAY_SIZE(areas); i++) {
+        areas[i]->bg = &bg;
+        areas[i]->panel = panel;
+        areas[i]->on_screen = TRUE;
+        areas[i]->size_mode = LAYOUT_DYNAMIC;
+        areas[i]->alignment = ALIGN_LEFT;
+        areas[i]->width = BENCH_NUM_TASKS * BENCH_TASK_WIDTH;
+        areas[i]->height = 30;
+    }
+    add_area(container, root);
+    for (int i = 0; i < BENCH_NUM_TASKS; i++) {
+        tasks[i].panel = panel;
+        tasks[i].on_screen = TRUE;
+        tasks[i].size_mode = LAYOUT_DYNAMIC;
+        tasks[i].width = BENCH_TASK_WIDTH;
+        tasks[i].height = 30;
+        add_area(&tasks[i], container);
+    }
+    relayout(root);
+    return panel;
+}
+
+static void bench_layout_free(Panel *panel)
+{
+    Area *container = g_ptr_array_index(panel->area.children, 0);
+    Area *tasks = g_ptr_array_index(container->children, 0);
+    free_area(&panel->area);
+    free(tasks);
+    free(container);
+    free(panel);
+}
+
+BENCH(relayout)
+{
+    Panel *panel = bench_layout_create();
+    Area *container = g_ptr_array_index(panel->area.children, 0);
+    BENCH_LOOP {
+        schedule_resize(&panel->area);
+        schedule_resize(container);
+        relayout(&panel->area);
+    }
+    bench_layout_free(panel);
+}
+
+BENCH(relayout_one_child)
+{
+    Panel *panel = bench_layout_create();
+    Area *container = g_ptr_array_index(panel->area.children, 0);
+    int i = 0;
+    BENCH_LOOP {
+        schedule_resize(g_ptr_array_index(container->children, i++ % BENCH_NUM_TASKS));
+        relayout(&panel->area);
+    }
+    fprintf(stderr, "tint2: relayout visited %d areas\n", relayout_num_visited);
+    bench_layout_free(panel);
+}
+
+BENCH(find_area_under_mouse)
+{
+    Panel *panel = bench_layout_create();
+    int i = 0;
+    BENCH_LOOP {
+        Area *hit = find_area_under_mouse(&panel->area, (i++ * 7919) % (BENCH_NUM_TASKS * BENCH_TASK_WIDTH), 15);
+        BENCH_KEEP(hit);
+    }
+    bench_layout_free(panel);
+}
+
+BENCH(schedule_redraw)
+{
+    Panel *panel = bench_layout_create();
+    BENCH_LOOP
+        schedule_redraw(&panel->area);
+    bench_layout_free(panel);
+}
+
+TEST(find_child_under_mouse)
+{
+    gboolean horizontal = panel_horizontal;
+    panel_horizontal = TRUE;
+
+    Area parent, children[10];
+    memset(&parent, 0, sizeof(parent));
+    memset(children, 0, sizeof(children));
+    for (int i = 0; i < 10; i++) {
+        // Touching children, 10 pixels wide, the last one hidden
+        children[i].posx = i * 10;
+        children[i].width = 10;
+        children[i].height = 20;
+        children[i].on_screen = i != 9;
+        area_append_child(&parent, &children[i]);
+    }
+    update_hit_index(&parent);
+    ASSERT(parent.hit_index != NULL);
+    ASSERT_EQUAL(parent.hit_index->len, 9u);
+
+    ASSERT(find_child_under_mouse(&parent, 0, 5) == &children[0]);
+    ASSERT(find_child_under_mouse(&parent, 15, 5) == &children[1]);
+    // A shared boundary pixel belongs to the first child, like in a linear search
+    ASSERT(find_child_under_mouse(&parent, 20, 5) == &children[1]);
+    ASSERT(find_child_under_mouse(&parent, 85, 5) == &children[8]);
+    ASSERT(find_child_under_mouse(&parent, 95, 5) == NULL);
+    ASSERT(find_child_under_mouse(&parent, -1, 5) == NULL);
+    ASSERT(find_child_under_mouse(&parent, 15, 25) == NULL);
+    // If the first candidate does not take the mouse, the next one may
+    children[1].height = 4;
+    ASSERT(find_child_under_mouse(&parent, 20, 5) == &children[2]);
+    children[1].height = 20;
+
+    // Hiding a child invalidates the index
+    parent.parent = &parent;
+    children[3].parent = &parent;
+    hide(&children[3]);
+    ASSERT(parent.hit_index == NULL);
+    ASSERT(find_child_under_mouse(&parent, 35, 5) == NULL);
+    children[3].on_screen = TRUE;
+    children[3].width = 10;
+
+    // Overlapping children are not indexed
+    children[5].posx = 45;
+    update_hit_index(&parent);
+    ASSERT(parent.hit_index == NULL);
+    ASSERT(find_child_under_mouse(&parent, 47, 5) == &children[4]);
+
+    g_ptr_array_free(parent.children, TRUE);
+    panel_horizontal = horizontal;
+}
+
+static gint compare_test_widths(Area *a, Area *b, void *data)
+{
+    return a->width - b->width;
+}
+
+TEST(sort_child_areas)
+{
+    Area parent, children[40];
+    memset(&parent, 0, sizeof(parent));
+    memset(children, 0, sizeof(children));
+    area_append_child(&parent, &children[0]);
+    for (int i = 1; i < 40; i++) {
+        // Many equal keys, to check that the sort is stable
+        children[i].width = (i * 7) % 5;
+        area_append_child(&parent, &children[i]);
+    }
+    sort_child_areas(&parent, 1, (GCompareDataFunc)compare_test_widths, NULL);
+
+    ASSERT(g_ptr_array_index(parent.children, 0) == &children[0]);
+    for (int i = 2; i < 40; i++) {
+        Area *prev = g_ptr_array_index(parent.children, i - 1);
+        Area *child = g_ptr_array_index(parent.children, i);
+        ASSERT(prev->width < child->width || (prev->width == child->width && prev < child));
+        ASSERT_EQUAL(child->child_index, i);
+    }
+    g_ptr_array_free(parent.children, TRUE);
+    arena_free(&frame_arena);
+}
+
+static gint compare_test_posx_desc(Area *a, Area *b, void *data)
+{
+    return b->posx - a->posx;
+}
+
+TEST(relayout_skips_clean_subtrees)
+{
+    gboolean horizontal = panel_horizontal;
+    panel_horizontal = TRUE;
+
+    // A root with two groups of four leaves, each leaf 10 pixels wide
+    Panel panel;
+    memset(&panel, 0, sizeof(panel));
+    panel.scale = 1;
+    Background bg;
+    init_background(&bg);
+    Area groups[2], leaves[2][4];
+    memset(groups, 0, sizeof(groups));
+    memset(leaves, 0, sizeof(leaves));
+    Area *root = &panel.area;
+    root->parent = root;
+    for (int i = 0; i < 2; i++) {
+        groups[i].width = 40;
+        add_area(&groups[i], root);
+        for (int j = 0; j < 4; j++) {
+            leaves[i][j].width = 10;
+            add_area(&leaves[i][j], &groups[i]);
+        }
+    }
+    Area *areas[] = { root, &groups[0], &groups[1] };
+    for (int i = 0; i < ARRAY_SIZE(areas); i++) {
+        for_children(areas[i], child) {
+            child->panel = &panel;
+            child->bg = &bg;
+            child->on_screen = TRUE;
+            child->size_mode = LAYOUT_DYNAMIC;
+        }
+    }
+    root->panel = &panel;
+    root->bg = &bg;
+    root->on_screen = TRUE;
+    root->width = 80;
+
+    relayout(root);
+    ASSERT_EQUAL(relayout_num_visited, 11);
+    ASSERT_EQUAL(leaves[1][3].posx, 70);
+
+    relayout(root);
+    ASSERT_EQUAL(relayout_num_visited, 0);
+
+    // Only the path to the leaf is visited
+    schedule_resize(&leaves[1][2]);
+    relayout(root);
+    ASSERT_EQUAL(relayout_num_visited, 3);
+
+    // The siblings that move are visited too, the other group is not
+    hide(&leaves[0][0]);
+    relayout(root);
+    ASSERT_EQUAL(relayout_num_visited, 5);
+    ASSERT_EQUAL(leaves[0][1].posx, 0);
+    ASSERT_EQUAL(leaves[1][0].posx, 40);
+
+    // Sorted children are moved by the next relayout, and only keep the flags of this frame
+    leaves[1][3]._changed = CHANGE_RESIZE;
+    sort_child_areas(&groups[1], 0, (GCompareDataFunc)compare_test_posx_desc, NULL);
+    relayout(root);
+    ASSERT_EQUAL(leaves[1][3].posx, 40);
+    ASSERT_EQUAL(leaves[1][0].posx, 70);
+    ASSERT_EQUAL(leaves[1][3]._changed, CHANGE_MOVE);
+
+    free_area(root);
+    arena_free(&frame_arena);
+    panel_horizontal = horizontal;
+}
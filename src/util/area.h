@@ -182,7 +182,9 @@ typedef struct Area {
     GList *gradient_instances_by_state[MOUSE_STATE_COUNT];
                                 // Each element is a GradientInstance attached to this Area (list can be empty)
     GList *dependent_gradients; // Each element is a GradientInstance that depends on this Area's geometry (position or size)
-    GList *children;            // List of children, each one a pointer to Area
+    GPtrArray *children;        // Children, each one a pointer to Area; NULL if the Area never had children
+    int child_index;            // Position of the Area among the children of its parent
+    GArray *hit_index;          // On-screen children sorted along the panel axis, for hit tests; built by relayout
     void *parent;               // Pointer to the parent Area or NULL
     void *panel;                // Pointer to the Panel that contains this Area
     Layout size_mode;
@@ -195,12 +197,16 @@ typedef struct Area {
     MouseState mouse_state;
     gboolean on_screen;         // Set to non-zero if the Area is visible. An object may exist but stay hidden.
     gboolean resize_needed;     // Set to non-zero if the size of the Area has to be recalculated.
+                                // Do not set this directly; use schedule_resize() instead.
+    gboolean _subtree_dirty;    // Set to non-zero if the Area or one of its descendants has to be relayouted.
+                                // Clean subtrees are skipped by relayout.
     gboolean _redraw_needed;    // Set to non-zero if the Area has to be redrawn.
                                 // Do not set this directly; use schedule_redraw() instead.
     ChangeState _changed;       // Bitfield, indicating geometry change; _on_change_layout must be called when this is set
     Pixmap pix;                 // Pointer to pixmap for current state. All rendering goes there.
                                 // Render to it directly on need.
     Pixmap pix_by_state[MOUSE_STATE_COUNT];
+    PangoLayout *_text_layouts[2]; // Text lines of areas drawn with draw_text_area, kept between frames
     char name[32];
 
     // Callbacks
@@ -251,6 +257,10 @@ void initialize_positions(
 
 void relayout(Area *a);
 // Relayouts the Area and its children. Normally called on the root of the tree (i.e. the Panel).
+// Only the subtrees marked by schedule_resize, show, hide or by adding/removing children are visited.
+
+extern int relayout_num_visited;
+// Number of Areas visited by the last call to relayout. Printed when DEBUG_GEOMETRY is set.
 
 int relayout_with_constraint(Area *a, int maximum_size);
 // Even distribution of space, not occupied by areas with LAYOUT_FIXED,
@@ -311,6 +321,9 @@ int top_bottom_bg_border_width(Background *bg);
 void schedule_redraw(Area *a);
 // Sets the redraw_needed flag on the area and its descendants
 
+void schedule_resize(Area *a);
+// Sets the resize_needed flag on the area and marks the path to the root for the next relayout
+
 void draw(Area *a);
 // Recreates the Area pixmap and draws the background and the foreground
 
@@ -329,16 +342,51 @@ void show(Area *a);
 
 // Area tree
 
+#define area_num_children(a)  ((a)->children ? (int)(a)->children->len : 0)
+#define area_children_data(a) ((a)->children ? (Area **)(a)->children->pdata : NULL)
+#define area_child(a, i)      ((Area *)g_ptr_array_index((a)->children, (i)))
+
+// Iterates over the children of the Area a, declaring Area *child.
+// The children must not be added or removed in the loop body.
+#define for_children(a, child)                                                          \
+    for (Area **child##_it_ = area_children_data(a),                                    \
+              **child##_end_ = child##_it_ + area_num_children(a), *child;              \
+         child##_it_ != child##_end_ && (child = *child##_it_); child##_it_++)
+
+#define for_children_rev(a, child)                                                      \
+    for (Area **child##_begin_ = area_children_data(a),                                 \
+              **child##_it_ = child##_begin_ + area_num_children(a), *child;            \
+         child##_it_ != child##_begin_ && (child = *--child##_it_); )
+
 void add_area(Area *a, Area *parent);
+void insert_area(Area *a, Area *parent, int index);
+// Like add_area, but the Area is inserted at the given position among the children of the parent.
 void remove_area(Area *a);
 void free_area(Area *a);
 
+void area_append_child(Area *parent, Area *child);
+// Appends the child to the children of parent. Does not set the parent of the child and does not schedule a resize,
+// but the new child is visited by the next relayout.
+
+int area_child_position(Area *parent, Area *child);
+// Returns the position of the child among the children of parent, or -1.
+
+void swap_child_areas(Area *a, Area *b);
+// Exchanges the positions of two children of the same parent.
+
+void sort_child_areas(Area *a, int first, GCompareDataFunc compare, void *data);
+// Stable sort of the children of a, starting at position first. compare receives pointers to the children.
+
 // Mouse events
 
 Area *find_area_under_mouse(void *root, int x, int y);
 // Returns the area under the mouse for the given x, y mouse coordinates relative to the window.
 // If no area is found, returns the root.
 
+Area *find_child_under_mouse(Area *a, int x, int y);
+// Returns the first child of a under the mouse, or NULL.
+// Uses a binary search when the children are indexed (see update_hit_index in area.c).
+
 gboolean area_is_under_mouse(void *obj, int x, int y);
 // Returns true if the Area handles a mouse event at the given x, y coordinates relative to the window.
 
@@ -0,0 +1,199 @@
+/**************************************************************************
+*
+* Tint2 : arena allocators for frame and config scoped data
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "test.h"
+
+#define ARENA_MIN_BLOCK_SIZE 4096
+
+struct ArenaBlock {
+    ArenaBlock *prev;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+Arena frame_arena;
+Arena config_arena;
+
+static ArenaBlock *arena_add_block(Arena *arena, size_t size)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    block->prev = arena->block;
+    block->size = size;
+    block->used = 0;
+    arena->block = block;
+    arena->capacity += size;
+    if (arena->capacity > arena->peak_capacity)
+        arena->peak_capacity = arena->capacity;
+    arena->num_mallocs++;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size_t align = __alignof__(max_align_t);
+    size = (size + align - 1) / align * align;
+    ArenaBlock *block = arena->block;
+    if (!block || block->size - block->used < size) {
+        // Grow geometrically, so that the number of blocks stays logarithmic in the peak usage
+        size_t block_size = arena->capacity > ARENA_MIN_BLOCK_SIZE ? arena->capacity : ARENA_MIN_BLOCK_SIZE;
+        block = arena_add_block(arena, size > block_size ? size : block_size);
+    }
+    void *result = (char *)block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+void *arena_calloc(Arena *arena, size_t size)
+{
+    return memset(arena_alloc(arena, size), 0, size);
+}
+
+char *arena_strdup(Arena *arena, const char *s)
+{
+    size_t len = strlen(s);
+    return memcpy(arena_alloc(arena, len + 1), s, len + 1);
+}
+
+char *arena_printf(Arena *arena, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    char *result = arena_alloc(arena, len + 1);
+    va_start(ap, fmt);
+    vsnprintf(result, len + 1, fmt, ap);
+    va_end(ap);
+    return result;
+}
+
+ArenaMark arena_mark(Arena *arena)
+{
+    return (ArenaMark){ arena->block, arena->block ? arena->block->used : 0 };
+}
+
+void arena_rewind(Arena *arena, ArenaMark mark)
+{
+    // The oldest block is kept even if the arena was empty when the mark was taken
+    while (arena->block && arena->block != mark.block && arena->block->prev) {
+        ArenaBlock *block = arena->block;
+        arena->block = block->prev;
+        arena->capacity -= block->size;
+        free(block);
+    }
+    if (arena->block)
+        arena->block->used = arena->block == mark.block ? mark.used : 0;
+}
+
+void arena_reset(Arena *arena)
+{
+    if (!arena->block)
+        return;
+    if (arena->block->prev || arena->block->size < arena->peak_capacity) {
+        // Replace the blocks by a single one that can hold everything
+        size_t peak_capacity = arena->peak_capacity;
+        arena_free(arena);
+        arena->peak_capacity = peak_capacity;
+        arena_add_block(arena, peak_capacity);
+    }
+    arena->block->used = 0;
+}
+
+void arena_free(Arena *arena)
+{
+    while (arena->block) {
+        ArenaBlock *block = arena->block;
+        arena->block = block->prev;
+        free(block);
+    }
+    arena->capacity = 0;
+    arena->peak_capacity = 0;
+}
+
+static void arena_simulate_frame(Arena *arena)
+{
+    for (int i = 0; i < 1000; i++)
+        arena_printf(arena, "%d %*s", i, i % 97, "");
+}
+
+TEST(arena_reuses_memory_after_reset)
+{
+    Arena arena = {0};
+    arena_simulate_frame(&arena);
+    unsigned long first_frame_mallocs = arena.num_mallocs;
+    ASSERT(first_frame_mallocs > 1);
+    ASSERT(first_frame_mallocs < 20);
+
+    arena_reset(&arena);
+    unsigned long reset_mallocs = arena.num_mallocs;
+    ASSERT_EQUAL(reset_mallocs, first_frame_mallocs + 1);
+
+    // Same workload as the first frame: served from the kept block, no malloc at all
+    test_count_mallocs_start();
+    for (int frame = 0; frame < 10; frame++) {
+        arena_simulate_frame(&arena);
+        arena_reset(&arena);
+    }
+    long process_mallocs = test_count_mallocs_stop();
+    ASSERT_EQUAL(arena.num_mallocs, reset_mallocs);
+    if (process_mallocs >= 0)
+        ASSERT_EQUAL(process_mallocs, 0L);
+    arena_free(&arena);
+}
+
+TEST(arena_alloc_alignment)
+{
+    Arena arena = {0};
+    for (size_t size = 1; size < 100; size++) {
+        char *p = arena_alloc(&arena, size);
+        ASSERT_EQUAL((size_t)p % __alignof__(max_align_t), (size_t)0);
+        memset(p, 0xff, size);
+    }
+    char *big = arena_calloc(&arena, 100000);
+    ASSERT_EQUAL(big[0], 0);
+    ASSERT_EQUAL(big[99999], 0);
+    arena_free(&arena);
+}
+
+TEST(arena_rewind)
+{
+    Arena arena = {0};
+    ArenaMark empty = arena_mark(&arena);
+    char *a = arena_strdup(&arena, "a");
+    ArenaMark mark = arena_mark(&arena);
+    char *b = arena_printf(&arena, "%s%d", "b", 1);
+    ASSERT_STR_EQUAL(b, "b1");
+    arena_calloc(&arena, 10 * ARENA_MIN_BLOCK_SIZE);
+    arena_rewind(&arena, mark);
+    ASSERT_STR_EQUAL(a, "a");
+    ASSERT_EQUAL(arena_printf(&arena, "%s", "c"), b);
+
+    arena_rewind(&arena, empty);
+    unsigned long mallocs = arena.num_mallocs;
+    ASSERT_EQUAL(arena_strdup(&arena, "d"), a);
+    ASSERT_EQUAL(arena.num_mallocs, mallocs);
+    arena_free(&arena);
+}
@@ -0,0 +1,69 @@
+/**************************************************************************
+*
+* Tint2 : arena allocators for frame and config scoped data
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for short-lived allocations.
+// Memory is carved out of large blocks and is never freed individually; the whole arena is released at once.
+// After a reset the memory is kept in a single block, so a steady workload does not call malloc at all.
+// A zero-initialized Arena is empty and ready to use.
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock *block;          // Current block, linked to the previous ones
+    size_t capacity;            // Total size of the blocks
+    size_t peak_capacity;       // Used to size the block kept after a reset
+    unsigned long num_mallocs;  // Number of blocks allocated since the arena was created
+} Arena;
+
+typedef struct ArenaMark {
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
+
+extern Arena frame_arena;
+// Reset after each panel refresh. Allocations must not be kept across iterations of the event loop.
+
+extern Arena config_arena;
+// Reset after the config is read. For the temporary data of config parsing.
+
+void *arena_alloc(Arena *arena, size_t size);
+// Returns memory suitably aligned for any type.
+
+void *arena_calloc(Arena *arena, size_t size);
+
+char *arena_strdup(Arena *arena, const char *s);
+
+char *arena_printf(Arena *arena, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+ArenaMark arena_mark(Arena *arena);
+
+void arena_rewind(Arena *arena, ArenaMark mark);
+// Releases the allocations made after the mark was taken.
+// For code that also runs outside of the event loop (e.g. in tint2conf) and cannot rely on the reset.
+
+void arena_reset(Arena *arena);
+// Releases all the allocations.
+
+void arena_free(Arena *arena);
+// Releases all the allocations and the memory, but not the object.
+
+#endif
@@ -32,6 +32,7 @@
 #include <glib/gstdio.h>
 #include "common.h"
 #include "server.h"
+#include "text-shadow.h"
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <pwd.h>
@@ -53,7 +54,9 @@
 #include "signals.h"
 #include "bt.h"
 #include "strnatcmp.h"
+#include "launch.h"
 #include "common.h"
+#include "test.h"
 
 const char *home_dir = NULL;
 size_t home_dir_len = 0;
@@ -382,54 +385,48 @@ pid_t tint_exec(const char *command,
         sn_launcher_context_set_binary_name(ctx, command);
         sn_launcher_context_initiate(ctx, "tint2", command, time);
     }
+    // The child inherits the environment at spawn time
+    if (ctx)
+        setenv("DESKTOP_STARTUP_ID", sn_launcher_context_get_startup_id(ctx), 1);
 #endif /* HAVE_SN */
-    pid_t pid;
-    pid = fork();
-    if (pid < 0)
-        fprintf(stderr, "tint2: Could not fork\n");
-    else if (pid == 0) {
-// Child process
-#if HAVE_SN
-        if (startup_notifications && startup_notification && time)
-            sn_launcher_context_setup_child_process(ctx);
-#endif // HAVE_SN
-        // Allow children to exist after parent destruction
-        setsid();
-        // Run the command
-        if (dir)
-            if (chdir(dir) != 0)
-                fprintf(stderr, "tint2: failed to chdir to %s\n", dir);
-        close_all_fds();
-        reset_signals();
-        if (terminal) {
+    // Children run in their own session, so that they outlive tint2
+    pid_t pid = -1;
+    if (terminal) {
 #if !defined(__OpenBSD__)
-            fprintf(stderr, "tint2: executing in x-terminal-emulator: %s\n", command);
-            wordexp_t words;
-            words.we_offs = 2;
-            if (wordexp(command, &words, WRDE_DOOFFS | WRDE_SHOWERR) == 0) {
-                words.we_wordv[0] = (char *)"x-terminal-emulator";
-                words.we_wordv[1] = (char *)"-e";
-                execvp("x-terminal-emulator", words.we_wordv);
-            }
+        fprintf(stderr, "tint2: executing in x-terminal-emulator: %s\n", command);
+        // Command substitution would run a shell inside tint2, leave that to sh -c
+        wordexp_t words;
+        words.we_offs = 2;
+        int ret = wordexp(command, &words, WRDE_DOOFFS | WRDE_NOCMD | WRDE_SHOWERR);
+        if (ret == 0) {
+            words.we_wordv[0] = (char *)"x-terminal-emulator";
+            words.we_wordv[1] = (char *)"-e";
+            pid = spawn_process("x-terminal-emulator", words.we_wordv, dir, NULL, TRUE);
+            wordfree(&words);
+        } else if (ret == WRDE_CMDSUB) {
+            char *argv[] = {"x-terminal-emulator", "-e", "/bin/sh", "-c", (char *)command, NULL};
+            pid = spawn_process("x-terminal-emulator", argv, dir, NULL, TRUE);
+        }
 #endif
+        if (pid < 0)
             fprintf(stderr,
                     "tint2: could not execute command in x-terminal-emulator: %s, executting in shell\n",
                     command);
-        }
-        execlp("sh", "sh", "-c", command, NULL);
-        fprintf(stderr, "tint2: Failed to execute %s\n", command);
+    }
+    if (pid < 0)
+        pid = spawn_shell_command(command, dir, NULL, TRUE);
+    if (pid < 0)
+        fprintf(stderr, "tint2: Failed to execute %s: %s\n", command, strerror(errno));
 #if HAVE_SN
-        if (startup_notifications && startup_notification && time)
+    if (ctx) {
+        unsetenv("DESKTOP_STARTUP_ID");
+        if (pid < 0) {
+            sn_launcher_context_complete(ctx);
             sn_launcher_context_unref(ctx);
-#endif // HAVE_SN
-        _exit(1);
-    } else {
-// Parent process
-#if HAVE_SN
-        if (startup_notifications && startup_notification && time)
+        } else
             g_tree_insert(server.pids, GINT_TO_POINTER(pid), ctx);
-#endif // HAVE_SN
     }
+#endif // HAVE_SN
 
     unsetenv("TINT2_CONFIG");
     unsetenv("TINT2_BUTTON_X");
@@ -730,30 +727,10 @@ gboolean layout_set_markup_strip_colors(PangoLayout *layout, const char *markup)
     return TRUE;
 }
 
-void draw_shadow(cairo_t *c, int posx, int posy, PangoLayout *shadow_layout)
-{
-    const int shadow_size = 3;
-    const double shadow_edge_alpha = 0.0;
-    int i, j;
-    for (i = -shadow_size; i <= shadow_size; i++) {
-        for (j = -shadow_size; j <= shadow_size; j++)
-        {
-            double r = sqrt(i*i + j*j);
-            if (r <= 0) continue;
-            cairo_set_source_rgba(c,
-                                  0.0, 0.0, 0.0,
-                                  1.0 - (1.0 - shadow_edge_alpha) * r / shadow_size);
-            pango_cairo_update_layout(c, shadow_layout);
-            cairo_move_to(c, posx + i, posy + j);
-            pango_cairo_show_layout(c, shadow_layout);
-        }
-    }
-}
-
 void draw_text(PangoLayout *layout, cairo_t *c, int posx, int posy, Color *color, PangoLayout *shadow_layout)
 {
     if (shadow_layout)
-        draw_shadow(c, posx, posy, shadow_layout);
+        draw_text_shadow(c, posx, posy, shadow_layout);
     cairo_set_source_rgba(c, color->rgb[0], color->rgb[1], color->rgb[2], color->alpha);
     pango_cairo_update_layout(c, layout);
     cairo_move_to(c, posx, posy);
@@ -1102,13 +1079,6 @@ gint cmp_ptr(gconstpointer a, gconstpointer b)
     return a < b ? -1 : a != b;
 }
 
-void close_all_fds()
-{
-    long maxfd = sysconf(_SC_OPEN_MAX);
-    for (int fd = 3; fd < maxfd; fd++)
-        close(fd);
-}
-
 GString *tint2_g_string_replace(GString *s, const char *from, const char *to)
 {
     GString *result = g_string_new("");
@@ -1256,3 +1226,44 @@ void dump_image_data(const char *image_file, const char *name)
 
     imlib_free_image();
 }
+
+BENCH(adjust_asb)
+{
+    // A 64x64 icon, adjusted like for the default mouse over effect
+    const int size = 64;
+    DATA32 *data = calloc(size * size, sizeof(DATA32));
+    for (int i = 0; i < size * size; i++)
+        data[i] = 0xff000000u | (i * 2654435761u >> 8);
+    BENCH_LOOP
+        adjust_asb(data, size, size, 1.0f, 0.0f, 0.1f);
+    free(data);
+}
+
+BENCH(get_text_size2)
+{
+    server.display = XOpenDisplay(NULL);
+    if (!server.display)
+        BENCH_SKIP("no X display");
+    server.root_win = DefaultRootWindow(server.display);
+    server.depth = DefaultDepth(server.display, DefaultScreen(server.display));
+    server.visual = DefaultVisual(server.display, DefaultScreen(server.display));
+    PangoFontDescription *font = pango_font_description_from_string("sans 10");
+    const char *text = "tint2 - Mozilla Firefox";
+    int height, width;
+    BENCH_LOOP
+        get_text_size2(font,
+                       &height,
+                       &width,
+                       30,
+                       150,
+                       text,
+                       strlen(text),
+                       PANGO_WRAP_WORD_CHAR,
+                       PANGO_ELLIPSIZE_END,
+                       PANGO_ALIGN_LEFT,
+                       FALSE,
+                       1.0);
+    pango_font_description_free(font);
+    XCloseDisplay(server.display);
+    server.display = NULL;
+}
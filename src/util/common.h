@@ -267,8 +267,6 @@ void draw_rect(cairo_t *c, double x, double y, double w, double h, double r, int
 void clear_pixmap(Pixmap p, int x, int y, int w, int h);
 // Clears the pixmap (with transparent color)
 
-void close_all_fds();
-
 GSList *load_locations_from_dir(GSList *locations, const char *dir, ...);
 GSList *load_locations_from_env(GSList *locations, const char *var, ...);
 
@@ -0,0 +1,204 @@
+/**************************************************************************
+*
+* Tint2 : process creation
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+// For POSIX_SPAWN_SETSID and POSIX_SPAWN_USEVFORK
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+
+#include "launch.h"
+#include "timer.h"
+
+extern char **environ;
+
+static pid_t spawn_in_dir(const char *file, char *const argv[], const char *dir, const int child_fds[3], gboolean new_session)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    if (child_fds)
+        for (int i = 0; i < 3; i++)
+            if (child_fds[i] >= 0)
+                posix_spawn_file_actions_adddup2(&actions, child_fds[i], i);
+#ifdef HAVE_POSIX_SPAWN_ADDCLOSEFROM
+    posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+#endif
+#ifdef HAVE_POSIX_SPAWN_ADDCHDIR
+    if (dir)
+        posix_spawn_file_actions_addchdir_np(&actions, dir);
+#endif
+
+    // Same as reset_signals(), which cannot run in the child anymore
+    sigset_t sigdefault, sigmask;
+    sigemptyset(&sigdefault);
+    for (int sig = 1; sig < 32; sig++)
+        if (sig != SIGKILL && sig != SIGSTOP)
+            sigaddset(&sigdefault, sig);
+    sigemptyset(&sigmask);
+    posix_spawnattr_setsigdefault(&attr, &sigdefault);
+    posix_spawnattr_setsigmask(&attr, &sigmask);
+
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_USEVFORK
+    // Only needed by old glibc versions, newer ones always use clone(CLONE_VM | CLONE_VFORK)
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+#ifdef POSIX_SPAWN_SETSID
+    if (new_session)
+        flags |= POSIX_SPAWN_SETSID;
+    else
+#endif
+    {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, file, &actions, &attr, argv, environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return pid;
+}
+
+pid_t spawn_process(const char *file, char *const argv[], const char *dir, const int child_fds[3], gboolean new_session)
+{
+    if (!dir)
+        return spawn_in_dir(file, argv, NULL, child_fds, new_session);
+
+#ifdef HAVE_POSIX_SPAWN_ADDCHDIR
+    pid_t pid = spawn_in_dir(file, argv, dir, child_fds, new_session);
+    if (pid < 0 && !g_file_test(dir, G_FILE_TEST_IS_DIR)) {
+        fprintf(stderr, "tint2: failed to chdir to %s\n", dir);
+        pid = spawn_in_dir(file, argv, NULL, child_fds, new_session);
+    }
+    return pid;
+#else
+    // Let a shell enter the directory, then replace itself with the command
+    size_t argc = 0;
+    while (argv[argc])
+        argc++;
+    char **wrapped = calloc(argc + 5, sizeof(char *));
+    wrapped[0] = (char *)"/bin/sh";
+    wrapped[1] = (char *)"-c";
+    wrapped[2] = (char *)"cd -- \"$0\" || echo \"tint2: failed to chdir to $0\" >&2; exec \"$@\"";
+    wrapped[3] = (char *)dir;
+    memcpy(wrapped + 4, argv, (argc + 1) * sizeof(char *));
+    pid_t pid = spawn_in_dir("/bin/sh", wrapped, NULL, child_fds, new_session);
+    free(wrapped);
+    return pid;
+#endif
+}
+
+pid_t spawn_shell_command(const char *command, const char *dir, const int child_fds[3], gboolean new_session)
+{
+    char *argv[] = {(char *)"/bin/sh", (char *)"-c", (char *)command, NULL};
+    return spawn_process("/bin/sh", argv, dir, child_fds, new_session);
+}
+
+int pipe_cloexec(int pipefd[2])
+{
+    if (pipe(pipefd) != 0)
+        return -1;
+    // tint2 is single threaded, so no other thread can spawn a child in between
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+static long bench_spawn_rss_kb()
+{
+    long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%*d %ld", &pages) != 1)
+            pages = 0;
+        fclose(f);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static double bench_spawn_fork(int iterations)
+{
+    double start = get_time();
+    for (int i = 0; i < iterations; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            execl("/bin/true", "/bin/true", NULL);
+            _exit(127);
+        }
+        if (pid > 0)
+            waitpid(pid, NULL, 0);
+    }
+    return (get_time() - start) / iterations;
+}
+
+static double bench_spawn_posix_spawn(int iterations)
+{
+    char *argv[] = {(char *)"/bin/true", NULL};
+    double start = get_time();
+    for (int i = 0; i < iterations; i++) {
+        pid_t pid = spawn_process("/bin/true", argv, NULL, NULL, FALSE);
+        if (pid > 0)
+            waitpid(pid, NULL, 0);
+    }
+    return (get_time() - start) / iterations;
+}
+
+void bench_spawn()
+{
+    // tint2 normally ignores SIGCHLD, which makes waitpid fail
+    signal(SIGCHLD, SIG_DFL);
+
+    const int iterations = 200;
+    const size_t steps_mb[] = {0, 64, 256, 1024};
+    char *ballast = NULL;
+    fprintf(stdout, "%10s %14s %14s\n", "RSS (MB)", "fork (us)", "spawn (us)");
+    for (size_t i = 0; i < sizeof(steps_mb) / sizeof(steps_mb[0]); i++) {
+        // Grow the resident set by touching every page
+        if (steps_mb[i]) {
+            free(ballast);
+            ballast = malloc(steps_mb[i] << 20);
+            if (!ballast)
+                break;
+            memset(ballast, 1, steps_mb[i] << 20);
+        }
+        double t_fork = bench_spawn_fork(iterations);
+        double t_spawn = bench_spawn_posix_spawn(iterations);
+        fprintf(stdout, "%10ld %14.1f %14.1f\n", bench_spawn_rss_kb() / 1024, t_fork * 1e6, t_spawn * 1e6);
+    }
+    free(ballast);
+}
@@ -0,0 +1,34 @@
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+#include <glib.h>
+#include <sys/types.h>
+
+// Process creation helpers built on posix_spawn, which (unlike fork) does not copy
+// the page tables of tint2, so the cost of launching a command does not grow with
+// the memory used by the panel (cached icons, pixmaps, fonts).
+//
+// There is no code running in the child between fork and exec, so every descriptor
+// tint2 owns must be created close-on-exec (pipe_cloexec, SOCK_CLOEXEC, O_CLOEXEC);
+// where the C library supports it, descriptors above stderr are closed as well.
+
+pid_t spawn_process(const char *file, char *const argv[], const char *dir, const int child_fds[3], gboolean new_session);
+// Executes file (searched in PATH) with the arguments argv and the current environment.
+// dir: working directory of the child, or NULL to inherit the current one.
+// child_fds: descriptors that become stdin, stdout and stderr of the child, -1 to inherit; may be NULL.
+// new_session: start the child in a new session, so that it outlives tint2;
+// otherwise it is started in a new process group.
+// Signal dispositions and the signal mask are reset to the defaults in the child.
+// Returns the pid of the child, or -1 with errno set on failure.
+
+pid_t spawn_shell_command(const char *command, const char *dir, const int child_fds[3], gboolean new_session);
+// Same as spawn_process, but runs command with /bin/sh -c.
+// If dir cannot be entered, the command is run in the current directory.
+
+int pipe_cloexec(int pipefd[2]);
+// Same as pipe(), but both ends are close-on-exec.
+
+void bench_spawn();
+// Prints the latency of fork + exec and of posix_spawn for increasing resident set sizes.
+
+#endif
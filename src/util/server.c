@@ -158,14 +158,8 @@ void cleanup_server()
     if (server.colormap32)
         XFreeColormap(server.display, server.colormap32);
     server.colormap32 = 0;
-    if (server.monitors) {
-        for (int i = 0; i < server.num_monitors; ++i)
-        {
-            g_strfreev(server.monitors[i].names);
-            server.monitors[i].names = NULL;
-        }
-        free_and_null( server.monitors);
-    }
+    free_monitors(server.monitors, server.num_monitors);
+    server.monitors = NULL;
     if (server.gc)
         XFreeGC(server.display, server.gc);
     server.gc = NULL;
@@ -418,6 +412,33 @@ void get_monitors()
     }
 }
 
+void free_monitors(Monitor *monitors, int num_monitors)
+{
+    if (!monitors)
+        return;
+    for (int i = 0; i < num_monitors; ++i)
+        g_strfreev(monitors[i].names);
+    free(monitors);
+}
+
+gboolean monitors_same_outputs(const Monitor *a, const Monitor *b)
+{
+    if (!a->names || !b->names)
+        return TRUE;
+    int i;
+    for (i = 0; a->names[i] && b->names[i]; i++)
+        if (strcmp(a->names[i], b->names[i]) != 0)
+            return FALSE;
+    return !a->names[i] && !b->names[i];
+}
+
+gboolean monitors_equal(const Monitor *a, const Monitor *b)
+{
+    return a->x == b->x && a->y == b->y && a->width == b->width && a->height == b->height &&
+           a->dpi == b->dpi && a->primary == b->primary && (!a->names) == (!b->names) &&
+           monitors_same_outputs(a, b);
+}
+
 void print_monitors()
 {
     fprintf(stderr, "tint2: Number of monitors: %d\n", server.num_monitors);
@@ -193,6 +193,11 @@ void get_root_pixmap();
 void get_monitors();
 // detect monitors and desktops
 
+void free_monitors(Monitor *monitors, int num_monitors);
+gboolean monitors_equal(const Monitor *a, const Monitor *b);
+gboolean monitors_same_outputs(const Monitor *a, const Monitor *b);
+// Compares the output names, TRUE if xrandr can't identify the monitors
+
 void sort_monitors();
 void print_monitors();
 void get_desktops();
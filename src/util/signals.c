@@ -17,6 +17,7 @@
 #include "launcher.h"
 #include "server.h"
 #include "signals.h"
+#include "launch.h"
 
 static sig_atomic_t signal_pending;
 
@@ -136,7 +137,7 @@ void init_signals_postconfig()
 
     if (need_sigchld) {
         // Setup a handler for child termination
-        if (pipe(sigchild_pipe) != 0) {
+        if (pipe_cloexec(sigchild_pipe) != 0) {
             fprintf(stderr, "tint2: Creating pipe failed.\n");
         } else {
             fcntl(sigchild_pipe[0], F_SETFL, O_NONBLOCK | fcntl(sigchild_pipe[0], F_GETFL));
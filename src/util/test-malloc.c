@@ -0,0 +1,69 @@
+/**************************************************************************
+*
+* Tint2 : allocation counting for the self-tests
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+// Linked only into tint2-tests, never into the installed programs: it replaces malloc, calloc and realloc
+// of the process, which would conflict with an allocator loaded with LD_PRELOAD.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static bool counting_mallocs = false;
+static unsigned long num_mallocs = 0;
+
+void *malloc(size_t size)
+{
+    if (counting_mallocs)
+        num_mallocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    if (counting_mallocs)
+        num_mallocs++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (counting_mallocs)
+        num_mallocs++;
+    return __libc_realloc(ptr, size);
+}
+
+void test_count_mallocs_start()
+{
+    num_mallocs = 0;
+    counting_mallocs = true;
+}
+
+long test_count_mallocs_stop()
+{
+    counting_mallocs = false;
+    return (long)num_mallocs;
+}
+
+#endif
@@ -1,8 +1,10 @@
 #include <fcntl.h>
+#include <signal.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -22,6 +24,16 @@ typedef struct TestListItem {
 
 static GList *all_tests = NULL;
 
+// Allocations are only counted by tint2-tests, which links test-malloc.c; these are the fallbacks of tint2 itself
+__attribute__((weak)) void test_count_mallocs_start()
+{
+}
+
+__attribute__((weak)) long test_count_mallocs_stop()
+{
+    return -1;
+}
+
 void register_test_(Test *test, const char *name)
 {
     TestListItem *item = calloc(sizeof(TestListItem), 1);
@@ -35,9 +47,9 @@ static char *test_log_name_from_test_name(const char *test_name)
     return strdup_printf( NULL, "test_%s.log", test_name);
 }
 
-static void redirect_test_output(const char *test_name)
+static void redirect_output(char *output_name)
+// Takes ownership of output_name
 {
-    char *output_name = test_log_name_from_test_name(test_name);
     int fd = open(output_name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
     if (fd == -1)
         goto err;
@@ -56,6 +68,11 @@ err:
     free(output_name);
 }
 
+static void redirect_test_output(const char *test_name)
+{
+    redirect_output(test_log_name_from_test_name(test_name));
+}
+
 static void crash(int sig)
 {
     kill(getpid(), SIGSEGV);
@@ -80,88 +97,420 @@ static FILE *open_test_log(const char *test_name)
     return log;
 }
 
-static Status run_test_parent(TestListItem *item, pid_t child)
+#define TEST_TIMEOUT 10  // seconds, unless overridden by TEST_TIMEOUT in the environment
+#define TEST_NUM_SLOWEST 5
+
+typedef struct TestRun {
+    TestListItem *item;
+    pid_t pid;
+    double start_time;
+    double duration;
+    bool timed_out;
+    Status status;
+} TestRun;
+
+static double test_get_time()
+// Not get_time(), which the timer tests can mock
 {
-    FILE *log = open_test_log(item->name);
-    if (child == -1) {
-        fprintf(log, "\n" "Test failed, fork failed\n");
-        fclose(log);
-        return FAILURE;
-    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int env_int(const char *name, int default_value)
+{
+    const char *s = getenv(name);
+    int value = s ? atoi(s) : 0;
+    return value > 0 ? value : default_value;
+}
 
-    int child_status;
-    pid_t ret_pid = waitpid(child, &child_status, 0);
-    if (ret_pid != child) {
-        fprintf(log, "\n" "Test failed, waitpid failed\n");
-        fclose(log);
+static void start_test(TestRun *run)
+{
+    // Otherwise the child would write the buffered output again into its log
+    fflush(stdout);
+    fflush(stderr);
+    run->start_time = test_get_time();
+    run->pid = fork();
+    if (run->pid == 0)
+        run_test_child(run->item);
+}
+
+static Status finish_test(TestRun *run, int child_status)
+// Appends the outcome and the wall time to the test log
+{
+    run->duration = test_get_time() - run->start_time;
+    FILE *log = open_test_log(run->item->name);
+    if (!log)
         return FAILURE;
-    }
-    if (WIFEXITED(child_status)) {
+    Status status = FAILURE;
+    if (run->pid == -1) {
+        fprintf(log, "\n" "Test failed, fork failed\n");
+    } else if (run->timed_out) {
+        fprintf(log, "\n" "Test failed, killed after timeout.\n");
+    } else if (WIFEXITED(child_status)) {
         int exit_status = WEXITSTATUS(child_status);
         if (exit_status == EXIT_SUCCESS) {
             fprintf(log, "\n" "Test succeeded.\n");
-            fclose(log);
-            return SUCCESS;
+            status = SUCCESS;
         } else {
             fprintf(log, "\n" "Test failed, exit status: %d.\n", exit_status);
-            fclose(log);
-            return FAILURE;
         }
     } else if (WIFSIGNALED(child_status)) {
-        int signal = WTERMSIG(child_status);
-        fprintf(log, "\n" "Test failed, child killed by signal: %d.\n", signal);
-        fclose(log);
-        return FAILURE;
+        fprintf(log, "\n" "Test failed, child killed by signal: %d.\n", WTERMSIG(child_status));
     } else {
         fprintf(log, "\n" "Test failed, waitpid failed.\n");
-        fclose(log);
-        return FAILURE;
     }
+    fprintf(log, "Wall time: %.3f s\n", run->duration);
+    fclose(log);
+    return status;
 }
 
-static Status run_test(TestListItem *item)
+static void print_test_result(TestRun *run, bool verbose)
 {
-    pid_t pid = fork();
-    if (pid == 0)
-        run_test_child(item);
-    sigaction(SIGINT, &(sigaction_t){.sa_handler = SIG_IGN}, NULL);
-    return run_test_parent(item, pid);
+    fprintf(stdout, BLUE "tint2: Test " YELLOW "%s" BLUE ": ", run->item->name);
+    if (run->status == SUCCESS) {
+        fprintf(stdout, GREEN "succeeded" RESET "\n");
+        return;
+    }
+    fprintf(stdout, RED "%s" RESET "\n", run->timed_out ? "timed out" : "failed");
+    if (verbose) {
+        char *log_name = test_log_name_from_test_name(run->item->name);
+        FILE *log = fopen(log_name, "rt");
+        if (log) {
+            char buffer[4096];
+            size_t num_read;
+            while ((num_read = fread(buffer, 1, sizeof(buffer), log)) > 0) {
+                fwrite(buffer, 1, num_read, stdout);
+            }
+            fclose(log);
+        }
+        free(log_name);
+    }
+}
+
+static int compare_test_durations(const void *a, const void *b)
+{
+    double x = (*(TestRun *const *)a)->duration, y = (*(TestRun *const *)b)->duration;
+    return (x < y) - (x > y);
 }
 
 void run_all_tests(bool verbose)
 {
-    fprintf(stdout, BLUE "tint2: Running %d tests..." RESET "\n", g_list_length(all_tests));
-    size_t count = 0, succeeded = 0, failed = 0;
-    for (GList *l = all_tests; l; l = l->next) {
-        TestListItem *item = l->data;
-        Status status = run_test(item);
-        count++;
-        fprintf(stdout, BLUE "tint2: Test " YELLOW "%s" BLUE ": ", item->name);
-        if (status == SUCCESS) {
-            fprintf(stdout, GREEN "succeeded" RESET "\n");
-            succeeded++;
-        } else {
-            fprintf(stdout, RED "failed" RESET "\n");
-            failed++;
-            if (verbose) {
-                char *log_name = test_log_name_from_test_name(item->name);
-                FILE *log = fopen(log_name, "rt");
-                if (log) {
-                    char buffer[4096];
-                    size_t num_read;
-                    while ((num_read = fread(buffer, 1, sizeof(buffer), log)) > 0) {
-                        fwrite(buffer, 1, num_read, stdout);
-                    }
-                    fclose(log);
-                }
-                free(log_name);
+    size_t count = g_list_length(all_tests);
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_jobs = env_int("TEST_JOBS", num_cpus > 0 ? (int)num_cpus : 1);
+    int timeout = env_int("TEST_TIMEOUT", TEST_TIMEOUT);
+    fprintf(stdout,
+            BLUE "tint2: Running %zu tests, %d at a time, timeout %d s..." RESET "\n",
+            count,
+            max_jobs,
+            timeout);
+
+    TestRun *runs = calloc(count, sizeof(TestRun));
+    TestRun **running = calloc(max_jobs, sizeof(TestRun *));
+    size_t i = 0;
+    for (GList *l = all_tests; l; l = l->next)
+        runs[i++].item = l->data;
+
+    // SIGCHLD is blocked so that we can wait for it with a timeout; the children unblock it in reset_signals()
+    sigset_t sigchld_set, old_set;
+    sigemptyset(&sigchld_set);
+    sigaddset(&sigchld_set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &sigchld_set, &old_set);
+    sigaction(SIGINT, &(sigaction_t){.sa_handler = SIG_IGN}, NULL);
+
+    size_t next = 0, done = 0, failed = 0;
+    int num_running = 0;
+    while (done < count) {
+        while (num_running < max_jobs && next < count) {
+            TestRun *run = &runs[next++];
+            start_test(run);
+            if (run->pid == -1) {
+                run->status = finish_test(run, 0);
+                print_test_result(run, verbose);
+                done++;
+                failed++;
+                continue;
+            }
+            running[num_running++] = run;
+        }
+
+        double now = test_get_time();
+        double next_deadline = now + timeout;
+        for (int j = 0; j < num_running;) {
+            TestRun *run = running[j];
+            int child_status;
+            if (waitpid(run->pid, &child_status, WNOHANG) == run->pid) {
+                run->status = finish_test(run, child_status);
+                print_test_result(run, verbose);
+                done++;
+                if (run->status != SUCCESS)
+                    failed++;
+                running[j] = running[--num_running];
+                continue;
+            }
+            double deadline = run->start_time + timeout;
+            if (now >= deadline && !run->timed_out) {
+                run->timed_out = true;
+                kill(run->pid, SIGKILL);
+            } else if (deadline < next_deadline) {
+                next_deadline = deadline;
             }
+            j++;
         }
+        if (num_running == 0 || (num_running < max_jobs && next < count))
+            continue;
+
+        // Sleep until a child exits or the next test times out
+        double wait = MAX(next_deadline - now, 0.001);
+        struct timespec wait_ts = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+        sigtimedwait(&sigchld_set, NULL, &wait_ts);
     }
+
+    sigprocmask(SIG_SETMASK, &old_set, NULL);
+
     if (failed == 0)
         fprintf(stdout, BLUE "tint2: " GREEN "all %zu tests succeeded." RESET "\n", count);
     else
         fprintf(stdout, BLUE "tint2: " RED "%zu" BLUE " out of %zu tests " RED "failed." RESET "\n", failed, count);
+
+    TestRun **by_duration = calloc(count, sizeof(TestRun *));
+    for (i = 0; i < count; i++)
+        by_duration[i] = &runs[i];
+    qsort(by_duration, count, sizeof(TestRun *), compare_test_durations);
+    if (count > 0)
+        fprintf(stdout, BLUE "tint2: Slowest tests:" RESET "\n");
+    for (i = 0; i < count && i < TEST_NUM_SLOWEST; i++)
+        fprintf(stdout, "tint2:   %8.3f s  %s\n", by_duration[i]->duration, by_duration[i]->item->name);
+    free(by_duration);
+    free(running);
+    free(runs);
+}
+
+#define BENCH_WARMUP_TIME 0.05       // seconds
+#define BENCH_MIN_SAMPLE_TIME 0.002  // a sample runs as many iterations as needed to last this long
+#define BENCH_MAX_SAMPLES 50
+#define BENCH_MAX_TIME 2.0           // limits the sampling of slow benchmarks
+
+typedef enum BenchPhase {
+    BENCH_START = 0,
+    BENCH_WARMUP,
+    BENCH_SAMPLING,
+    BENCH_DONE,
+} BenchPhase;
+
+struct BenchState {
+    BenchPhase phase;
+    long batch;                         // iterations per sample
+    long left;                          // iterations left in the current sample
+    long iterations;                    // sampled iterations
+    double phase_start;
+    double sample_start;
+    int num_samples;
+    double samples[BENCH_MAX_SAMPLES];  // seconds per iteration
+    char skip_reason[128];
+};
+
+typedef struct BenchListItem {
+    Bench *bench;
+    const char *name;
+} BenchListItem;
+
+static GList *all_benchmarks = NULL;
+
+void register_bench_(Bench *bench, const char *name)
+{
+    BenchListItem *item = calloc(sizeof(BenchListItem), 1);
+    item->bench = bench;
+    item->name = name;
+    all_benchmarks = g_list_append(all_benchmarks, item);
+}
+
+static double bench_get_time()
+// Not get_time(), which the timer tests can mock
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool bench_iterate_(BenchState *state)
+{
+    if (state->left > 0) {
+        state->left--;
+        return true;
+    }
+    double now = bench_get_time();
+    switch (state->phase) {
+    case BENCH_START:
+        state->phase = BENCH_WARMUP;
+        state->phase_start = now;
+        state->batch = 1;
+        break;
+    case BENCH_WARMUP:
+        // Double the batch until a sample is long enough to be measured accurately
+        if (now - state->sample_start < BENCH_MIN_SAMPLE_TIME) {
+            state->batch *= 2;
+        } else if (now - state->phase_start >= BENCH_WARMUP_TIME) {
+            state->phase = BENCH_SAMPLING;
+            state->phase_start = now;
+        }
+        break;
+    case BENCH_SAMPLING:
+        state->samples[state->num_samples++] = (now - state->sample_start) / state->batch;
+        state->iterations += state->batch;
+        if (state->num_samples == BENCH_MAX_SAMPLES || now - state->phase_start >= BENCH_MAX_TIME) {
+            state->phase = BENCH_DONE;
+            return false;
+        }
+        break;
+    case BENCH_DONE:
+        return false;
+    }
+    state->left = state->batch - 1;
+    state->sample_start = bench_get_time();
+    return true;
+}
+
+void bench_skip_(BenchState *state, const char *reason)
+{
+    snprintf(state->skip_reason, sizeof(state->skip_reason), "%s", reason);
+}
+
+__attribute__((noreturn))
+static void run_bench_child(BenchListItem *item, int fd)
+{
+    reset_signals();
+    redirect_output(strdup_printf(NULL, "bench_%s.log", item->name));
+    BenchState state;
+    memset(&state, 0, sizeof(state));
+    item->bench(&state);
+    ssize_t ret = write(fd, &state, sizeof(state));
+    _exit(ret == sizeof(state) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static Status run_bench(BenchListItem *item, BenchState *state)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return FAILURE;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        run_bench_child(item, fds[1]);
+    }
+    close(fds[1]);
+    // The state is smaller than PIPE_BUF, so it is written at once
+    ssize_t ret = pid > 0 ? read(fds[0], state, sizeof(*state)) : -1;
+    close(fds[0]);
+    if (pid > 0)
+        waitpid(pid, NULL, 0);
+    return ret == sizeof(*state) ? SUCCESS : FAILURE;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, int p)
+// Nearest-rank method
+{
+    int rank = (p * n + 99) / 100;
+    return sorted[MAX(rank, 1) - 1];
+}
+
+static void format_duration(char *buf, size_t size, double seconds)
+{
+    if (seconds < 1e-6)
+        snprintf(buf, size, "%.1f ns", seconds * 1e9);
+    else if (seconds < 1e-3)
+        snprintf(buf, size, "%.2f us", seconds * 1e6);
+    else
+        snprintf(buf, size, "%.2f ms", seconds * 1e3);
+}
+
+void run_all_benchmarks(const char *filter)
+{
+    FILE *json = fopen("bench.json", "w");
+    if (json)
+        fprintf(json, "{\n  \"benchmarks\": [");
+    size_t count = 0, failed = 0;
+    for (GList *l = all_benchmarks; l; l = l->next) {
+        BenchListItem *item = l->data;
+        if (filter && !strstr(item->name, filter))
+            continue;
+        BenchState state;
+        Status status = run_bench(item, &state);
+        fprintf(stdout, BLUE "tint2: Bench " YELLOW "%s" BLUE ": ", item->name);
+        if (json)
+            fprintf(json, "%s\n    {\"name\": \"%s\", ", count ? "," : "", item->name);
+        count++;
+        if (status != SUCCESS || (state.num_samples == 0 && !state.skip_reason[0])) {
+            fprintf(stdout, RED "failed" RESET "\n");
+            if (json)
+                fprintf(json, "\"failed\": true}");
+            failed++;
+        } else if (state.skip_reason[0]) {
+            fprintf(stdout, YELLOW "skipped" RESET " (%s)\n", state.skip_reason);
+            if (json)
+                fprintf(json, "\"skipped\": \"%s\"}", state.skip_reason);
+        } else {
+            qsort(state.samples, state.num_samples, sizeof(state.samples[0]), compare_doubles);
+            double median = percentile(state.samples, state.num_samples, 50);
+            double p95 = percentile(state.samples, state.num_samples, 95);
+            char median_str[32], p95_str[32];
+            format_duration(median_str, sizeof(median_str), median);
+            format_duration(p95_str, sizeof(p95_str), p95);
+            fprintf(stdout,
+                    GREEN "median %s" RESET ", p95 %s, %ld iterations\n",
+                    median_str,
+                    p95_str,
+                    state.iterations);
+            if (json)
+                fprintf(json,
+                        "\"iterations\": %ld, \"samples\": %d, "
+                        "\"median_ns\": %.1f, \"p95_ns\": %.1f, \"min_ns\": %.1f}",
+                        state.iterations,
+                        state.num_samples,
+                        median * 1e9,
+                        p95 * 1e9,
+                        state.samples[0] * 1e9);
+        }
+    }
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+    if (failed == 0)
+        fprintf(stdout, BLUE "tint2: %zu benchmarks done, results in bench.json" RESET "\n", count);
+    else
+        fprintf(stdout, BLUE "tint2: " RED "%zu" BLUE " out of %zu benchmarks " RED "failed." RESET "\n", failed, count);
+}
+
+TEST(bench_percentile)
+{
+    double samples[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
+    ASSERT_EQUAL(percentile(samples, 20, 50), 10.0);
+    ASSERT_EQUAL(percentile(samples, 20, 95), 19.0);
+    ASSERT_EQUAL(percentile(samples, 1, 95), 1.0);
+    ASSERT_EQUAL(percentile(samples, 3, 50), 2.0);
+}
+
+TEST(bench_iterate_samples)
+{
+    BenchState state;
+    memset(&state, 0, sizeof(state));
+    long runs = 0;
+    while (bench_iterate_(&state))
+        runs++;
+    ASSERT_EQUAL(state.phase, BENCH_DONE);
+    ASSERT(state.num_samples > 0);
+    ASSERT(state.iterations > 0);
+    ASSERT(runs > state.iterations);
+    ASSERT(state.batch > 1);
+    ASSERT_FALSE(bench_iterate_(&state));
 }
 
 #if 0
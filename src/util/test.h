@@ -17,6 +17,61 @@ void register_test_(Test *test, const char *name);
     void test_##name(Status *test_result_)
 
 void run_all_tests(bool verbose);
+// Runs each test in a child process, as many in parallel as there are CPUs (or TEST_JOBS in the environment).
+// A test still running after 10 s (or TEST_TIMEOUT) is killed and fails.
+
+void test_count_mallocs_start();
+long test_count_mallocs_stop();
+// Returns the number of calls to malloc, calloc and realloc made by the process since test_count_mallocs_start(),
+// or -1 if allocations are not counted. For tests of allocation-free paths.
+// Only the tint2-tests build (make check) counts allocations, on glibc and without AddressSanitizer;
+// tint2 itself never replaces the allocator.
+
+// Benchmarks are registered like tests and run with tint2 --bench [filter]:
+//
+//     BENCH(name)
+//     {
+//         setup...
+//         BENCH_LOOP {
+//             timed code
+//         }
+//         cleanup...
+//     }
+//
+// BENCH_LOOP runs its body until the timing is stable: warmup, then samples of a fixed number of iterations.
+// Each benchmark runs in a child process; the median and 95th percentile per iteration are printed,
+// and all results are written as JSON to bench.json.
+
+typedef struct BenchState BenchState;
+typedef void Bench(BenchState *bench_state_);
+
+void register_bench_(Bench *bench, const char *name);
+
+#define BENCH(name)                                            \
+    void bench_##name(BenchState *bench_state_);               \
+    __attribute__((constructor)) void bench_register_##name()  \
+    {                                                          \
+        register_bench_(bench_##name, #name);                  \
+    }                                                          \
+    void bench_##name(BenchState *bench_state_)
+
+bool bench_iterate_(BenchState *state);
+
+#define BENCH_LOOP while (bench_iterate_(bench_state_))
+
+void bench_skip_(BenchState *state, const char *reason);
+
+#define BENCH_SKIP(reason)                   \
+    {                                        \
+        bench_skip_(bench_state_, reason);   \
+        return;                              \
+    }
+
+#define BENCH_KEEP(value) __asm__ volatile("" : : "g"(value) : "memory")
+// Prevents the compiler from optimizing away the computation of value.
+
+void run_all_benchmarks(const char *filter);
+// Runs the benchmarks whose name contains filter, or all of them if filter is NULL.
 
 #define FAIL_TEST_           \
     *test_result_ = FAILURE; \
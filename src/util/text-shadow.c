@@ -0,0 +1,214 @@
+/**************************************************************************
+*
+* Copyright (C) 2022 tint2 authors
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "text-shadow.h"
+#include "test.h"
+
+// The shadow is the glyph mask stacked at every offset up to SHADOW_SIZE pixels away,
+// with an opacity decreasing linearly with the distance.
+#define SHADOW_SIZE 3
+#define MAX_SHADOW_CACHE_SIZE 256
+
+typedef struct TextShadow {
+    cairo_surface_t *mask;
+    int x, y; // Position of the mask relative to the layout
+} TextShadow;
+
+static GHashTable *shadow_cache;
+
+static void free_text_shadow(gpointer data)
+{
+    TextShadow *shadow = data;
+    if (shadow->mask)
+        cairo_surface_destroy(shadow->mask);
+    free(shadow);
+}
+
+void cleanup_text_shadows()
+{
+    if (shadow_cache)
+        g_hash_table_destroy(shadow_cache);
+    shadow_cache = NULL;
+}
+
+static void shadow_filter(const unsigned char *src, int src_stride, unsigned char *dst, int dst_stride,
+                          int width, int height)
+// Composites the glyph mask src over itself at every shadow offset, writing the result to dst.
+// Stacking layers of opacity a_k gives an opacity of 1 - prod(1 - a_k), which is accumulated one offset
+// at a time over contiguous rows.
+{
+    float *transparency = malloc(width * height * sizeof(float));
+    for (int i = 0; i < width * height; i++)
+        transparency[i] = 1.0f;
+
+    for (int dy = -SHADOW_SIZE; dy <= SHADOW_SIZE; dy++) {
+        for (int dx = -SHADOW_SIZE; dx <= SHADOW_SIZE; dx++) {
+            double r = sqrt(dx * dx + dy * dy);
+            double alpha = 1.0 - r / SHADOW_SIZE;
+            if (r <= 0 || alpha <= 0)
+                continue;
+            float weight = alpha / 255.0;
+            int x0 = MAX(0, dx), x1 = MIN(width, width + dx);
+            for (int y = MAX(0, dy); y < MIN(height, height + dy); y++) {
+                const unsigned char *s = src + (y - dy) * src_stride - dx;
+                float *t = transparency + y * width;
+                for (int x = x0; x < x1; x++)
+                    t[x] *= 1.0f - weight * s[x];
+            }
+        }
+    }
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            dst[y * dst_stride + x] = (unsigned char)((1.0f - transparency[y * width + x]) * 255.0f + 0.5f);
+    }
+    free(transparency);
+}
+
+static GBytes *shadow_cache_key(PangoLayout *layout)
+// Describes everything that affects the rendered glyphs: the font options, and for each run
+// its font, position and glyphs.
+{
+    GByteArray *key = g_byte_array_new();
+    const cairo_font_options_t *options = pango_cairo_context_get_font_options(pango_layout_get_context(layout));
+    unsigned long options_hash = options ? cairo_font_options_hash(options) : 0;
+    g_byte_array_append(key, (guint8 *)&options_hash, sizeof(options_hash));
+
+    PangoLayoutIter *iter = pango_layout_get_iter(layout);
+    do {
+        PangoLayoutRun *run = pango_layout_iter_get_run_readonly(iter);
+        if (!run)
+            continue;
+        PangoRectangle logical;
+        pango_layout_iter_get_run_extents(iter, NULL, &logical);
+        int position[2] = { logical.x, pango_layout_iter_get_baseline(iter) };
+        g_byte_array_append(key, (guint8 *)position, sizeof(position));
+        if (run->item->analysis.font) {
+            PangoFontDescription *desc = pango_font_describe_with_absolute_size(run->item->analysis.font);
+            char *font = pango_font_description_to_string(desc);
+            g_byte_array_append(key, (guint8 *)font, strlen(font) + 1);
+            g_free(font);
+            pango_font_description_free(desc);
+        }
+        for (int i = 0; i < run->glyphs->num_glyphs; i++) {
+            PangoGlyphInfo *info = &run->glyphs->glyphs[i];
+            int glyph[4] = { info->glyph, info->geometry.width, info->geometry.x_offset, info->geometry.y_offset };
+            g_byte_array_append(key, (guint8 *)glyph, sizeof(glyph));
+        }
+    } while (pango_layout_iter_next_run(iter));
+    pango_layout_iter_free(iter);
+
+    return g_byte_array_free_to_bytes(key);
+}
+
+static TextShadow *create_text_shadow(PangoLayout *layout)
+{
+    TextShadow *shadow = calloc(1, sizeof(TextShadow));
+    PangoRectangle ink;
+    pango_layout_get_pixel_extents(layout, &ink, NULL);
+    if (ink.width <= 0 || ink.height <= 0)
+        return shadow;
+
+    int width = ink.width + 2 * SHADOW_SIZE;
+    int height = ink.height + 2 * SHADOW_SIZE;
+    shadow->x = ink.x - SHADOW_SIZE;
+    shadow->y = ink.y - SHADOW_SIZE;
+
+    cairo_surface_t *glyphs = cairo_image_surface_create(CAIRO_FORMAT_A8, width, height);
+    cairo_t *c = cairo_create(glyphs);
+    cairo_move_to(c, -shadow->x, -shadow->y);
+    pango_cairo_show_layout(c, layout);
+    cairo_destroy(c);
+    cairo_surface_flush(glyphs);
+
+    shadow->mask = cairo_image_surface_create(CAIRO_FORMAT_A8, width, height);
+    cairo_surface_flush(shadow->mask);
+    shadow_filter(cairo_image_surface_get_data(glyphs),
+                  cairo_image_surface_get_stride(glyphs),
+                  cairo_image_surface_get_data(shadow->mask),
+                  cairo_image_surface_get_stride(shadow->mask),
+                  width,
+                  height);
+    cairo_surface_mark_dirty(shadow->mask);
+    cairo_surface_destroy(glyphs);
+    return shadow;
+}
+
+void draw_text_shadow(cairo_t *c, int posx, int posy, PangoLayout *layout)
+{
+    pango_cairo_update_layout(c, layout);
+    if (!shadow_cache)
+        shadow_cache = g_hash_table_new_full(g_bytes_hash,
+                                             g_bytes_equal,
+                                             (GDestroyNotify)g_bytes_unref,
+                                             free_text_shadow);
+    GBytes *key = shadow_cache_key(layout);
+    TextShadow *shadow = g_hash_table_lookup(shadow_cache, key);
+    if (shadow) {
+        g_bytes_unref(key);
+    } else {
+        // Texts that change often (e.g. clocks) would make the cache grow without bound
+        if (g_hash_table_size(shadow_cache) >= MAX_SHADOW_CACHE_SIZE)
+            g_hash_table_remove_all(shadow_cache);
+        shadow = create_text_shadow(layout);
+        g_hash_table_insert(shadow_cache, key, shadow);
+    }
+
+    if (!shadow->mask)
+        return;
+    cairo_set_source_rgba(c, 0.0, 0.0, 0.0, 1.0);
+    cairo_mask_surface(c, shadow->mask, posx + shadow->x, posy + shadow->y);
+}
+
+TEST(shadow_filter_single_pixel)
+{
+    const int size = 9, center = 4;
+    unsigned char src[9 * 9] = {0}, dst[9 * 9];
+    src[center * size + center] = 255;
+    shadow_filter(src, size, dst, size, size, size);
+
+    // The glyph itself is not part of its own shadow
+    ASSERT_EQUAL(dst[center * size + center], 0);
+    // Opacity 1 - r / 3 at distance r
+    ASSERT_EQUAL(dst[center * size + center + 1], 170);
+    ASSERT_EQUAL(dst[(center - 1) * size + center], 170);
+    ASSERT_EQUAL(dst[center * size + center - 2], 85);
+    ASSERT_EQUAL(dst[(center + 1) * size + center + 1], (int)((1 - sqrt(2) / 3) * 255 + 0.5));
+    ASSERT_EQUAL(dst[center * size + center + 3], 0);
+    ASSERT_EQUAL(dst[(center + 2) * size + center + 2], (int)((1 - sqrt(8) / 3) * 255 + 0.5));
+}
+
+TEST(shadow_filter_overlapping_layers)
+{
+    const int size = 9;
+    unsigned char src[9 * 9] = {0}, dst[9 * 9];
+    // Two glyph pixels side by side, both at distance 1 from the pixel between them
+    src[4 * size + 3] = 255;
+    src[4 * size + 5] = 255;
+    shadow_filter(src, size, dst, size, size, size);
+
+    // 1 - (1 - 2/3)^2
+    ASSERT_EQUAL(dst[4 * size + 4], (int)((1 - 1.0 / 9) * 255 + 0.5));
+    // Only the nearest glyph pixel is within range
+    ASSERT_EQUAL(dst[4 * size + 1], 85);
+}
@@ -0,0 +1,16 @@
+#ifndef TEXT_SHADOW_H
+#define TEXT_SHADOW_H
+
+#include <cairo.h>
+#include <pango/pangocairo.h>
+
+// Text shadows (font_shadow = 1).
+// The shadow of a layout is rendered once into an alpha mask, which is kept in a cache keyed by the glyphs
+// and fonts of the layout; drawing a cached shadow is a single mask composite.
+
+void draw_text_shadow(cairo_t *c, int posx, int posy, PangoLayout *layout);
+// Draws the shadow of the layout, as if the layout was drawn at (posx, posy).
+
+void cleanup_text_shadows();
+
+#endif
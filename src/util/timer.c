@@ -1764,3 +1764,25 @@ TEST(cleanup_timers_simple)
     handle_expired_timers();
     ASSERT_EQUAL(triggered, 1);
 }
+
+static void bench_timer_callback(void *arg)
+{
+}
+
+BENCH(timer_scheduling)
+{
+    // Rescheduling a timer and computing the next wake-up, as done by the event loop, with many timers
+    const int num_timers = 1000;
+    Timer *bench_timers = calloc(num_timers, sizeof(Timer));
+    for (int i = 0; i < num_timers; i++)
+        init_timer(&bench_timers[i], "bench");
+    int i = 0;
+    BENCH_LOOP {
+        change_timer(&bench_timers[i % num_timers], true, (i * 7919) % 10000 + 1000, 0, bench_timer_callback, NULL);
+        BENCH_KEEP(get_duration_to_next_timer_expiration());
+        i++;
+    }
+    for (int i = 0; i < num_timers; i++)
+        destroy_timer(&bench_timers[i]);
+    free(bench_timers);
+}
@@ -1,4 +1,3 @@
-#include "timer.h"
 #include "common.h"
 
 #ifdef HAVE_TRACING
@@ -6,10 +5,20 @@
 #ifdef ENABLE_EXECINFO
 #include <execinfo.h>
 #endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACING_USE_TSC
+#endif
 #include <glib.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracing.h"
 
 #define GREEN "\033[1;32m"
 #define YELLOW "\033[1;33m"
@@ -17,67 +26,143 @@
 #define BLUE "\033[1;34m"
 #define RESET "\033[0m"
 
-static GSList   *tracing_events = NULL,
-                *tracing_events_tail = NULL;
-static sig_atomic_t tracing = FALSE;
+// Number of records kept, a power of 2. The oldest records are overwritten.
+#define TRACING_RING_SIZE (1 << 19)
 
-typedef struct TracingEvent {
+// Fixed-size record written by the instrumentation hooks, which must not allocate
+typedef struct TracingRecord {
+    uint64_t time;      // clock ticks, see tracing_clock()
     void *address;
     void *caller;
-    double time;
     gboolean enter;
-} TracingEvent;
+} TracingRecord;
+
+static TracingRecord tracing_ring[TRACING_RING_SIZE];
+static size_t tracing_head;             // number of records written since the last cleanup
+static size_t tracing_frame_start;      // first record of the last traced iteration of the event loop
+static void *tracing_root;
+static volatile sig_atomic_t tracing = FALSE;
+
+// Pair of clock readings used to convert ticks to seconds
+static uint64_t tracing_clock_origin;
+static double tracing_time_origin;
+
+static GHashTable *tracing_names = NULL;    // address => symbol name
+
+const char *tracing_json_path = NULL;
+
+static double get_monotonic_raw_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+static inline uint64_t tracing_clock()
+{
+#ifdef TRACING_USE_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static double tracing_seconds_per_tick()
+{
+#ifdef TRACING_USE_TSC
+    // The TSC frequency is measured over the whole tracing session
+    uint64_t ticks = tracing_clock() - tracing_clock_origin;
+    double seconds = get_monotonic_raw_time() - tracing_time_origin;
+    return ticks > 0 ? seconds / ticks : 0;
+#else
+    return 1.0e-9;
+#endif
+}
 
 void __attribute__ ((constructor)) init_tracing()
 {
-    tracing_events = NULL;
+    tracing_head = 0;
+    tracing_frame_start = 0;
     tracing = FALSE;
+    tracing_time_origin = get_monotonic_raw_time();
+    tracing_clock_origin = tracing_clock();
 }
 
 void cleanup_tracing()
 {
-    g_slist_free_full( tracing_events, free);
-    tracing_events = NULL;
     tracing = FALSE;
+    if (tracing_json_path)
+        export_tracing_events(tracing_json_path);
+    if (tracing_names)
+        g_hash_table_destroy(tracing_names);
+    tracing_names = NULL;
+    tracing_head = 0;
+    tracing_frame_start = 0;
 }
 
-char *addr2name(void *func)
+static char *addr2name(void *func)
 {
 #ifdef ENABLE_EXECINFO
-    void *array[1];
-    array[0] = func;
-    char **strings = backtrace_symbols(array, 1);
-    char *result = strings[0] ? strdup( strings[0]) : strdup_static( result, "??");
+    char **strings = backtrace_symbols(&func, 1);
+    char *result = NULL;
+    if (strings && strings[0]) {
+        // binary(function+0x1f) [0x55d0c1a2b3c4] => function
+        char *begin = strchr(strings[0], '(');
+        char *end = begin ? strpbrk(begin + 1, "+)") : NULL;
+        result = end && end > begin + 1 ? g_strndup(begin + 1, end - begin - 1) : g_strdup(strings[0]);
+    }
     free(strings);
-#else
-    const size_t buf_size = 32;
-    char *result = calloc( buf_size, 1);
-    snprintf(result, buf_size-1, "%p", func);
+    if (result)
+        return result;
 #endif
-    return result;
+    return g_strdup_printf("%p", func);
+}
+
+static const char *tracing_symbol(void *address)
+// Symbolized once per address, the result is owned by the cache
+{
+    if (!tracing_names)
+        tracing_names = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    char *name = g_hash_table_lookup(tracing_names, address);
+    if (!name) {
+        name = addr2name(address);
+        g_hash_table_insert(tracing_names, address, name);
+    }
+    return name;
 }
 
-void add_tracing_event(void *func, void *caller, gboolean enter)
+static inline void add_tracing_event(void *func, void *caller, gboolean enter)
 {
-    TracingEvent *entry = calloc(sizeof(TracingEvent), 1);
-    entry->address = func;
-    entry->caller = caller;
-    entry->time = get_time();
-    entry->enter = enter;
-    g_slist_append_tail( tracing_events, tracing_events_tail, entry);
+    size_t i = __atomic_fetch_add(&tracing_head, 1, __ATOMIC_RELAXED);
+    TracingRecord *record = &tracing_ring[i & (TRACING_RING_SIZE - 1)];
+    record->time = tracing_clock();
+    record->address = func;
+    record->caller = caller;
+    record->enter = enter;
+}
+
+static size_t tracing_first_record(size_t start)
+// Returns the first record at or after start that has not been overwritten
+{
+    return tracing_head - start > TRACING_RING_SIZE ? tracing_head - TRACING_RING_SIZE : start;
 }
 
 void start_tracing(void *root)
 {
-    if (tracing_events)
-        cleanup_tracing();
+    tracing_frame_start = tracing_head;
+    tracing_root = root;
     add_tracing_event(root, NULL, TRUE);
     tracing = TRUE;
 }
 
 void stop_tracing()
 {
+    if (!tracing)
+        return;
     tracing = FALSE;
+    add_tracing_event(tracing_root, NULL, FALSE);
 }
 
 void __cyg_profile_func_enter(void *func, void *caller)
@@ -92,25 +177,46 @@ void __cyg_profile_func_exit(void *func, void *caller)
         add_tracing_event(func, caller, FALSE);
 }
 
+static void print_exit(const char *name, int depth, double duration)
+{
+    fprintf(stderr, "tint2: ");
+    for (int d = 0; d < depth; d++)
+        fprintf(stderr, "  ");
+    fprintf(stderr, "-- %s exited after %.1f ms", name, duration);
+    if (duration >= 1.0) {
+        fprintf(stderr, YELLOW "  ");
+        for (int d = 0; d < duration; d++)
+            fputc('#', stderr);
+        fprintf(stderr, RESET);
+    }
+    fputc('\n', stderr);
+}
+
 void print_tracing_events()
 {
+    double seconds_per_tick = tracing_seconds_per_tick();
+    uint64_t now = tracing_clock();
     GSList *stack = NULL;
     int depth = 0;
-    double now = get_time();
-    for (GSList *i = tracing_events; i; i = i->next)
+    size_t first = tracing_first_record(tracing_frame_start);
+    if (first != tracing_frame_start)
+        fprintf(stderr,
+                YELLOW "tint2: tracing: %zu records lost, the ring buffer holds %d" RESET "\n",
+                first - tracing_frame_start,
+                TRACING_RING_SIZE);
+    for (size_t i = first; i < tracing_head; i++)
     {
-        TracingEvent *e = i->data;
+        TracingRecord *e = &tracing_ring[i & (TRACING_RING_SIZE - 1)];
         if (e->enter)
         {
             // Push a new function on the stack
+            fprintf(stderr, "tint2: ");
             for (int d = 0; d < depth; d++)
-                fprintf(stderr, "tint2:  ");
-            char *name = addr2name(e->address);
-            char *caller = addr2name(e->caller);
+                fprintf(stderr, "  ");
             fprintf(stderr,
                     "%s called from %s\n",
-                    name,
-                    caller);
+                    tracing_symbol(e->address),
+                    e->caller ? tracing_symbol(e->caller) : "??");
             stack = g_slist_prepend( stack, e);
             depth++;
         }
@@ -118,25 +224,10 @@ void print_tracing_events()
         {
             // Pop a function from the stack, if matching, and print
             if (stack) {
-                TracingEvent *old = stack->data;
+                TracingRecord *old = stack->data;
                 if (old->address == e->address) {
                     depth--;
-                    for (int d = 0; d < depth; d++)
-                        fprintf(stderr, "tint2:  ");
-                    char *name = addr2name(e->address);
-                    double duration = (e->time - old->time) * 1.0e3;
-                    fprintf(stderr,
-                            "-- %s exited after %.1f ms",
-                            name,
-                            duration);
-                    if (duration >= 1.0) {
-                        fprintf(stderr, YELLOW "tint2:  ");
-                        for (int d = 0; d < duration; d++)
-                            fprintf(stderr, "tint2: #");
-                        fprintf(stderr, RESET);
-                    }
-                    fprintf(stderr, "tint2: \n");
-                    free(name);
+                    print_exit(tracing_symbol(e->address), depth, (e->time - old->time) * seconds_per_tick * 1.0e3);
                     stack = g_slist_delete_link( stack, stack);
                 }
             }
@@ -144,26 +235,62 @@ void print_tracing_events()
     }
     while (stack)
     {
-        TracingEvent *old = stack->data;
+        TracingRecord *old = stack->data;
         depth--;
-        for (int d = 0; d < depth; d++)
-            fprintf(stderr, "tint2:  ");
-        char *name = addr2name(old->address);
-        double duration = (now - old->time) * 1.0e3;
-        fprintf(stderr,
-                "-- %s exited after %.1f ms",
-                name,
-                duration);
-        if (duration >= 1.0) {
-            fprintf(stderr, YELLOW "tint2:  ");
-            for (int d = 0; d < duration; d++)
-                fprintf(stderr, "tint2: #");
-            fprintf(stderr, RESET);
-        }
-        fprintf(stderr, "tint2: \n");
-        free(name);
+        print_exit(tracing_symbol(old->address), depth, (now - old->time) * seconds_per_tick * 1.0e3);
         stack = g_slist_delete_link( stack, stack);
     }
 }
 
+static void write_json_event(FILE *f, gboolean first, const char *name, char phase, double ts, int pid)
+{
+    fprintf(f, "%s\n{\"name\":\"", first ? "" : ",");
+    for (const char *c = name; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fprintf(f, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            fprintf(f, "\\u%04x", *c);
+        else
+            fputc(*c, f);
+    }
+    fprintf(f, "\",\"cat\":\"tint2\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", phase, ts, pid, pid);
+}
+
+void export_tracing_events(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, RED "tint2: tracing: could not write %s" RESET "\n", path);
+        return;
+    }
+    double us_per_tick = tracing_seconds_per_tick() * 1.0e6;
+    int pid = (int)getpid();
+    size_t first = tracing_first_record(0);
+    // Exits of functions entered before the oldest record are dropped, the unfinished calls are closed at the end
+    GSList *stack = NULL;
+    double ts = 0;
+    size_t count = 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (size_t i = first; i < tracing_head; i++)
+    {
+        TracingRecord *e = &tracing_ring[i & (TRACING_RING_SIZE - 1)];
+        ts = (e->time - tracing_clock_origin) * us_per_tick;
+        if (e->enter) {
+            stack = g_slist_prepend(stack, e->address);
+        } else if (stack && stack->data == e->address) {
+            stack = g_slist_delete_link(stack, stack);
+        } else {
+            continue;
+        }
+        write_json_event(f, count++ == 0, tracing_symbol(e->address), e->enter ? 'B' : 'E', ts, pid);
+    }
+    while (stack) {
+        write_json_event(f, count++ == 0, tracing_symbol(stack->data), 'E', ts, pid);
+        stack = g_slist_delete_link(stack, stack);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    fprintf(stderr, BLUE "tint2: tracing: wrote %zu events to %s" RESET "\n", count, path);
+}
+
 #endif
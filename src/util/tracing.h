@@ -9,6 +9,13 @@ void cleanup_tracing();
 void start_tracing(void *root);
 void stop_tracing();
 void print_tracing_events();
+// Prints the calls of the last traced iteration of the event loop.
+
+void export_tracing_events(const char *path);
+// Writes the calls kept in the ring buffer in the Chrome trace event format, which Perfetto can open.
+
+extern const char *tracing_json_path;
+// If set (TRACING_JSON in the environment), the trace is exported there when tint2 exits.
 
 #endif
 
@@ -17,6 +17,7 @@
 * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 **************************************************************************/
 
+#define _GNU_SOURCE
 #include "uevent.h"
 int uevent_fd = -1;
 
@@ -24,15 +25,48 @@ int uevent_fd = -1;
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
 
+#include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
 #include <linux/types.h>
 #include <linux/netlink.h>
+#include <linux/filter.h>
+
+// With _GNU_SOURCE (for recvmmsg), stdint.h defines SIZE_WIDTH, which is also a SizeVariable in gradient.h
+#undef SIZE_WIDTH
 
 #include "common.h"
+#include "test.h"
+
+// Netlink groups of NETLINK_KOBJECT_UEVENT
+#define UEVENT_GROUP_KERNEL 1
+#define UEVENT_GROUP_UDEV   2
+
+// Header of the events broadcast by udevd once its rules have run, as defined by libudev.
+// The subsystem hash lets a socket filter drop the events without parsing them.
+#define UDEV_MONITOR_MAGIC 0xfeedcafe
+
+struct udev_monitor_header {
+    char prefix[8];                 // "libudev"
+    uint32_t magic;                 // UDEV_MONITOR_MAGIC, big endian
+    uint32_t header_size;
+    uint32_t properties_off;
+    uint32_t properties_len;
+    uint32_t filter_subsystem_hash; // big endian
+    uint32_t filter_devtype_hash;
+    uint32_t filter_tag_bloom_hi;
+    uint32_t filter_tag_bloom_lo;
+};
+
+// Events are drained in batches. Kernel events are at most 2 KiB, udev ones carry more properties.
+#define UEVENT_BATCH 8
+#define UEVENT_BUF_SIZE 8192
 
 static struct sockaddr_nl nls;
 static GSList *notifiers = NULL;
@@ -50,7 +84,7 @@ static void uevent_destroy(struct uevent *ev)
 }
 
 static int uevent_new(struct uevent *ev, char *buffer, int size)
-// Fills event structure, pointed by ev.
+// Fills event structure, pointed by ev, from a kernel or udev event.
 // Returns 1 on success, 0 on error.
 {
     gboolean first = TRUE;
@@ -60,6 +94,18 @@ static int uevent_new(struct uevent *ev, char *buffer, int size)
 
     memset (ev, 0, sizeof(*ev));
 
+    if (size >= (int)sizeof(struct udev_monitor_header) && memcmp(buffer, "libudev", 8) == 0) {
+        // udev events have no "action@devpath" line, the path is in DEVPATH=
+        struct udev_monitor_header header;
+        memcpy(&header, buffer, sizeof(header));
+        if (ntohl(header.magic) != UDEV_MONITOR_MAGIC || header.properties_off < sizeof(header) ||
+            header.properties_off > (uint32_t)size || header.properties_len > size - header.properties_off)
+            return 0;
+        buffer += header.properties_off;
+        size = header.properties_len;
+        first = FALSE;
+    }
+
     const char *s   = buffer;
     const char *end = buffer + size;
     while (s < end) {
@@ -89,6 +135,9 @@ static int uevent_new(struct uevent *ev, char *buffer, int size)
             } else if ((val = (char*)HAS_CONST_PREFIX(s, end, "SUBSYSTEM=")) != NULL) {
                 ev->subsystem = val;
                 s = strchr (val, '\0') + 1;
+            } else if ((val = (char*)HAS_CONST_PREFIX(s, end, "DEVPATH=")) != NULL) {
+                ev->path = val;
+                s = strchr (val, '\0') + 1;
             } else {
                 val = strchr(s, '=');
                 if (val) {
@@ -110,9 +159,91 @@ static int uevent_new(struct uevent *ev, char *buffer, int size)
     return 1;
 }
 
+static uint32_t udev_subsystem_hash(const char *subsystem)
+// MurmurHash2 with seed 0, as used by libudev for filter_subsystem_hash
+{
+    const uint32_t m = 0x5bd1e995;
+    size_t len = strlen(subsystem);
+    uint32_t h = len;
+    const unsigned char *data = (const unsigned char *)subsystem;
+    for (; len >= 4; data += 4, len -= 4) {
+        uint32_t k;
+        memcpy(&k, data, 4);
+        k *= m;
+        k ^= k >> 24;
+        k *= m;
+        h *= m;
+        h ^= k;
+    }
+    switch (len) {
+    case 3:
+        h ^= data[2] << 16;
+        // fallthrough
+    case 2:
+        h ^= data[1] << 8;
+        // fallthrough
+    case 1:
+        h ^= data[0];
+        h *= m;
+    }
+    h ^= h >> 13;
+    h *= m;
+    h ^= h >> 15;
+    return h;
+}
+
+static int uevent_build_filter(struct sock_filter *filter, int size)
+// Generates a classic BPF program that accepts udev events only from the subsystems of the notifiers.
+// Returns the number of instructions, or 0 if every event must be accepted.
+{
+    int n = 0;
+    for (GSList *l = notifiers; l; l = l->next) {
+        struct uevent_notify *nb = l->data;
+        if (!nb->subsystem)
+            return 0;
+        n++;
+    }
+    if (n + 4 > size)
+        return 0;
+
+    int i = 0;
+    // Events without the udev header (e.g. from the kernel) cannot be filtered by subsystem
+    filter[i++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct udev_monitor_header, magic));
+    filter[i++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, UDEV_MONITOR_MAGIC, 1, 0);
+    filter[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    filter[i++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                                               offsetof(struct udev_monitor_header, filter_subsystem_hash));
+    // Each match jumps to the accept instruction after the final drop
+    for (GSList *l = notifiers; l; l = l->next, n--) {
+        struct uevent_notify *nb = l->data;
+        filter[i++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, udev_subsystem_hash(nb->subsystem), n, 0);
+    }
+    filter[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+    filter[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    return i;
+}
+
+static void uevent_update_filter()
+{
+    if (uevent_fd < 0)
+        return;
+    struct sock_filter filter[64];
+    struct sock_fprog prog = {0, filter};
+    prog.len = uevent_build_filter(filter, sizeof(filter) / sizeof(filter[0]));
+    if (prog.len == 0) {
+        // Fails with ENOENT if no filter is attached
+        int unused = 0;
+        setsockopt(uevent_fd, SOL_SOCKET, SO_DETACH_FILTER, &unused, sizeof(unused));
+        return;
+    }
+    if (setsockopt(uevent_fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+        fprintf(stderr, "tint2: could not attach the uevent socket filter: %s\n", strerror(errno));
+}
+
 void uevent_register_notifier(struct uevent_notify *nb)
 {
     notifiers = g_slist_prepend(notifiers, nb);
+    uevent_update_filter();
 }
 
 void uevent_unregister_notifier(struct uevent_notify *nb)
@@ -128,6 +259,7 @@ void uevent_unregister_notifier(struct uevent_notify *nb)
 
         l = next;
     }
+    uevent_update_filter();
 }
 
 void uevent_handler( fd_set *fds, int *fdn)
@@ -135,30 +267,50 @@ void uevent_handler( fd_set *fds, int *fdn)
     if (!fd_set_unset_fd( fds, fdn, uevent_fd))
         return;
 
-    char buf[512];
-    int len = recv(uevent_fd, buf, sizeof(buf), MSG_DONTWAIT);
-    if (len < 0)
-        return;
+    static char bufs[UEVENT_BATCH][UEVENT_BUF_SIZE + 1];
+    struct iovec iov[UEVENT_BATCH];
+    struct mmsghdr msgs[UEVENT_BATCH];
+
+    int count;
+    do {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < UEVENT_BATCH; i++) {
+            iov[i].iov_base = bufs[i];
+            iov[i].iov_len = UEVENT_BUF_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        count = recvmmsg(uevent_fd, msgs, UEVENT_BATCH, MSG_DONTWAIT, NULL);
+        if (count < 0)
+            return;
 
-    /* buf must be null-terminated */
-    buf[ MIN(len, strlen_const(buf)) ] = '\0';
+        for (int i = 0; i < count; i++) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+                continue;
+            char *buf = bufs[i];
+            int len = msgs[i].msg_len;
 
-    struct uevent ev;
+            /* buf must be null-terminated */
+            buf[len] = '\0';
 
-    if (uevent_new(&ev, buf, len)) {
-        for (GSList *l = notifiers; l; l = l->next)
-        {
-            struct uevent_notify *nb = l->data;
+            struct uevent ev;
 
-            if (!(ev.action & nb->action) ||
-                (nb->subsystem && strcmp(ev.subsystem, nb->subsystem) != 0))
+            if (uevent_new(&ev, buf, len)) {
+                for (GSList *l = notifiers; l; l = l->next)
+                {
+                    struct uevent_notify *nb = l->data;
 
-                continue;
+                    if (!(ev.action & nb->action) ||
+                        (nb->subsystem && (!ev.subsystem || strcmp(ev.subsystem, nb->subsystem) != 0)))
 
-            nb->cb(&ev, nb->userdata);
+                        continue;
+
+                    nb->cb(&ev, nb->userdata);
+                }
+                uevent_destroy (&ev);
+            }
         }
-        uevent_destroy (&ev);
-    }
+    } while (count == UEVENT_BATCH);
 }
 
 int uevent_init()
@@ -167,10 +319,11 @@ int uevent_init()
     memset(&nls, 0, sizeof(struct sockaddr_nl));
     nls.nl_family = AF_NETLINK;
     nls.nl_pid = getpid();
-    nls.nl_groups = -1;
+    // Prefer the events relayed by udevd: unlike kernel events they can be filtered by subsystem
+    nls.nl_groups = access("/run/udev/control", F_OK) == 0 ? UEVENT_GROUP_UDEV : UEVENT_GROUP_KERNEL;
 
     /* open socket */
-    uevent_fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    uevent_fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
     if (uevent_fd < 0) {
         fprintf(stderr, "tint2: Error: socket open failed\n");
         return -1;
@@ -182,6 +335,8 @@ int uevent_init()
         return -1;
     }
 
+    uevent_update_filter();
+
     fprintf(stderr, "tint2: Kernel uevent interface initialized...\n");
 
     return uevent_fd;
@@ -193,4 +348,88 @@ void uevent_cleanup()
         close(uevent_fd);
 }
 
+static const char kernel_event[] = "change@/devices/LNXSYSTM:00/PNP0C0A:00/power_supply/BAT0\0"
+                                   "ACTION=change\0"
+                                   "DEVPATH=/devices/LNXSYSTM:00/PNP0C0A:00/power_supply/BAT0\0"
+                                   "SUBSYSTEM=power_supply\0"
+                                   "SEQNUM=4242\0";
+
+static int make_udev_event(char *buf, const char *subsystem)
+{
+    struct udev_monitor_header header = {"libudev"};
+    header.magic = htonl(UDEV_MONITOR_MAGIC);
+    header.header_size = sizeof(header);
+    header.properties_off = sizeof(header);
+    header.filter_subsystem_hash = htonl(udev_subsystem_hash(subsystem));
+    int len = sizeof(header);
+    len += sprintf(buf + len, "ACTION=add") + 1;
+    len += sprintf(buf + len, "DEVPATH=/devices/test") + 1;
+    len += sprintf(buf + len, "SUBSYSTEM=%s", subsystem) + 1;
+    header.properties_len = len - sizeof(header);
+    memcpy(buf, &header, sizeof(header));
+    return len;
+}
+
+TEST(uevent_parse_kernel_and_udev)
+{
+    char buf[256];
+    struct uevent ev;
+    memcpy(buf, kernel_event, sizeof(kernel_event));
+    ASSERT_EQUAL(uevent_new(&ev, buf, sizeof(kernel_event)), 1);
+    ASSERT_EQUAL(ev.action, UEVENT_CHANGE);
+    ASSERT_EQUAL(ev.sequence, 4242);
+    ASSERT_STR_EQUAL(ev.subsystem, "power_supply");
+    ASSERT_STR_EQUAL(ev.path, "/devices/LNXSYSTM:00/PNP0C0A:00/power_supply/BAT0");
+    uevent_destroy(&ev);
+
+    int len = make_udev_event(buf, "usb");
+    ASSERT_EQUAL(uevent_new(&ev, buf, len), 1);
+    ASSERT_EQUAL(ev.action, UEVENT_ADD);
+    ASSERT_STR_EQUAL(ev.subsystem, "usb");
+    ASSERT_STR_EQUAL(ev.path, "/devices/test");
+    uevent_destroy(&ev);
+
+    // Properties past the end of the message
+    ASSERT_EQUAL(uevent_new(&ev, buf, len - 1), 0);
+}
+
+TEST(uevent_filter_by_subsystem)
+{
+    struct uevent_notify power = {UEVENT_CHANGE, "power_supply", NULL, NULL};
+    struct uevent_notify block = {UEVENT_ADD, "block", NULL, NULL};
+    notifiers = g_slist_prepend(g_slist_prepend(NULL, &power), &block);
+
+    int fds[2];
+    ASSERT_EQUAL(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+    uevent_fd = fds[1];
+    uevent_update_filter();
+
+    char buf[256];
+    int len = make_udev_event(buf, "usb");
+    ASSERT_EQUAL(send(fds[0], buf, len, 0), len);
+    len = make_udev_event(buf, "power_supply");
+    ASSERT_EQUAL(send(fds[0], buf, len, 0), len);
+    ASSERT_EQUAL(send(fds[0], kernel_event, sizeof(kernel_event), 0), (ssize_t)sizeof(kernel_event));
+
+    char received[256];
+    ASSERT_EQUAL(recv(fds[1], received, sizeof(received), MSG_DONTWAIT), len);
+    ASSERT_EQUAL(memcmp(received, buf, len), 0);
+    ASSERT_EQUAL(recv(fds[1], received, sizeof(received), MSG_DONTWAIT), (ssize_t)sizeof(kernel_event));
+    ASSERT_EQUAL(recv(fds[1], received, sizeof(received), MSG_DONTWAIT), -1);
+
+    // A notifier for any subsystem removes the filter
+    struct uevent_notify any = {UEVENT_ADD, NULL, NULL, NULL};
+    notifiers = g_slist_prepend(notifiers, &any);
+    uevent_update_filter();
+    len = make_udev_event(buf, "usb");
+    ASSERT_EQUAL(send(fds[0], buf, len, 0), len);
+    ASSERT_EQUAL(recv(fds[1], received, sizeof(received), MSG_DONTWAIT), len);
+
+    g_slist_free(notifiers);
+    notifiers = NULL;
+    uevent_fd = -1;
+    close(fds[0]);
+    close(fds[1]);
+}
+
 #endif
@@ -38,6 +38,7 @@
 #include "common.h"
 #include "window.h"
 #include "server.h"
+#include "test.h"
 #include "panel.h"
 #include "taskbar.h"
 
@@ -101,7 +102,7 @@ gboolean window_is_hidden(Window win)
     XFree(at);
 
     for (int i = 0; i < num_panels; i++)
-        if (panels[i].main_win == win)
+        if (panels[i]->main_win == win)
             return TRUE;
 
     // specification
@@ -159,7 +160,7 @@ int get_window_desktop(Window win)
 
     if (best_match < 0)
         best_match = 0;
-    // fprintf(stderr, "tint2: window %lx %s : viewport %d, (%d, %d)\n", win, get_task(win) ? get_task(win)->title :
+    // fprintf(stderr, "tint2: window %lx %s : viewport %d, (%d, %d)\n", win, get_task(win) ? get_task(win)->model->title :
     // "??",
     // best_match+1, x, y);
     return best_match;
@@ -337,6 +338,79 @@ gulong *get_best_icon(gulong *data, int icon_count, int num, int *iw, int *ih, i
     return icon_data[icon_num];
 }
 
+static gulong *get_icon_property_range(Window win, long offset, long length, long *num, long *total)
+// Reads length 32-bit items of _NET_WM_ICON from offset. Sets num to the number of items read and total
+// to the length of the whole property.
+{
+    Atom type_ret;
+    int format_ret = 0;
+    unsigned long nitems_ret = 0;
+    unsigned long bafter_ret = 0;
+    unsigned char *prop_value = NULL;
+    *num = 0;
+    if (XGetWindowProperty(server.display, win, server.atom [_NET_WM_ICON], offset, length, False, XA_CARDINAL,
+                           &type_ret, &format_ret, &nitems_ret, &bafter_ret, &prop_value) != Success)
+        return NULL;
+    if (type_ret != XA_CARDINAL || format_ret != 32 || !prop_value) {
+        if (prop_value)
+            XFree(prop_value);
+        return NULL;
+    }
+    *num = (long)nitems_ret;
+    *total = offset + (long)nitems_ret + (long)(bafter_ret / 4);
+    return (gulong *)prop_value;
+}
+
+gulong *get_window_icon(Window win, int icon_size, int *iw, int *ih)
+{
+    // The property is a list of icons, each one a width, a height and width * height pixels.
+    // Walk the headers first, so that only the pixels of the selected size are transferred.
+    long num, total = 0;
+    long transferred = 0;
+    long best_offset = -1;
+    int best_w = 0, best_h = 0;
+    int num_icons = 0;
+    for (long offset = 0; offset == 0 || offset + 2 <= total; ) {
+        gulong *header = get_icon_property_range(win, offset, 2, &num, &total);
+        transferred += num;
+        if (!header)
+            break;
+        int w = num == 2 ? (int)header[0] : 0;
+        int h = num == 2 ? (int)header[1] : 0;
+        XFree(header);
+        if (w <= 0 || h <= 0 || w > 4096 || h > 4096 || offset + 2 + (long)w * h > total)
+            break;
+        num_icons++;
+        // Like get_best_icon: the last icon of the requested width, or else the last of the widest ones
+        if (w == icon_size || (best_w != icon_size && w >= best_w)) {
+            best_offset = offset;
+            best_w = w;
+            best_h = h;
+        }
+        offset += 2 + (long)w * h;
+    }
+
+    gulong *pixels = NULL;
+    if (best_offset >= 0) {
+        pixels = get_icon_property_range(win, best_offset + 2, (long)best_w * best_h, &num, &total);
+        transferred += num;
+        if (pixels && num != (long)best_w * best_h) {
+            // The property changed in the meantime
+            XFree(pixels);
+            pixels = NULL;
+        }
+    }
+    if (debug_icons)
+        fprintf(stderr,
+                "tint2: _NET_WM_ICON of window %lu: %d icons, selected %dx%d, transferred %ld of %ld bytes\n",
+                win, num_icons, best_w, best_h, transferred * 4, total * 4);
+    if (pixels) {
+        *iw = best_w;
+        *ih = best_h;
+    }
+    return pixels;
+}
+
 // Thanks zcodes!
 char *get_window_name(Window win)
 {
@@ -392,6 +466,73 @@ void smooth_thumbnail(cairo_surface_t *image_surface)
 #define GetPixel(ximg, x, y) ((u_int32_t *)&(ximg->data[y * ximg->bytes_per_line]))[x]
 //#define GetPixel XGetPixel
 
+// Samples the window image into the thumbnail data, which has size tw x th,
+// into a band of width fw starting at column ox.
+static void downsample_thumbnail(XImage *ximg, u_int32_t *data, size_t w, size_t h, size_t tw, size_t th, size_t fw, size_t ox)
+{
+    // Fixed-point precision
+    // Kernel:
+    // 0 0 0 1 0 0 0 0
+    // 0 0 0 0 0 0 1 0
+    // 0 0 0 0 0 0 0 0
+    // 0 0 0 0 0 0 0 0
+    // 0 0 1 0 1 0 0 1
+    // 0 0 0 0 0 0 0 0
+    // 0 1 0 0 0 0 0 0
+    // 0 0 0 0 0 1 0 0
+    const size_t prec = 1 << 16;
+    const size_t xstep = w * prec / fw;
+    const size_t ystep = h * prec / th;
+    size_t offset_y[] = {0, 0, 1, 4, 4, 4, 6, 7};
+    size_t offset_x[] = {0, 3, 6, 2, 4, 7, 1, 6};
+    for (int i=1; i<=7; i++) {
+        offset_y [i] *= (w * prec / fw) / 8;
+        offset_x [i] *= (h * prec / th) / 8;
+    }
+    u_int32_t rmask = (u_int32_t)ximg->red_mask;
+    u_int32_t gmask = (u_int32_t)ximg->green_mask;
+    u_int32_t bmask = (u_int32_t)ximg->blue_mask;
+    for (size_t yt = 0, y = 0; yt < th; yt++, y += ystep) {
+        for (size_t xt = 0, x = 0; xt < fw; xt++, x += xstep) {
+            size_t j = yt * tw + ox + xt;
+            if (j < tw * th)
+            {
+                u_int32_t c[8];
+                for (int i=1; i<=7; i++)
+                    c[i] = (u_int32_t)GetPixel(ximg, (int)((x + offset_x[i]) / prec), (int)((y + offset_y[i]) / prec));
+
+                u_int32_t b = ((c[1] & bmask) + (c[2] & bmask) + (c[3] & bmask) + (c[4] & bmask) + (c[5] & bmask) * 2
+                            +  (c[6] & bmask) + (c[7] & bmask)) / 8;
+                u_int32_t g = ((c[1] & gmask) + (c[2] & gmask) + (c[3] & gmask) + (c[4] & gmask) + (c[5] & gmask) * 2
+                            +  (c[6] & gmask) + (c[7] & gmask)) / 8;
+                u_int32_t r = ((c[1] & rmask) + (c[2] & rmask) + (c[3] & rmask) + (c[4] & rmask) + (c[5] & rmask) * 2
+                            +  (c[6] & rmask) + (c[7] & rmask)) / 8;
+                data[j] = (r & rmask) | (g & gmask) | (b & bmask);
+            }
+        }
+    }
+    // Convert to argb32
+    if (rmask & 0xff0000) {
+        // argb32 or rgb24 => Nothing to do
+    } else if (rmask & 0xff) {
+        // bgr24
+        for (size_t i = 0; i < tw * th; i++) {
+            u_int32_t r = (data[i] & rmask) << 16;
+            u_int32_t g = (data[i] & gmask);
+            u_int32_t b = (data[i] & bmask) >> 16;
+            data[i] = (r & 0xff0000) | (g & 0x00ff00) | (b & 0x0000ff);
+        }
+    } else if (rmask & 0xff00) {
+        // bgra32
+        for (size_t i = 0; i < tw * th; i++) {
+            u_int32_t r = (data[i] & rmask) << 8;
+            u_int32_t g = (data[i] & gmask) >> 8;
+            u_int32_t b = (data[i] & bmask) >> 24;
+            data[i] = (r & 0xff0000) | (g & 0x00ff00) | (b & 0x0000ff);
+        }
+    }
+}
+
 cairo_surface_t *get_window_thumbnail_ximage(Window win, size_t size, gboolean use_shm)
 {
     cairo_surface_t *result = NULL;
@@ -508,67 +649,7 @@ cairo_surface_t *get_window_thumbnail_ximage(Window win, size_t size, gboolean u
     u_int32_t *data = (u_int32_t *)cairo_image_surface_get_data(result);
     memset(data, 0, tw * th);
 
-    // Fixed-point precision
-    // Kernel:
-    // 0 0 0 1 0 0 0 0
-    // 0 0 0 0 0 0 1 0
-    // 0 0 0 0 0 0 0 0
-    // 0 0 0 0 0 0 0 0
-    // 0 0 1 0 1 0 0 1
-    // 0 0 0 0 0 0 0 0
-    // 0 1 0 0 0 0 0 0
-    // 0 0 0 0 0 1 0 0
-    const size_t prec = 1 << 16;
-    const size_t xstep = w * prec / fw;
-    const size_t ystep = h * prec / th;
-    size_t offset_y[] = {0, 0, 1, 4, 4, 4, 6, 7};
-    size_t offset_x[] = {0, 3, 6, 2, 4, 7, 1, 6};
-    for (int i=1; i<=7; i++) {
-        offset_y [i] *= (w * prec / fw) / 8;
-        offset_x [i] *= (h * prec / th) / 8;
-    }
-    u_int32_t rmask = (u_int32_t)ximg->red_mask;
-    u_int32_t gmask = (u_int32_t)ximg->green_mask;
-    u_int32_t bmask = (u_int32_t)ximg->blue_mask;
-    for (size_t yt = 0, y = 0; yt < th; yt++, y += ystep) {
-        for (size_t xt = 0, x = 0; xt < fw; xt++, x += xstep) {
-            size_t j = yt * tw + ox + xt;
-            if (j < tw * th)
-            {
-                u_int32_t c[8];
-                for (int i=1; i<=7; i++)
-                    c[i] = (u_int32_t)GetPixel(ximg, (int)((x + offset_x[i]) / prec), (int)((y + offset_y[i]) / prec));
-
-                u_int32_t b = ((c[1] & bmask) + (c[2] & bmask) + (c[3] & bmask) + (c[4] & bmask) + (c[5] & bmask) * 2
-                            +  (c[6] & bmask) + (c[7] & bmask)) / 8;
-                u_int32_t g = ((c[1] & gmask) + (c[2] & gmask) + (c[3] & gmask) + (c[4] & gmask) + (c[5] & gmask) * 2
-                            +  (c[6] & gmask) + (c[7] & gmask)) / 8;
-                u_int32_t r = ((c[1] & rmask) + (c[2] & rmask) + (c[3] & rmask) + (c[4] & rmask) + (c[5] & rmask) * 2
-                            +  (c[6] & rmask) + (c[7] & rmask)) / 8;
-                data[j] = (r & rmask) | (g & gmask) | (b & bmask);
-            }
-        }
-    }
-    // Convert to argb32
-    if (rmask & 0xff0000) {
-        // argb32 or rgb24 => Nothing to do
-    } else if (rmask & 0xff) {
-        // bgr24
-        for (size_t i = 0; i < tw * th; i++) {
-            u_int32_t r = (data[i] & rmask) << 16;
-            u_int32_t g = (data[i] & gmask);
-            u_int32_t b = (data[i] & bmask) >> 16;
-            data[i] = (r & 0xff0000) | (g & 0x00ff00) | (b & 0x0000ff);
-        }
-    } else if (rmask & 0xff00) {
-        // bgra32
-        for (size_t i = 0; i < tw * th; i++) {
-            u_int32_t r = (data[i] & rmask) << 8;
-            u_int32_t g = (data[i] & gmask) >> 8;
-            u_int32_t b = (data[i] & bmask) >> 24;
-            data[i] = (r & 0xff0000) | (g & 0x00ff00) | (b & 0x0000ff);
-        }
-    }
+    downsample_thumbnail(ximg, data, w, h, tw, th, fw, ox);
 
     // 2nd pass
     smooth_thumbnail(result);
@@ -627,3 +708,31 @@ cairo_surface_t *get_window_thumbnail(Window win, int size)
 
     return image_surface;
 }
+
+BENCH(thumbnail_downsample)
+{
+    // A full HD window scaled to the default thumbnail size, without the X round trip
+    const size_t w = 1920, h = 1080, tw = 210;
+    size_t th = (size_t)(tw * 0.618);
+    size_t fw = th * w / h;
+    size_t ox = (tw - fw) / 2;
+    XImage ximg = {0};
+    ximg.width = (int)w;
+    ximg.height = (int)h;
+    ximg.bits_per_pixel = 32;
+    ximg.bytes_per_line = (int)(w * 4);
+    ximg.red_mask = 0xff0000;
+    ximg.green_mask = 0xff00;
+    ximg.blue_mask = 0xff;
+    ximg.data = malloc(w * h * 4);
+    for (size_t i = 0; i < w * h; i++)
+        ((u_int32_t *)ximg.data)[i] = (u_int32_t)(i * 2654435761u);
+    cairo_surface_t *result = cairo_image_surface_create(CAIRO_FORMAT_RGB24, (int)tw, (int)th);
+    u_int32_t *data = (u_int32_t *)cairo_image_surface_get_data(result);
+    BENCH_LOOP {
+        downsample_thumbnail(&ximg, data, w, h, tw, th, fw, ox);
+        smooth_thumbnail(result);
+    }
+    cairo_surface_destroy(result);
+    free(ximg.data);
+}
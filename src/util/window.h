@@ -33,6 +33,10 @@ void change_window_desktop(Window win, int desktop);
 int get_icon_count(gulong *data, int num);
 gulong *get_best_icon(gulong *data, int icon_count, int num, int *iw, int *ih, int best_icon_size);
 
+gulong *get_window_icon(Window win, int icon_size, int *iw, int *ih);
+// Reads the pixels of the _NET_WM_ICON size closest to icon_size, chosen like get_best_icon does,
+// without transferring the other sizes. Returns NULL if there is no icon, otherwise free with XFree.
+
 char *get_window_name(Window win);
 cairo_surface_t *get_window_thumbnail(Window win, int size);
 